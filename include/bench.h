@@ -0,0 +1,75 @@
+/**
+ * @file bench.h
+ * @brief On-device cycle benchmarks for the GPS intake path, geodesy kernels and cell keys
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "fix.h"
+
+typedef bool (*NmeaDecoder)(const char *burst, GpsFix &fix, void *ctx);
+
+struct BenchResult
+{
+    uint32_t sentences;
+    uint32_t warm_cycles; // per sentence, code already in the cache
+    uint32_t cold_cycles; // per sentence, after evicting the flash cache
+};
+
+/**
+ * @brief - time a decoder over bursts of NMEA text
+ * @param decode: decoder under test
+ * @param ctx: passed to the decoder
+ * @param bursts: null terminated NMEA bursts, each holding one or more sentences
+ * @param count: number of bursts
+ * @param rounds: times each burst is decoded per measurement
+ */
+BenchResult bench_nmea(NmeaDecoder decode, void *ctx, const char *const *bursts, size_t count, uint8_t rounds);
+
+enum GeoKernel : uint8_t
+{
+    GEO_BENCH_SIN,
+    GEO_BENCH_ATAN2,
+    GEO_BENCH_SQRT,
+    GEO_BENCH_EQUIRECT,
+    GEO_BENCH_HAVERSINE,
+    GEO_BENCH_KERNELS
+};
+
+struct GeoBenchResult
+{
+    uint32_t fixed_cycles[GEO_BENCH_KERNELS]; // per call, geo_fixed.h
+    uint32_t libm_cycles[GEO_BENCH_KERNELS];  // per call, the soft-float equivalent
+};
+
+/**
+ * @brief - time each fixed-point kernel against libm on the same pseudo-random inputs
+ * @param calls: calls per kernel
+ */
+GeoBenchResult bench_geo(uint16_t calls);
+
+const char *geo_kernel_name(GeoKernel kernel);
+
+struct SpatialBenchResult
+{
+    uint32_t geohash_cycles; // per key, spatial_key.h
+    uint32_t geohash_bisect_cycles;
+    uint32_t hilbert_cycles;
+    uint32_t hilbert_iterative_cycles;
+};
+
+/**
+ * @brief - time the cell key encoders against their one-bit-per-step versions
+ * @param calls: calls per encoder
+ */
+SpatialBenchResult bench_spatial(uint16_t calls);
+
+/**
+ * @brief - fill the instruction cache with unrelated flash contents
+ */
+void bench_evict_cache();
+
+#endif
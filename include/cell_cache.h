@@ -0,0 +1,54 @@
+/**
+ * @file cell_cache.h
+ * @brief Recently visited map cells, bucketed by Hilbert key
+ *
+ * Every fix falls into a Hilbert cell of order CELL_CACHE_ORDER. The cache keeps the
+ * CELL_CACHE_ENTRIES most recently visited cells with their fix count and dwell time, sorted by
+ * key: a lookup is a binary search, and because Hilbert keys preserve locality a key range
+ * returns a compact patch of neighbouring cells for "nearby" questions.
+ */
+
+#ifndef CELL_CACHE_H
+#define CELL_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CELL_CACHE_ORDER 16 // about 610 by 305 m at the equator
+#define CELL_CACHE_ENTRIES 32
+
+struct CellVisit
+{
+    uint32_t key;
+    uint32_t first_utc;
+    uint32_t last_utc;
+    uint32_t dwell_s; // time between consecutive fixes inside the cell
+    uint16_t fixes;
+};
+
+/**
+ * @brief - subscribe the cache to fix events
+ */
+void cell_cache_begin();
+
+/**
+ * @return false if the cell is not cached
+ */
+bool cell_cache_find(uint32_t key, CellVisit &visit);
+
+/**
+ * @brief - copy out cached cells with first_key <= key <= last_key, in key order
+ * @return number of cells copied
+ */
+size_t cell_cache_range(uint32_t first_key, uint32_t last_key, CellVisit *out, size_t max);
+
+struct CellCacheStats
+{
+    uint8_t cells;
+    uint32_t current_key; // cell of the latest fix
+    uint32_t evictions;
+};
+
+CellCacheStats cell_cache_stats();
+
+#endif
@@ -0,0 +1,54 @@
+/**
+ * @file config_store.h
+ * @brief Log-structured key/value store on a pair of flash sectors
+ *
+ * Every set appends a CRC-protected record to the active sector. When the sector fills up the
+ * live records are compacted into the other sector, which then becomes active, so erases
+ * alternate between the two. A RAM hash index built at boot maps keys to record offsets.
+ * A write interrupted by power loss fails its CRC and the previous value stays in effect.
+ */
+
+#ifndef CONFIG_STORE_H
+#define CONFIG_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CONFIG_MAX_KEY 31
+#define CONFIG_MAX_VALUE 128
+#define CONFIG_MAX_KEYS 32
+
+/**
+ * @brief - mount the store, formatting it if neither sector holds a valid log
+ */
+bool config_begin();
+
+/**
+ * @brief - read a value
+ * @param key: null terminated key
+ * @param value: destination buffer
+ * @param size: size of the destination buffer
+ * @return length of the value, or -1 if the key is not set or the buffer is too small
+ */
+int config_get(const char *key, void *value, size_t size);
+
+/**
+ * @brief - read a string value into a null terminated buffer, or copy fallback if unset
+ */
+void config_get_string(const char *key, char *value, size_t size, const char *fallback);
+
+bool config_set(const char *key, const void *value, size_t length);
+bool config_set_string(const char *key, const char *value);
+bool config_remove(const char *key);
+
+struct ConfigStats
+{
+    uint8_t keys;
+    uint32_t used_bytes;
+    uint32_t generation;
+    uint32_t compactions;
+};
+
+ConfigStats config_stats();
+
+#endif
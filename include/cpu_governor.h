@@ -0,0 +1,72 @@
+/**
+ * @file cpu_governor.h
+ * @brief CPU clock governor, 80 MHz when idle and 160 MHz under load
+ *
+ * The load is the share of each GOVERNOR_WINDOW_MS window the CPU rail spent active in the
+ * energy accounting, i.e. out of the loop's idle delay. A window at or above
+ * GOVERNOR_UP_PERCENT, or pending work the caller knows about (a live session or gpsd watcher
+ * taking every burst, archive thinning), raises the clock at once; it drops back only after
+ * GOVERNOR_HOLD_WINDOWS windows below GOVERNOR_DOWN_PERCENT, so a single burst does not make
+ * it flap.
+ *
+ * A change is only applied at a quiet point the caller vouches for. On the ESP8266 the
+ * SoftwareSerial ports time their bits in CPU cycles worked out when they begin, so they are
+ * restarted with the clock and a byte on the wire during the switch is lost; the soft AP is
+ * unaffected at either frequency. Time at each frequency is reported next to the energy
+ * accounting, which has a cpu_fast state for active time at 160 MHz. The module has no
+ * Arduino dependencies, the platform switch is a callback.
+ */
+
+#ifndef CPU_GOVERNOR_H
+#define CPU_GOVERNOR_H
+
+#include <stdint.h>
+#include "energy.h"
+
+#define GOVERNOR_WINDOW_MS 1000
+#define GOVERNOR_UP_PERCENT 60
+#define GOVERNOR_DOWN_PERCENT 20
+#define GOVERNOR_HOLD_WINDOWS 5
+
+enum CpuSpeed : uint8_t
+{
+    CPU_80MHZ,
+    CPU_160MHZ,
+    CPU_SPEEDS
+};
+
+/**
+ * @brief - switch to 80 MHz and start governing
+ * @param clock_us: microsecond clock, micros() on the device
+ * @param set_speed: switch the CPU clock and whatever is timed by it, false if it failed
+ */
+void governor_begin(uint32_t (*clock_us)(), bool (*set_speed)(CpuSpeed));
+
+/**
+ * @brief - account time, close the load window when it is due and apply a pending change
+ * @param quiet: a clock switch would not cut into serial traffic here
+ * @param pending: work is queued that wants the fast clock whatever the measured load
+ */
+void governor_update(bool quiet, bool pending);
+
+CpuSpeed governor_speed();
+uint16_t governor_mhz(CpuSpeed speed);
+
+/**
+ * @return the energy state of the CPU running at the current clock
+ */
+EnergyState governor_active_state();
+
+struct GovernorStats
+{
+    uint64_t speed_us[CPU_SPEEDS]; // since governor_begin()
+    uint32_t switches;
+    uint32_t deferred; // windows that wanted a change while the serial links were busy
+    uint32_t failed;   // changes the platform refused
+    uint8_t load_percent; // last window
+    CpuSpeed target;
+};
+
+GovernorStats governor_stats();
+
+#endif
@@ -0,0 +1,17 @@
+/**
+ * @file crc.h
+ * @brief CRC-32 (IEEE 802.3, as used by zlib/gzip)
+ */
+
+#ifndef CRC_H
+#define CRC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief - update a running CRC-32. Start with crc = 0
+ */
+uint32_t crc32_update(uint32_t crc, const void *data, size_t length);
+
+#endif
@@ -0,0 +1,131 @@
+/**
+ * @file energy.h
+ * @brief Energy accounting from power state transitions
+ *
+ * The tracker is modelled as four rails (CPU, modem, AP radio, GPS receiver), each in one
+ * state at a time. Subsystems report transitions with energy_enter(); the time spent in every
+ * state is integrated per day of uptime and multiplied by a configurable current figure to
+ * give charge. Modem states follow the modem events: the modem does not say when an upload
+ * turns from sending to waiting for the reply, so a whole upload counts as TX.
+ *
+ * Fixes, non-CPU transitions and CPU clock changes are also kept in a small trace ring.
+ * Downloaded traces are replayed on the host by tools/energy_replay.cpp to predict battery
+ * life under other sampling and upload policies. The module has no Arduino dependencies for
+ * that reason.
+ */
+
+#ifndef ENERGY_H
+#define ENERGY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define ENERGY_TRACE_LENGTH 256
+#define ENERGY_DAY_US 86400000000ULL
+
+enum EnergyRail : uint8_t
+{
+    ENERGY_RAIL_CPU,
+    ENERGY_RAIL_MODEM,
+    ENERGY_RAIL_AP,
+    ENERGY_RAIL_GPS,
+    ENERGY_RAILS
+};
+
+enum EnergyState : uint8_t
+{
+    ENERGY_CPU_ACTIVE,
+    ENERGY_CPU_LIGHT_SLEEP,
+    ENERGY_MODEM_OFF,
+    ENERGY_MODEM_IDLE,
+    ENERGY_MODEM_TX,
+    ENERGY_MODEM_RX,
+    ENERGY_AP_OFF,
+    ENERGY_AP_ON,
+    ENERGY_GPS_OFF,
+    ENERGY_GPS_ON,
+    ENERGY_CPU_FAST, // active at 160 MHz; last, so trace kinds and saved currents keep their indices
+    ENERGY_STATES
+};
+
+/**
+ * @brief - start accounting with the CPU active, the modem and AP off and the GPS on, and
+ * subscribe to fix and modem events
+ * @param clock_us: microsecond clock, micros() on the device
+ */
+void energy_begin(uint32_t (*clock_us)());
+
+/**
+ * @brief - switch the rail of a state to that state
+ */
+void energy_enter(EnergyState state);
+
+/**
+ * @brief - account time up to now without a transition. The clock wraps after 71 minutes,
+ * so this or energy_enter() must run more often than that
+ */
+void energy_update();
+
+EnergyRail energy_rail(EnergyState state);
+EnergyState energy_rail_state(EnergyRail rail);
+const char *energy_state_name(EnergyState state);
+
+/**
+ * @return false if no state has this name
+ */
+bool energy_state_from_name(const char *name, EnergyState &state);
+
+/**
+ * @brief - set the battery-side current of a state, replacing the datasheet default
+ */
+void energy_set_current(EnergyState state, uint32_t current_ua);
+uint32_t energy_current(EnergyState state);
+
+struct EnergyDay
+{
+    uint64_t elapsed_us;
+    uint64_t state_us[ENERGY_STATES];
+};
+
+/**
+ * @return charge drawn in a state over the day, uAh
+ */
+uint32_t energy_charge_uah(const EnergyDay &day, EnergyState state);
+
+/**
+ * @return charge drawn in all states over the day, uAh
+ */
+uint32_t energy_total_uah(const EnergyDay &day);
+
+struct EnergyStats
+{
+    EnergyDay today;     // since the last day boundary
+    EnergyDay yesterday; // last complete day, zero until one has passed
+    uint32_t days;
+};
+
+EnergyStats energy_stats();
+
+/**
+ * @return CPU active time at either clock since energy_begin(), up to the last update
+ */
+uint64_t energy_cpu_active_us();
+
+#define ENERGY_TRACE_FIX 0xFF // kind of a fix entry, other kinds are the EnergyState entered
+
+struct EnergyTraceEntry
+{
+    uint32_t ms;     // accounted time since energy_begin()
+    uint8_t kind;    // EnergyState or ENERGY_TRACE_FIX
+    uint8_t moved;   // fix entries
+    uint16_t cpu_ms; // fix entries: CPU active time since the previous fix
+};
+
+/**
+ * @brief - copy out part of the trace, oldest entry first
+ * @param first: entries to skip
+ * @return number of entries copied, 0 past the end
+ */
+size_t energy_trace(size_t first, EnergyTraceEntry *out, size_t max);
+
+#endif
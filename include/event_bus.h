@@ -0,0 +1,80 @@
+/**
+ * @file event_bus.h
+ * @brief Small typed publish/subscribe channels with statically allocated subscriber tables
+ *
+ * Each channel owns a single event slot. publish() copies the event into the slot once and
+ * every subscriber receives it by reference, so consumers never make their own copies.
+ * The slot also keeps the last published event for readers that poll instead of subscribing.
+ */
+
+#ifndef EVENT_BUS_H
+#define EVENT_BUS_H
+
+#include <stdint.h>
+
+template <typename Event, uint8_t MAX_SUBSCRIBERS>
+class EventChannel
+{
+public:
+    typedef void (*Handler)(const Event &event, void *ctx);
+
+    EventChannel() : _count(0), _sequence(0), _dispatching(false) {}
+
+    /**
+     * @brief - register a handler to be called on every publish
+     * @param handler: function called with the published event
+     * @param ctx: opaque pointer handed back to the handler
+     * @return false if the subscriber table is full
+     */
+    bool subscribe(Handler handler, void *ctx = nullptr)
+    {
+        if (_count == MAX_SUBSCRIBERS)
+        {
+            return false;
+        }
+        _subscribers[_count].handler = handler;
+        _subscribers[_count].ctx = ctx;
+        _count++;
+        return true;
+    }
+
+    /**
+     * @brief - store the event in the channel slot and dispatch it to all subscribers
+     * @return false if called from one of this channel's own handlers (the slot is in use)
+     */
+    bool publish(const Event &event)
+    {
+        if (_dispatching)
+        {
+            return false;
+        }
+        _dispatching = true;
+        _slot = event;
+        _sequence++;
+        for (uint8_t i = 0; i < _count; i++)
+        {
+            _subscribers[i].handler(_slot, _subscribers[i].ctx);
+        }
+        _dispatching = false;
+        return true;
+    }
+
+    bool has_last() const { return _sequence != 0; }
+    const Event &last() const { return _slot; }
+    uint32_t sequence() const { return _sequence; }
+
+private:
+    struct Subscriber
+    {
+        Handler handler;
+        void *ctx;
+    };
+
+    Subscriber _subscribers[MAX_SUBSCRIBERS];
+    uint8_t _count;
+    Event _slot;
+    uint32_t _sequence;
+    bool _dispatching;
+};
+
+#endif
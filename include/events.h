@@ -0,0 +1,93 @@
+/**
+ * @file events.h
+ * @brief Event types and the channels the tracker subsystems communicate through
+ */
+
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include "event_bus.h"
+#include "fix.h"
+
+#define MAX_FIX_SUBSCRIBERS 10
+#define MAX_UPLOAD_SUBSCRIBERS 4
+#define MAX_MODEM_SUBSCRIBERS 4
+#define MAX_CONTROL_SUBSCRIBERS 4
+#define MAX_ROUTE_SUBSCRIBERS 4
+
+/**
+ * @brief Published for every valid fix read from the receiver
+ */
+struct FixEvent
+{
+    GpsFix fix;
+    bool moved; // position differs from the previously accepted fix
+};
+
+/**
+ * @brief Published when an HTTP PUT through the modem completes
+ */
+struct UploadEvent
+{
+    int16_t http_status; // -1 if the modem did not report a status
+    uint16_t bytes;
+    uint32_t duration_ms;
+};
+
+enum ModemState : uint8_t
+{
+    MODEM_OFF,
+    MODEM_RESETTING,
+    MODEM_ATTACHING,
+    MODEM_READY,
+    MODEM_UPLOADING,
+    MODEM_FAILED
+};
+
+struct ModemEvent
+{
+    ModemState state;
+};
+
+enum ControlCommand : uint8_t
+{
+    CONTROL_START_LIVE,
+    CONTROL_STOP_LIVE
+};
+
+/**
+ * @brief Commands from remote clients or the local UI
+ */
+struct ControlEvent
+{
+    ControlCommand command;
+    uint16_t duration_s; // CONTROL_START_LIVE
+};
+
+enum RouteEventType : uint8_t
+{
+    ROUTE_DEVIATED,
+    ROUTE_RETURNED
+};
+
+/**
+ * @brief Published when the vehicle leaves or rejoins the planned route corridor
+ */
+struct RouteEvent
+{
+    RouteEventType type;
+    uint16_t segment;
+    int32_t cross_track_m;
+    uint32_t progress_m;
+    uint32_t utc;
+};
+
+const char *modem_state_name(ModemState state);
+
+extern EventChannel<FixEvent, MAX_FIX_SUBSCRIBERS> fix_events;
+extern EventChannel<UploadEvent, MAX_UPLOAD_SUBSCRIBERS> upload_events;
+extern EventChannel<ModemEvent, MAX_MODEM_SUBSCRIBERS> modem_events;
+extern EventChannel<ControlEvent, MAX_CONTROL_SUBSCRIBERS> control_events;
+extern EventChannel<RouteEvent, MAX_ROUTE_SUBSCRIBERS> route_events;
+
+#endif
@@ -0,0 +1,43 @@
+/**
+ * @file fix.h
+ * @brief GPS fix representation shared by the tracker subsystems
+ */
+
+#ifndef FIX_H
+#define FIX_H
+
+#include <stdint.h>
+
+/**
+ * @brief A position read from the receiver. Coordinates are integers in 1e-7 degree units
+ */
+struct GpsFix
+{
+    int32_t lat_e7;
+    int32_t lng_e7;
+    uint32_t time_ms; // millis() when the fix was read
+    uint32_t utc;     // seconds since 1970-01-01, 0 if the receiver has no date/time yet
+    uint16_t hdop;    // HDOP x100
+    uint8_t sats;
+    uint16_t speed;   // knots x100
+    uint16_t course;  // degrees x100
+};
+
+#define E7_TO_DEG(v) ((v) / 1e7)
+
+/**
+ * @brief - seconds since the Unix epoch for a UTC calendar date and time
+ */
+inline uint32_t utc_from_civil(uint16_t year, uint8_t month, uint8_t day, uint8_t hour, uint8_t minute, uint8_t second)
+{
+    // Days from civil, shifted so the year starts in March and leap days fall at its end
+    int32_t y = (int32_t)year - (month <= 2);
+    int32_t era = y / 400;
+    uint32_t yoe = (uint32_t)(y - era * 400);
+    uint32_t doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    int32_t days = era * 146097 + (int32_t)doe - 719468;
+    return (uint32_t)days * 86400UL + hour * 3600UL + minute * 60UL + second;
+}
+
+#endif
@@ -0,0 +1,37 @@
+/**
+ * @file fix_record.h
+ * @brief Packed fix layout shared by stored history and the binary live channel
+ */
+
+#ifndef FIX_RECORD_H
+#define FIX_RECORD_H
+
+#include "events.h"
+
+#define FIX_FLAG_MOVED 0x01
+
+struct __attribute__((packed)) FixRecord
+{
+    uint32_t utc;
+    int32_t lat_e7;
+    int32_t lng_e7;
+    uint16_t hdop;
+    uint8_t sats;
+    uint8_t flags;
+};
+
+static_assert(sizeof(FixRecord) == 16, "FixRecord is part of the wire format");
+
+inline FixRecord make_fix_record(const FixEvent &event)
+{
+    FixRecord record;
+    record.utc = event.fix.utc;
+    record.lat_e7 = event.fix.lat_e7;
+    record.lng_e7 = event.fix.lng_e7;
+    record.hdop = event.fix.hdop;
+    record.sats = event.fix.sats;
+    record.flags = event.moved ? FIX_FLAG_MOVED : 0;
+    return record;
+}
+
+#endif
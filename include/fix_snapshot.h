@@ -0,0 +1,27 @@
+/**
+ * @file fix_snapshot.h
+ * @brief Consistent view of the current and previous position for handlers and ISRs
+ */
+
+#ifndef FIX_SNAPSHOT_H
+#define FIX_SNAPSHOT_H
+
+#include "fix.h"
+#include "seqlock.h"
+
+struct FixSnapshot
+{
+    GpsFix current;
+    GpsFix previous;
+    bool valid;   // at least one fix has been read
+    bool updated; // the last read moved the position
+};
+
+extern Seqlock<FixSnapshot> fix_snapshot;
+
+/**
+ * @brief - subscribe the snapshot writer to fix events
+ */
+void fix_snapshot_begin();
+
+#endif
@@ -0,0 +1,75 @@
+/**
+ * @file flash_blocks.h
+ * @brief Append-only blocks in raw flash sectors, as the track archive and flight recorder write them
+ *
+ * A block is a header and a payload, padded to a 4-byte boundary. Each user has its own header,
+ * described by a FlashBlockLayout, but every header starts with a 32-bit magic, keeps the payload
+ * length in a uint16_t and ends with a CRC-32 over the rest of the header and the payload.
+ *
+ * The magic is written last, so a block cut short by a power loss never reads as valid, and the
+ * blocks of a sector end at the first header without it. Whatever follows them must still be
+ * erased flash for the sector to take more blocks.
+ */
+
+#ifndef FLASH_BLOCKS_H
+#define FLASH_BLOCKS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define FLASH_MAGIC_ERASED 0xFFFFFFFF
+#define FLASH_ALIGN4(n) (((n) + 3) & ~3u)
+#define FLASH_BLOCK_HEADER_MAX 64
+
+/**
+ * @brief The magic and shape of one kind of block header
+ */
+struct FlashBlockLayout
+{
+    uint32_t magic;
+    uint16_t header_size;   // the CRC is its last four bytes
+    uint16_t length_offset; // of the payload length
+};
+
+/**
+ * @return flash taken by a block, header and padding included
+ */
+uint32_t flash_block_size(const FlashBlockLayout &layout, const void *header);
+
+/**
+ * @return the CRC a block's header should hold
+ */
+uint32_t flash_block_crc(const FlashBlockLayout &layout, const void *header, const uint8_t *payload);
+
+/**
+ * @brief - read the header of the block at an offset in a sector, if it has the magic
+ * @return the block's size, or 0 at the end of the sector's blocks
+ */
+uint32_t flash_block_at(const FlashBlockLayout &layout, uint32_t sector_address, uint32_t offset, void *header);
+
+/**
+ * @brief - pad, checksum and write a block from a buffer holding its header and payload; the
+ * caller fills in the header apart from the magic and CRC
+ * @param commit: write the magic too; otherwise the block stays invisible until flash_block_commit()
+ */
+bool flash_block_write(const FlashBlockLayout &layout, uint32_t address, uint8_t *block, bool commit);
+bool flash_block_commit(const FlashBlockLayout &layout, uint32_t address);
+
+/**
+ * @brief - find where the next block of a sector goes
+ * @param last: receives the header of the last block, left alone if there is none; may be nullptr
+ * @return the end of the sector's blocks, or FLASH_SECTOR_SIZE if what follows them is not
+ * erased flash
+ */
+uint32_t flash_blocks_end(const FlashBlockLayout &layout, uint32_t sector_address, void *last);
+
+/* Little-endian base-128 varints, for block payloads */
+uint8_t varint_size(uint32_t value);
+uint8_t *put_varint(uint8_t *out, uint32_t value);
+
+/**
+ * @return the position after the varint, or nullptr if it runs past end
+ */
+const uint8_t *get_varint(const uint8_t *in, const uint8_t *end, uint32_t &value);
+
+#endif
@@ -0,0 +1,42 @@
+/**
+ * @file flash_layout.h
+ * @brief Raw flash sectors owned by the tracker
+ *
+ * The tracker does not mount a filesystem; the filesystem region of the flash map is split
+ * into the areas below instead. Sector numbers are relative to the start of that region.
+ */
+
+#ifndef FLASH_LAYOUT_H
+#define FLASH_LAYOUT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define FLASH_SECTOR_SIZE 4096
+
+#define CONFIG_STORE_FIRST_SECTOR 0
+#define CONFIG_STORE_SECTORS 2
+
+#define ROUTE_FIRST_SECTOR 2
+#define ROUTE_SECTORS 2
+
+#define ARCHIVE_FIRST_SECTOR 4
+#define ARCHIVE_SECTORS 126
+
+#define ARCHIVE_JOURNAL_FIRST_SECTOR 130
+#define ARCHIVE_JOURNAL_SECTORS 2
+
+#define RECORDER_FIRST_SECTOR 132
+#define RECORDER_SECTORS 64
+
+/**
+ * @brief - number of sectors available to the tracker
+ */
+uint32_t flash_region_sectors();
+
+/* Addresses are byte offsets from the start of the tracker region. Writes must be 4-byte aligned */
+bool flash_erase_sector(uint32_t sector);
+bool flash_write(uint32_t address, const void *data, size_t length);
+bool flash_read(uint32_t address, void *data, size_t length);
+
+#endif
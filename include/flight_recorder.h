@@ -0,0 +1,89 @@
+/**
+ * @file flight_recorder.h
+ * @brief Capture of both directions of the GPS and modem serial links in a ring of flash sectors
+ *
+ * Every read from and write to either link is logged with its millisecond time and link. The
+ * entries collect in a RAM block, which is LZ-compressed and written to flash as one
+ * CRC-protected block once it fills up or grows old; receiver bursts and AT dialogue repeat
+ * themselves and shrink to less than half. When the ring is full the oldest sector is
+ * erased. Blocks carry the boot they were recorded in, so captures across restarts stay apart.
+ *
+ * The download (/recorder) is the valid blocks oldest first, unchanged from flash.
+ * tools/flight_replay.cpp decodes it with recorder_parse_block() and replays the receiver
+ * bytes through the firmware's NMEA parser exactly as they were read. The module has no
+ * Arduino dependencies for that reason.
+ */
+
+#ifndef FLIGHT_RECORDER_H
+#define FLIGHT_RECORDER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define RECORDER_RAW_SIZE 1024    // uncompressed entries per block, and the LZ window
+#define RECORDER_FLUSH_MS 60000UL // longest an entry waits in RAM before its block is written
+
+enum RecorderChannel : uint8_t
+{
+    RECORDER_GPS_RX,
+    RECORDER_GPS_TX,
+    RECORDER_MODEM_RX,
+    RECORDER_MODEM_TX,
+    RECORDER_CHANNELS
+};
+
+/**
+ * @brief - find the newest block in flash and start recording
+ * @param clock_ms: millisecond clock, millis() on the device
+ */
+void recorder_begin(uint32_t (*clock_ms)());
+
+/**
+ * @brief - log bytes read from or written to a link. Safe to call from any task
+ */
+void recorder_log(RecorderChannel channel, const void *data, size_t length);
+
+/**
+ * @brief - write the pending block now, e.g. before a restart or a download
+ */
+bool recorder_flush();
+
+/**
+ * @brief - copy out the stored blocks oldest first, as they are in flash
+ * @param offset: byte position in the download, for paging through it
+ * @return bytes copied, 0 past the end
+ */
+size_t recorder_read(uint32_t offset, uint8_t *out, size_t max);
+
+const char *recorder_channel_name(RecorderChannel channel);
+
+struct RecorderEntry
+{
+    uint32_t boot;
+    uint32_t ms;
+    RecorderChannel channel;
+    const uint8_t *data;
+    uint16_t length;
+};
+
+/**
+ * @brief - decode the block at the start of a download, calling visit for every entry
+ * @param available: bytes left in the download
+ * @return the size of the block, 0 if it is malformed or fails its CRC
+ */
+size_t recorder_parse_block(const uint8_t *in, size_t available, void (*visit)(const RecorderEntry &entry, void *ctx), void *ctx);
+
+struct RecorderStats
+{
+    uint32_t boot;
+    uint32_t logged_bytes; // since boot, before compression
+    uint32_t blocks;
+    uint32_t stored_bytes; // flash used by the blocks, headers included
+    uint32_t dropped_bytes; // lost to failed flash writes
+    uint16_t sectors;
+    uint16_t pending; // raw bytes waiting in RAM
+};
+
+RecorderStats recorder_stats();
+
+#endif
@@ -0,0 +1,59 @@
+/**
+ * @file gpsd_server.h
+ * @brief gpsd-compatible feed for navigation software on the AP (port GPSD_PORT)
+ *
+ * Clients speak the gpsd JSON protocol: the server greets with VERSION and answers ?WATCH,
+ * ?DEVICES, ?POLL and ?VERSION. A watch with "nmea":true (or "raw") streams the receiver
+ * output as it is read; "json":true streams a TPV object per fix.
+ *
+ * Each stream is written once into a shared ring and every client keeps its own cursor into
+ * it; sends go straight from the ring to the socket, as much as the socket has room for.
+ * The writer never waits for readers: a client that falls a whole ring behind is dropped.
+ */
+
+#ifndef GPSD_SERVER_H
+#define GPSD_SERVER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define GPSD_PORT 2947
+#define GPSD_MAX_CLIENTS 4
+#define GPSD_NMEA_RING_SIZE 2048 // power of two, two 1 Hz receiver bursts
+#define GPSD_JSON_RING_SIZE 1024 // power of two
+#define GPSD_COMMAND_SIZE 96
+#define GPSD_DEVICE "/dev/gps0"
+
+/**
+ * @brief - start listening and subscribe to fix events for TPV reports
+ */
+void gpsd_begin();
+
+/**
+ * @brief - append receiver output to the NMEA stream. May run on another task than
+ * gpsd_loop(), but only ever one
+ */
+void gpsd_feed(const char *data, size_t length);
+
+/**
+ * @brief - accept clients, answer requests and send what each watcher has room for
+ */
+void gpsd_loop();
+
+/**
+ * @brief - clients with an active watch. The intake reads the receiver continuously while
+ * there are any
+ */
+uint8_t gpsd_watchers();
+
+struct GpsdStats
+{
+    uint8_t clients;
+    uint32_t connections;
+    uint32_t clients_dropped; // fell a ring behind
+    uint32_t bytes_sent;
+};
+
+GpsdStats gpsd_stats();
+
+#endif
@@ -0,0 +1,26 @@
+/**
+ * @file gzip.h
+ * @brief Small gzip encoder for web responses
+ *
+ * One deflate block with the fixed Huffman codes, and LZ77 matches found through a table of
+ * the last position of each 3-byte hash. That gets most of the gain on generated HTML, whose
+ * tags and styles repeat, without building dynamic code tables or a 32 KB window: the output
+ * is written straight to the caller's buffer and the only other state is the 1 KB hash table.
+ */
+
+#ifndef GZIP_H
+#define GZIP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define GZIP_HASH_BITS 9
+#define GZIP_MAX_INPUT 65535 // positions in the hash table are 16 bits
+
+/**
+ * @brief - compress into a gzip member
+ * @return bytes written, 0 if they would not fit in max or the input is too long
+ */
+size_t gzip_compress(const uint8_t *in, size_t length, uint8_t *out, size_t max);
+
+#endif
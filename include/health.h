@@ -0,0 +1,90 @@
+/**
+ * @file health.h
+ * @brief Health supervisor restarting a stuck subsystem instead of the whole tracker
+ *
+ * Subsystems report how their work went with health_report(). One is down when
+ *  - nothing good was reported for its silence timeout (the receiver stopped talking), or
+ *  - max_failures reports in a row were bad (AT commands without a reply, garbage at the
+ *    wrong baud rate), or its probe failed as often (the soft AP lost its address)
+ * and health_service() then runs its restart callback: the modem bring-up alone, the GPS
+ * UART, the web server. The outage counts from the last good report until the restart
+ * reports success, or failing that, the first good report after it. A subsystem still down
+ * after HEALTH_MAX_RESTARTS restarts in a row escalates to the full restart. The escalation
+ * callback may decline, e.g. when earlier full restarts did not help either: a receiver or
+ * modem that is missing or dead must not keep the tracker in a reboot loop. The subsystem is
+ * then marked failed and the rest keeps running; its restart is retried after HEALTH_RETRY_MS,
+ * doubling up to HEALTH_RETRY_MAX_MS, and a good report brings it back at any time.
+ *
+ * All calls for one subsystem must come from the context that owns it, the loop or its task
+ * in TRACKER_TASKS builds, so the supervisor needs no locking. Reports made by the restart
+ * callback itself are ignored. The module has no Arduino dependencies.
+ */
+
+#ifndef HEALTH_H
+#define HEALTH_H
+
+#include <stdint.h>
+
+#define HEALTH_MAX_RESTARTS 3
+#define HEALTH_PROBE_MS 1000
+#define HEALTH_RETRY_MS 60000UL
+#define HEALTH_RETRY_MAX_MS 3600000UL
+
+enum HealthSubsystem : uint8_t
+{
+    HEALTH_MODEM,
+    HEALTH_GPS,
+    HEALTH_WEB,
+    HEALTH_SUBSYSTEMS
+};
+
+enum HealthState : uint8_t
+{
+    HEALTH_OK,
+    HEALTH_RESTARTING, // in its restart callback
+    HEALTH_RECOVERING, // restarted, waiting for a good report
+    HEALTH_FAILED      // the full restart was declined, retrying with backoff
+};
+
+/**
+ * @param clock_ms: millisecond clock, millis() on the device
+ * @param escalate: full restart, for a subsystem the restarts did not bring back; returns
+ * false to decline, which marks the subsystem failed
+ */
+void health_begin(uint32_t (*clock_ms)(), bool (*escalate)(HealthSubsystem));
+
+/**
+ * @brief - supervise a subsystem
+ * @param silent_ms: longest time without a good report, 0 if only failures count
+ * @param max_failures: bad reports or failed probes in a row that take it down
+ * @param probe: polled every HEALTH_PROBE_MS in health_service(), nullptr for none
+ * @param restart: bring the subsystem back, true if it is verified working on return
+ */
+void health_register(HealthSubsystem subsystem, uint32_t silent_ms, uint8_t max_failures, bool (*probe)(), bool (*restart)());
+
+/**
+ * @brief - record how a unit of work went, e.g. whether an AT command got a reply
+ */
+void health_report(HealthSubsystem subsystem, bool ok);
+
+/**
+ * @brief - probe the subsystem when due and restart it if it is down
+ */
+void health_service(HealthSubsystem subsystem);
+
+const char *health_subsystem_name(HealthSubsystem subsystem);
+
+struct HealthStats
+{
+    HealthState state;
+    uint32_t restarts;
+    uint32_t recoveries;
+    uint32_t escalations;
+    uint32_t failures;         // declined escalations
+    uint32_t last_recovery_ms; // outage length
+    uint64_t total_recovery_ms;
+};
+
+HealthStats health_stats(HealthSubsystem subsystem);
+
+#endif
@@ -0,0 +1,23 @@
+/**
+ * @file hot_path.h
+ * @brief Placement of the per-byte / per-sentence code paths
+ *
+ * Code normally executes from SPI flash through the instruction cache. Building with
+ * TRACKER_HOT_IRAM moves the functions marked HOT_PATH into IRAM so the GPS intake path does
+ * not take cache misses when the web server or modem code has evicted it. The IRAM budget is
+ * checked after linking by scripts/iram_budget.py.
+ */
+
+#ifndef HOT_PATH_H
+#define HOT_PATH_H
+
+#ifdef TRACKER_HOT_IRAM
+#include <Arduino.h> // IRAM_ATTR; without it the marked modules also build on the host
+#define HOT_PATH IRAM_ATTR
+#define HOT_PATH_PLACEMENT "IRAM"
+#else
+#define HOT_PATH
+#define HOT_PATH_PLACEMENT "flash"
+#endif
+
+#endif
@@ -0,0 +1,53 @@
+/**
+ * @file http_admission.h
+ * @brief Admission control for the AP web server
+ *
+ * Two limits protect GPS intake and uploads from a busy UI:
+ *  - every client IP has a token bucket; requests without a token get a cheap 429
+ *  - HTTP work earns CPU time at HTTP_CPU_SHARE of wall time; loop() only services the
+ *    server while that credit is positive, so a slow page delays the next one instead of
+ *    the rest of the loop
+ * Concurrent connections are bounded by HTTP_MAX_STATIONS on the soft AP, as the server
+ * handles one request at a time.
+ */
+
+#ifndef HTTP_ADMISSION_H
+#define HTTP_ADMISSION_H
+
+#include <stdint.h>
+
+#define HTTP_MAX_STATIONS 4
+#define HTTP_CLIENT_SLOTS 8
+#define HTTP_BUCKET_SIZE 5         // burst of requests per client
+#define HTTP_REFILL_MS 1000        // one request token per client per second
+#define HTTP_CPU_SHARE_PERCENT 25  // share of wall time the server may use
+#define HTTP_CPU_CREDIT_MAX_MS 500 // cap on saved up CPU time
+
+/**
+ * @brief - take a request token for a client
+ * @param ip: client IPv4 address
+ * @param now: millis()
+ * @return false if the client is over its rate
+ */
+bool http_admit(uint32_t ip, uint32_t now);
+
+/**
+ * @brief - whether the server may be serviced in this loop iteration
+ */
+bool http_cpu_available(uint32_t now);
+
+/**
+ * @brief - charge time spent servicing the server against the CPU budget
+ */
+void http_cpu_charge(uint32_t elapsed_us);
+
+struct HttpAdmissionStats
+{
+    uint32_t admitted;
+    uint32_t rejected;
+    uint32_t deferred; // loop iterations that skipped the server for lack of CPU credit
+};
+
+HttpAdmissionStats http_admission_stats();
+
+#endif
@@ -0,0 +1,44 @@
+/**
+ * @file live_channel.h
+ * @brief Binary WebSocket channel for live map clients (port LIVE_PORT)
+ *
+ * Frames from the device start with a type byte:
+ *  LIVE_FRAME_FIX      FixRecord                         the latest fix
+ *  LIVE_FRAME_HISTORY  uint8_t count, FixRecord[count]   one page of a history request
+ * Frames from a client:
+ *  LIVE_CMD_START      uint16_t duration_s               start a live session
+ *  LIVE_CMD_STOP                                         end the live session
+ *  LIVE_CMD_HISTORY    uint32_t from_utc, uint32_t to_utc
+ * Multi-byte fields are little endian. A client that cannot take a frame keeps only the
+ * newest pending fix; one that stays blocked for LIVE_STALL_MS is disconnected.
+ */
+
+#ifndef LIVE_CHANNEL_H
+#define LIVE_CHANNEL_H
+
+#include <stdint.h>
+
+#define LIVE_PORT 81
+#define LIVE_STALL_MS 10000
+#define LIVE_HISTORY_PAGE 16
+
+#define LIVE_FRAME_FIX 0x01
+#define LIVE_FRAME_HISTORY 0x02
+#define LIVE_CMD_START 0x10
+#define LIVE_CMD_STOP 0x11
+#define LIVE_CMD_HISTORY 0x12
+
+void live_channel_begin();
+void live_channel_loop();
+
+struct LiveChannelStats
+{
+    uint8_t clients;
+    uint32_t frames_sent;
+    uint32_t frames_coalesced; // fixes replaced by a newer one before the client could take them
+    uint32_t clients_dropped;
+};
+
+LiveChannelStats live_channel_stats();
+
+#endif
@@ -0,0 +1,51 @@
+/**
+ * @file live_session.h
+ * @brief Bounded high-rate live-follow mode
+ *
+ * A CONTROL_START_LIVE event raises the receiver to LIVE_SESSION_RATE_MS, trims its output to
+ * GGA and RMC so the faster rate fits in 9600 baud, and lifts the read gate so every fix goes
+ * straight to the live channel. The session reverts to the normal 1 Hz configuration on
+ * CONTROL_STOP_LIVE or when its duration runs out.
+ */
+
+#ifndef LIVE_SESSION_H
+#define LIVE_SESSION_H
+
+#include <Arduino.h>
+
+#define LIVE_SESSION_RATE_MS 200
+#define LIVE_SESSION_DEFAULT_S 120
+#define LIVE_SESSION_MAX_S 900
+
+/**
+ * @brief - subscribe to control events
+ * @param gps_port: serial port the receiver listens on
+ */
+void live_session_begin(Stream *gps_port);
+
+/**
+ * @brief - end the session once its time is up
+ */
+void live_session_loop();
+
+bool live_session_active();
+
+/**
+ * @brief - record the time from the first byte of a fix arriving to a consumer receiving it
+ */
+void live_session_record_latency(uint32_t latency_ms);
+
+struct LiveSessionStats
+{
+    uint32_t remaining_s;
+    uint32_t sessions;
+    uint32_t fixes;         // fixes delivered during sessions
+    uint32_t latency_last;  // ms
+    uint32_t latency_min;   // ms
+    uint32_t latency_max;   // ms
+    uint32_t latency_total; // ms, divide by fixes for the mean
+};
+
+LiveSessionStats live_session_stats();
+
+#endif
@@ -0,0 +1,109 @@
+/**
+ * @file network_cache.h
+ * @brief The operator, RAT and band the EC200U last registered on, for a targeted attach
+ *
+ * After a reset the modem scans every band of every RAT before it registers. Once it has
+ * registered the tracker reads back what it found (AT+COPS? and AT+QNWINFO) and keeps it in
+ * the config store; the next bring-up narrows the search to that RAT (AT+QCFG="nwscanmode")
+ * and that band (AT+QCFG="band") before resetting the modem, and to that operator (AT+COPS=4,
+ * which falls back to automatic selection by itself) once it answers again, as the operator
+ * selection does not survive the reset. If the modem has not registered within
+ * NETWORK_TARGETED_TIMEOUT_MS the full band set read from the modem before it was first
+ * narrowed is restored with automatic scanning.
+ *
+ * The band and scan mode settings are kept in the modem's NVM. Once a targeted attach has
+ * registered, the full set is written back with deferred effect, so the current registration
+ * stands but any later modem reboot scans everything; if registration is lost while still
+ * narrowed the full set is restored at once.
+ *
+ * This file only parses replies and builds commands; the modem dialogue lives in tracking.cpp.
+ */
+
+#ifndef NETWORK_CACHE_H
+#define NETWORK_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define NETWORK_TARGETED_TIMEOUT_MS 30000
+#define NETWORK_SCAN_TIMEOUT_MS 90000
+#define NETWORK_BOOT_TIMEOUT_MS 10000 // the modem answers AT again within this after AT+CFUN=1,1
+#define NETWORK_BAND_MASK_CHARS 36 // "0x" and up to 128 bands in hex
+
+enum NetworkRat : uint8_t
+{
+    NETWORK_RAT_GSM,
+    NETWORK_RAT_LTE
+};
+
+/**
+ * @brief What the modem was registered on
+ */
+struct NetworkSelection
+{
+    char plmn[7];  // MCC and MNC digits
+    NetworkRat rat;
+    uint8_t band;  // LTE band number, or GSM 900, 1800, 850 and 1900 as 1 to 4; 0 if unknown
+};
+
+/**
+ * @brief The band configuration to restore for a full scan, as the modem reported it
+ */
+struct NetworkBands
+{
+    char gsm[NETWORK_BAND_MASK_CHARS + 1];
+    char lte[NETWORK_BAND_MASK_CHARS + 1];
+};
+
+/**
+ * @brief - read the operator and RAT from a +COPS: <mode>,2,"<plmn>",<act> reply
+ * @return false if not registered or not in numeric format
+ */
+bool network_parse_cops(const char *reply, NetworkSelection &selection);
+
+/**
+ * @brief - read the band from a +QNWINFO: "<act>","<plmn>","<band>",<channel> reply
+ */
+bool network_parse_qnwinfo(const char *reply, NetworkSelection &selection);
+
+/**
+ * @brief - read a +QCFG: "band",<gsm>,<lte> reply
+ */
+bool network_parse_bands(const char *reply, NetworkBands &bands);
+
+/**
+ * @return true if a +CREG, +CGREG or +CEREG line in the reply says registered, home or roaming
+ */
+bool network_registered(const char *reply);
+
+/**
+ * @brief - the commands that narrow the next scan to a selection. The band command is left
+ * empty if the band or the full configuration is unknown
+ */
+void network_scan_mode_command(const NetworkSelection &selection, char *out, size_t size);
+void network_band_command(const NetworkSelection &selection, const NetworkBands &bands, char *out, size_t size);
+void network_operator_command(const NetworkSelection &selection, char *out, size_t size);
+
+/**
+ * @brief - the commands that restore a full scan, empty band command if the bands are unknown
+ * @param immediate: apply now, or only from the next modem reboot
+ */
+void network_full_band_command(const NetworkBands &bands, bool immediate, char *out, size_t size);
+void network_full_scan_mode_command(bool immediate, char *out, size_t size);
+
+/**
+ * @brief Registration times, kept across restarts
+ */
+struct NetworkAttachStats
+{
+    uint32_t targeted;    // bring-ups that registered on the cached selection
+    uint32_t targeted_ms; // their total registration time
+    uint32_t scanned;     // bring-ups that registered after a full scan
+    uint32_t scanned_ms;
+    uint32_t fallbacks;   // targeted attempts that timed out and fell back to a full scan
+    uint32_t failures;    // no registration at all
+    uint32_t last_ms;
+    bool last_targeted;
+};
+
+#endif
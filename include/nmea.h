@@ -0,0 +1,76 @@
+/**
+ * @file nmea.h
+ * @brief Field-slicing NMEA parser for the GGA and RMC sentences the tracker reads
+ *
+ * Each complete sentence in the receive buffer is checksummed while its field starts are
+ * recorded; the fields the tracker needs are then read by index and converted straight to
+ * integers in place. Nothing is copied and no other sentence or field is decoded.
+ *
+ * Values follow TinyGPSPlus semantics so the two can be compared field for field: coordinates
+ * round exactly as its RawDegrees do, HDOP, speed and course are x100, an empty field keeps
+ * the previous value, and location, speed and course are held pending until a sentence that
+ * reports a fix commits them. Unlike TinyGPSPlus, nothing is taken from a sentence before its
+ * checksum passes, a sentence split across two reads is dropped, an empty date never
+ * yields a timestamp, and a number that starts with a blank or (other than a decimal) a sign
+ * reads as 0 where TinyGPSPlus's atol() skips them. tools/nmea_diff.cpp checks the rest.
+ */
+
+#ifndef NMEA_H
+#define NMEA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "fix.h"
+
+#define NMEA_MAX_FIELDS 16 // RMC and GGA fields past this are not needed
+
+class NmeaParser
+{
+public:
+    NmeaParser();
+
+    /**
+     * @brief - parse every complete GGA and RMC sentence in a burst
+     * @param burst: null terminated NMEA text
+     * @param fix: filled with the latest values, except time_ms
+     * @return true once any sentence has reported a fix location
+     */
+    bool decode(const char *burst, GpsFix &fix);
+
+    uint32_t passed() const { return _passed; } // sentences with a good checksum
+    uint32_t failed() const { return _failed; }
+
+private:
+    void rmc(const char *const *fields, uint8_t count);
+    void gga(const char *const *fields, uint8_t count);
+    void location(const char *const *fields, uint8_t count, uint8_t first);
+    void commit_location();
+
+    struct Coordinate
+    {
+        int32_t magnitude_e7;
+        bool negative;
+    };
+
+    // Parsed from every sentence, committed by those with a fix
+    Coordinate _new_lat;
+    Coordinate _new_lng;
+    uint16_t _new_speed;
+    uint16_t _new_course;
+
+    int32_t _lat_e7;
+    int32_t _lng_e7;
+    uint32_t _time; // hhmmsscc
+    uint32_t _date; // ddmmyy
+    uint16_t _hdop;
+    uint16_t _speed;
+    uint16_t _course;
+    uint8_t _sats;
+    bool _location_valid;
+    bool _time_valid;
+    bool _date_valid;
+    uint32_t _passed;
+    uint32_t _failed;
+};
+
+#endif
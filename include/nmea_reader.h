@@ -0,0 +1,66 @@
+/**
+ * @file nmea_reader.h
+ * @brief Non-blocking assembly of receiver bursts from a serial port
+ *
+ * Every poll moves whatever the port has received into the burst buffer and returns at once,
+ * so at 9600 baud the 64-byte SoftwareSerial buffer only has to cover the time between two
+ * loop passes. A burst is complete once the line has been quiet for NMEA_BURST_GAP_MS: the
+ * receiver sends each epoch's sentences back to back, so the gap falls between epochs even at
+ * 5 Hz. A burst that fills the buffer is cut there and the rest starts the next one.
+ */
+
+#ifndef NMEA_READER_H
+#define NMEA_READER_H
+
+#include <Arduino.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define NMEA_BURST_GAP_MS 20 // two byte times are 2 ms; the gap between 5 Hz epochs is 40 ms or more
+
+class NmeaReader
+{
+public:
+    /**
+     * @param buffer: receives the burst, null terminated
+     * @param size: of the buffer
+     */
+    NmeaReader(char *buffer, size_t size);
+
+    /**
+     * @brief - drain the port without waiting
+     * @return true when a burst is complete; it stays until clear()
+     */
+    bool poll(Stream &port, uint32_t now_ms);
+
+    /**
+     * @brief - drop the completed burst and start the next
+     */
+    void clear();
+
+    const char *burst() const { return _buffer; }
+    size_t length() const { return _length; }
+    uint32_t started_ms() const { return _started_ms; } // first byte drained
+
+    /**
+     * @brief - the bytes drained by the last poll, the tail of burst()
+     */
+    const char *fresh() const { return _buffer + _fresh; }
+    size_t fresh_length() const { return _length - _fresh; }
+
+    uint32_t bursts() const { return _bursts; }
+    uint32_t cut() const { return _cut; } // bursts cut by a full buffer
+
+private:
+    char *_buffer;
+    size_t _size;
+    size_t _length;
+    size_t _fresh;
+    uint32_t _started_ms;
+    uint32_t _drained_ms; // last byte drained
+    bool _complete;
+    uint32_t _bursts;
+    uint32_t _cut;
+};
+
+#endif
@@ -0,0 +1,53 @@
+/**
+ * @file pipeline.h
+ * @brief Compile-time composed fix pipeline: one source followed by filters and sinks
+ *
+ * A source provides `bool poll(FixEvent &event)`. Every later stage provides
+ * `bool process(FixEvent &event)`; filters return false to stop the event, sinks consume it
+ * and return true so the next sink sees it too. Stages are plain members and are called
+ * directly, so a build only contains the stages named in its pipeline type.
+ */
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <tuple>
+#include <utility>
+#include "events.h"
+
+template <typename Source, typename... Stages>
+class Pipeline
+{
+public:
+    Source source;
+    std::tuple<Stages...> stages;
+
+    /**
+     * @brief - poll the source once and push any new fix through the stages
+     * @return true if a fix reached the end of the pipeline
+     */
+    bool run()
+    {
+        FixEvent event;
+        if (!source.poll(event))
+        {
+            return false;
+        }
+        return process(event, std::index_sequence_for<Stages...>());
+    }
+
+    template <size_t I>
+    typename std::tuple_element<I, std::tuple<Stages...>>::type &stage()
+    {
+        return std::get<I>(stages);
+    }
+
+private:
+    template <size_t... I>
+    bool process(FixEvent &event, std::index_sequence<I...>)
+    {
+        return (std::get<I>(stages).process(event) && ...);
+    }
+};
+
+#endif
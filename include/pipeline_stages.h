@@ -0,0 +1,115 @@
+/**
+ * @file pipeline_stages.h
+ * @brief Reusable pipeline stages that do not depend on the board wiring
+ */
+
+#ifndef PIPELINE_STAGES_H
+#define PIPELINE_STAGES_H
+
+#include <Arduino.h>
+#include "events.h"
+#include "geo_fixed.h"
+#include "hot_path.h"
+
+/**
+ * @brief Marks a fix as moved when it is more than THRESHOLD_CM from the last moved fix.
+ * With DROP_STATIONARY, stationary fixes stop here.
+ */
+template <uint32_t THRESHOLD_CM = 0, bool DROP_STATIONARY = false>
+class MovementFilter
+{
+public:
+    MovementFilter() : _has_last(false), _lat_e7(0), _lng_e7(0) {}
+
+    HOT_PATH bool process(FixEvent &event)
+    {
+        event.moved = !_has_last || geo_equirect_cm(_lat_e7, _lng_e7, event.fix.lat_e7, event.fix.lng_e7) > THRESHOLD_CM;
+        if (event.moved)
+        {
+            _has_last = true;
+            _lat_e7 = event.fix.lat_e7;
+            _lng_e7 = event.fix.lng_e7;
+        }
+        return event.moved || !DROP_STATIONARY;
+    }
+
+private:
+    bool _has_last;
+    int32_t _lat_e7;
+    int32_t _lng_e7;
+};
+
+/**
+ * @brief Records how long fixes take from the start of their serial read to this stage
+ */
+class LatencyMeter
+{
+public:
+    bool process(FixEvent &event)
+    {
+        uint32_t latency = millis() - event.fix.time_ms;
+        _stats.fixes++;
+        _stats.last_ms = latency;
+        _stats.total_ms += latency;
+        if (latency > _stats.max_ms)
+        {
+            _stats.max_ms = latency;
+        }
+        return true;
+    }
+
+    struct Stats
+    {
+        uint32_t fixes;
+        uint32_t last_ms;
+        uint32_t max_ms;
+        uint32_t total_ms;
+    };
+
+    const Stats &stats() const { return _stats; }
+
+private:
+    Stats _stats = {};
+};
+
+/**
+ * @brief Hands fixes to another task through a lock-free queue; a full queue drops the fix
+ */
+template <typename Queue, Queue &QUEUE>
+class QueueSink
+{
+public:
+    bool process(FixEvent &event)
+    {
+        QUEUE.push(event);
+        return true;
+    }
+};
+
+/**
+ * @brief Takes fixes queued by another task, for pipelines split across tasks
+ */
+template <typename Queue, Queue &QUEUE>
+class QueueSource
+{
+public:
+    bool poll(FixEvent &event)
+    {
+        return QUEUE.pop(event);
+    }
+};
+
+/**
+ * @brief Publishes the fix on the fix event channel (status page, logger, ...)
+ */
+class BusSink
+{
+public:
+    bool process(FixEvent &event)
+    {
+        fix_events.publish(event);
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,26 @@
+/**
+ * @file replay_track.h
+ * @brief Recorded NMEA used by the replay pipeline source (TRACKER_REPLAY builds)
+ *
+ * One entry per receiver burst: RMC + GGA, 10 s apart, with one stationary burst.
+ */
+
+#ifndef REPLAY_TRACK_H
+#define REPLAY_TRACK_H
+
+static const char *const REPLAY_TRACK[] = {
+    "$GPRMC,081200.00,A,0116.9980,S,03649.0020,E,0.120,,220824,,,A*6F\r\n"
+    "$GPGGA,081200.00,0116.9980,S,03649.0020,E,1,07,1.21,1650.2,M,-13.5,M,,*51\r\n",
+    "$GPRMC,081210.00,A,0116.9740,S,03649.0260,E,0.120,,220824,,,A*6A\r\n"
+    "$GPGGA,081210.00,0116.9740,S,03649.0260,E,1,07,1.21,1650.2,M,-13.5,M,,*54\r\n",
+    "$GPRMC,081220.00,A,0116.9440,S,03649.0560,E,0.120,,220824,,,A*6D\r\n"
+    "$GPGGA,081220.00,0116.9440,S,03649.0560,E,1,07,1.21,1650.2,M,-13.5,M,,*53\r\n",
+    "$GPRMC,081230.00,A,0116.9440,S,03649.0560,E,0.120,,220824,,,A*6C\r\n"
+    "$GPGGA,081230.00,0116.9440,S,03649.0560,E,1,07,1.21,1650.2,M,-13.5,M,,*52\r\n",
+    "$GPRMC,081240.00,A,0116.9080,S,03649.0980,E,0.120,,220824,,,A*61\r\n"
+    "$GPGGA,081240.00,0116.9080,S,03649.0980,E,1,07,1.21,1650.2,M,-13.5,M,,*5F\r\n",
+};
+
+#define REPLAY_TRACK_LENGTH (sizeof(REPLAY_TRACK) / sizeof(REPLAY_TRACK[0]))
+
+#endif
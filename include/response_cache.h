@@ -0,0 +1,72 @@
+/**
+ * @file response_cache.h
+ * @brief Rendered pages for the AP web server, kept until what they show changes
+ *
+ * The status and log pages only change with a fix, a modem or upload event or new modem
+ * output, yet every request used to render them afresh. Each is now rendered once per change:
+ * the page and, when it comes out smaller, a gzip copy are kept in one fixed buffer and sent
+ * straight from it. Every event above bumps a version counter, and an entry rendered under an
+ * older version is rendered again on its next request. So are entries older than
+ * RESPONSE_CACHE_MAX_AGE_MS, which keeps the counters on the status page moving while parked.
+ */
+
+#ifndef RESPONSE_CACHE_H
+#define RESPONSE_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define RESPONSE_CACHE_SIZE 8192
+#define RESPONSE_CACHE_MAX_AGE_MS 10000
+
+enum CachedRoute : uint8_t
+{
+    CACHED_STATUS,
+    CACHED_LOGS,
+    CACHED_ROUTES
+};
+
+struct CachedResponse
+{
+    const uint8_t *body; // in the cache buffer, valid until the next response_cache_put()
+    size_t length;
+    bool gzip;
+};
+
+/**
+ * @brief - subscribe to the events that change the cached pages
+ */
+void response_cache_begin();
+
+/**
+ * @brief - make every cached page stale, e.g. when the logs change. Safe from any task
+ */
+void response_cache_invalidate();
+
+/**
+ * @brief - look up a page rendered under the current version
+ * @param accept_gzip: the client sent gzip in Accept-Encoding
+ * @param now: millis()
+ * @return false if the page must be rendered and put
+ */
+bool response_cache_get(CachedRoute route, bool accept_gzip, uint32_t now, CachedResponse &out);
+
+/**
+ * @brief - keep a page rendered after a response_cache_get() miss, with a gzip copy if it is
+ * smaller and fits
+ * @return false if the page does not fit
+ */
+bool response_cache_put(CachedRoute route, const char *body, size_t length, uint32_t now);
+
+struct ResponseCacheStats
+{
+    uint32_t hits;
+    uint32_t gzip_hits;
+    uint32_t renders;
+    uint32_t bytes_saved; // by sending the gzip copy
+    uint32_t version;
+};
+
+ResponseCacheStats response_cache_stats();
+
+#endif
@@ -0,0 +1,58 @@
+/**
+ * @file route_monitor.h
+ * @brief Planned-route corridor monitoring on the device
+ *
+ * The route arrives as an encoded polyline (Google format, 1e-5 degrees), is kept in flash and
+ * decoded at boot into points projected to local metres. Each fix is matched against the
+ * segments around a running cursor first, so following the route costs a handful of segment
+ * tests; only when that fails is the uniform grid index over the route consulted.
+ * Deviation and return are published as route events with hysteresis.
+ */
+
+#ifndef ROUTE_MONITOR_H
+#define ROUTE_MONITOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define ROUTE_MAX_POINTS 256
+#define ROUTE_MAX_CELLS 256
+#define ROUTE_MAX_CELL_ENTRIES 1024
+#define ROUTE_DEFAULT_CORRIDOR_M 50
+#define ROUTE_CURSOR_WINDOW 3   // segments checked either side of the cursor
+#define ROUTE_DEVIATE_FIXES 2   // consecutive fixes outside the corridor before deviating
+#define ROUTE_RETURN_PERCENT 80 // must come back within this share of the corridor
+
+/**
+ * @brief - load the stored route, if any, and subscribe to fix events
+ */
+void route_begin();
+
+/**
+ * @brief - replace the route
+ * @param polyline: encoded polyline text
+ * @param length: length of the text
+ * @param corridor_m: allowed cross-track distance
+ * @return false if the polyline is invalid, too long or could not be stored
+ */
+bool route_set(const char *polyline, size_t length, uint16_t corridor_m);
+
+void route_clear();
+
+struct RouteStatus
+{
+    bool loaded;
+    bool on_route;
+    uint16_t points;
+    uint16_t corridor_m;
+    uint16_t segment;       // segment the last fix matched
+    uint32_t length_m;      // total route length
+    uint32_t progress_m;    // distance along the route to the last fix
+    int32_t cross_track_m;  // positive to the right of the direction of travel
+    uint32_t cursor_hits;   // fixes matched near the cursor
+    uint32_t index_lookups; // fixes that needed the grid index
+};
+
+RouteStatus route_status();
+
+#endif
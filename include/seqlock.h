@@ -0,0 +1,70 @@
+/**
+ * @file seqlock.h
+ * @brief Single-writer, double-buffered sequence lock
+ *
+ * The writer updates the two copies one after the other, bumping the sequence counter before
+ * each. The sequence parity tells readers which copy is stable, so a reader never waits for
+ * the writer to finish; it only retries if the writer moved on while it was copying.
+ * Safe to read from interrupt handlers and other tasks. There must be a single writer.
+ */
+
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define SEQLOCK_BARRIER() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+template <typename T>
+class Seqlock
+{
+public:
+    Seqlock() : _sequence(0)
+    {
+        memset((void *)_copies, 0, sizeof(_copies));
+    }
+
+    /**
+     * @brief - publish a new value. Must only be called from one context
+     */
+    void write(const T &value)
+    {
+        _sequence = _sequence + 1; // odd: readers use copy 1 while copy 0 is rewritten
+        SEQLOCK_BARRIER();
+        memcpy((void *)&_copies[0], &value, sizeof(T));
+        SEQLOCK_BARRIER();
+        _sequence = _sequence + 1; // even: readers use copy 0 while copy 1 is rewritten
+        SEQLOCK_BARRIER();
+        memcpy((void *)&_copies[1], &value, sizeof(T));
+        SEQLOCK_BARRIER();
+    }
+
+    /**
+     * @brief - copy out a consistent value, retrying if the writer overtook the read
+     */
+    T read() const
+    {
+        T value;
+        uint32_t start;
+        do
+        {
+            start = _sequence;
+            SEQLOCK_BARRIER();
+            memcpy(&value, (const void *)&_copies[start & 1], sizeof(T));
+            SEQLOCK_BARRIER();
+        } while (_sequence != start);
+        return value;
+    }
+
+    /**
+     * @brief - number of writes so far, usable as a cheap change detector
+     */
+    uint32_t version() const { return _sequence >> 1; }
+
+private:
+    volatile uint32_t _sequence;
+    volatile T _copies[2];
+};
+
+#endif
@@ -0,0 +1,44 @@
+/**
+ * @file spatial_key.h
+ * @brief Geohash and Hilbert-curve cell keys on 1e-7 degree coordinates
+ *
+ * Both keys start from the same 32-bit grid: latitude and longitude are scaled exactly to
+ * unsigned 32-bit fractions of their range with a reciprocal multiply. A geohash is the two
+ * fractions with their bits interleaved (longitude first), so a shorter prefix is a larger
+ * cell. A Hilbert key orders the cells along a Hilbert curve, so nearby keys are nearby
+ * places; it is computed with a branch-free prefix scan over all bits at once instead of one
+ * quadrant per step. Neither needs floating point or division.
+ */
+
+#ifndef SPATIAL_KEY_H
+#define SPATIAL_KEY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define GEOHASH_MAX_CHARS 12
+#define HILBERT_MAX_ORDER 16
+
+/**
+ * @brief - interleaved geohash bits, longitude first, most significant bit first
+ */
+uint64_t geohash_bits(int32_t lat_e7, int32_t lng_e7);
+
+/**
+ * @brief - base32 geohash text
+ * @param chars: number of characters, 1..GEOHASH_MAX_CHARS (7 is about 150 m)
+ * @param out: at least chars + 1 bytes, null terminated
+ */
+void geohash_encode(int32_t lat_e7, int32_t lng_e7, uint8_t chars, char *out);
+
+/**
+ * @brief - position along the Hilbert curve over a 2^order by 2^order grid
+ * @param order: 1..HILBERT_MAX_ORDER; 16 gives cells of about 610 by 305 m at the equator
+ */
+uint32_t hilbert_key(int32_t lat_e7, int32_t lng_e7, uint8_t order);
+
+/* Straightforward one-bit-per-step versions, kept to check and benchmark the ones above */
+uint64_t geohash_bits_bisect(int32_t lat_e7, int32_t lng_e7);
+uint32_t hilbert_key_iterative(int32_t lat_e7, int32_t lng_e7, uint8_t order);
+
+#endif
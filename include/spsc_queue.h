@@ -0,0 +1,75 @@
+/**
+ * @file spsc_queue.h
+ * @brief Lock-free single-producer, single-consumer ring queue
+ *
+ * The producer only writes the head index and the consumer only writes the tail, so neither
+ * side takes a lock or disables interrupts. Each index is published with release ordering
+ * after the slot it covers has been written or read, which makes the queue safe between tasks
+ * on different cores. There must be exactly one producer and one consumer.
+ */
+
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+template <typename T, size_t LENGTH>
+class SpscQueue
+{
+    static_assert((LENGTH & (LENGTH - 1)) == 0, "LENGTH must be a power of two");
+
+public:
+    SpscQueue() : _head(0), _tail(0), _dropped(0) {}
+
+    /**
+     * @brief - append an item. Producer side only
+     * @return false, and counts a drop, if the queue is full
+     */
+    bool push(const T &item)
+    {
+        uint32_t head = __atomic_load_n(&_head, __ATOMIC_RELAXED);
+        if (head - __atomic_load_n(&_tail, __ATOMIC_ACQUIRE) == LENGTH)
+        {
+            _dropped++;
+            return false;
+        }
+        _items[head & (LENGTH - 1)] = item;
+        __atomic_store_n(&_head, head + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    /**
+     * @brief - take the oldest item. Consumer side only
+     * @return false if the queue is empty
+     */
+    bool pop(T &item)
+    {
+        uint32_t tail = __atomic_load_n(&_tail, __ATOMIC_RELAXED);
+        if (__atomic_load_n(&_head, __ATOMIC_ACQUIRE) == tail)
+        {
+            return false;
+        }
+        item = _items[tail & (LENGTH - 1)];
+        __atomic_store_n(&_tail, tail + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    size_t size() const
+    {
+        return __atomic_load_n(&_head, __ATOMIC_ACQUIRE) - __atomic_load_n(&_tail, __ATOMIC_ACQUIRE);
+    }
+
+    /**
+     * @brief - items refused because the queue was full, written by the producer
+     */
+    uint32_t dropped() const { return _dropped; }
+
+private:
+    T _items[LENGTH];
+    uint32_t _head; // next slot to write
+    uint32_t _tail; // next slot to read
+    uint32_t _dropped;
+};
+
+#endif
@@ -0,0 +1,108 @@
+/**
+ * @file track_archive.h
+ * @brief Compressed track history in a ring of flash sectors
+ *
+ * Fixes are collected in a RAM block and written to flash as one CRC-protected block once it
+ * fills up or grows old. A block header holds its first fix in full and the time range it
+ * covers; the remaining fixes are encoded against their predecessor:
+ *  - timestamps as the zigzag varint of the change in interval (delta-of-delta), which is 0
+ *    at a steady fix rate
+ *  - coordinates as zigzag varint deltas, either from the previous fix or from a straight-line
+ *    prediction, whichever is shorter
+ *  - the moved flag and a quality-changed flag packed into the timestamp varint; HDOP and
+ *    satellite changes follow in one bit-packed byte when small
+ * The first UTC of every sector is indexed in RAM and block headers carry their time range, so
+ * a time query skips straight to the sector and block holding it without decoding the rest.
+ * Fixes without a UTC time are not stored. On synthetic tracks, headers included, a block
+ * holds 4.2-4.5x the fixes of plain FixRecords when parked or at 1 s fixes, 3.8x for mixed
+ * parking and driving and 2.8x for continuous driving at 10 s fixes, where the changes in
+ * speed and heading do not fit in single-byte residuals.
+ *
+ * A block takes up to ARCHIVE_FLUSH_S of fixes to fill, and writing it any earlier would spend
+ * most of the compression on headers. Instead, every ARCHIVE_CHECKPOINT_S the pending block is
+ * also appended to a journal of two sectors used in turn, and the newest copy not yet in the
+ * ring is taken back as the pending block at boot, so a power loss costs at most a minute of
+ * fixes. Each journal sector is erased about once an hour while fixes arrive.
+ *
+ * Sectors are taken from a pool and kept in time order in RAM. When fewer than
+ * ARCHIVE_SPARE_SECTORS are free, the oldest history is thinned instead of dropped: a source
+ * sector's fixes are re-encoded keeping every second one and written into the sector before it
+ * in time, so two sources share a sector; thinned sectors are thinned once more later, leaving
+ * every fourth fix. Fixes either side of a stop, a start or a gap, and the first and last fix of
+ * each source, are always kept. The newest ARCHIVE_RECENT_SECTORS are never thinned. The oldest
+ * sector is dropped only when a new head would leave thinning no free sector, which happens once
+ * everything older than the recent sectors is at ARCHIVE_MAX_LEVEL.
+ *
+ * Thinning runs one block per track_archive_service() call. The thinned blocks are written
+ * without their magic and only made valid, and the source retired, once the whole source is
+ * done. A source left behind by a pass interrupted before that is found at boot, its last fix
+ * being in a more thinned sector, and retired then. A pass interrupted during the commit
+ * itself leaves the source whole and part of its thinned copy valid; that part is found at
+ * boot, starting at the source's first fix in a more thinned sector, and rolled back.
+ */
+
+#ifndef TRACK_ARCHIVE_H
+#define TRACK_ARCHIVE_H
+
+#include <stddef.h>
+#include "fix_record.h"
+
+#define ARCHIVE_BLOCK_SIZE 256 // flash block including its header
+#define ARCHIVE_FLUSH_S 600    // longest a fix waits in RAM before its block is written
+#define ARCHIVE_CHECKPOINT_S 60 // longest a fix waits in RAM before the pending block is journalled
+
+#define ARCHIVE_SPARE_SECTORS 8   // thinning starts when fewer sectors are free
+#define ARCHIVE_RECENT_SECTORS 16 // newest sectors, never thinned
+#define ARCHIVE_MAX_LEVEL 2       // every 2nd, then every 4th fix
+#define ARCHIVE_THIN_STRIDE 2     // fixes kept per pass, one in this many
+#define ARCHIVE_GAP_S 120         // fixes either side of a longer gap are kept
+
+/**
+ * @brief - index the archive sectors and subscribe to fix events
+ */
+void track_archive_begin();
+
+/**
+ * @brief - copy out archived fixes with from_utc <= utc <= to_utc, oldest first, including
+ * those not yet written to flash
+ * @param skip: number of matching records to skip, for paging through a slice
+ * @return number of records copied
+ */
+size_t track_archive_query(uint32_t from_utc, uint32_t to_utc, size_t skip, FixRecord *out, size_t max);
+
+/**
+ * @brief - run one bounded step of thinning: start a source, thin one of its blocks, or commit
+ * it. Each step reads one block and writes or erases at most a few
+ * @return true if there was work
+ */
+bool track_archive_service();
+
+/**
+ * @return true while a thinning pass is under way, so further track_archive_service() steps are due
+ */
+bool track_archive_busy();
+
+/**
+ * @brief - write the pending block now, e.g. before a restart
+ */
+bool track_archive_flush();
+
+struct ArchiveStats
+{
+    uint32_t records;
+    uint32_t blocks;
+    uint32_t stored_bytes; // flash used by the blocks, headers included
+    uint32_t oldest_utc;
+    uint16_t sectors;
+    uint16_t pending; // records waiting in RAM
+    uint16_t free_sectors;
+    uint32_t thinned;     // fixes removed by thinning
+    uint32_t decimations; // source sectors thinned
+    uint32_t dropped;     // fixes erased with the oldest sector
+    uint32_t checkpoints; // copies of the pending block journalled
+    uint16_t restored;    // fixes taken back from the journal at boot
+};
+
+ArchiveStats track_archive_stats();
+
+#endif
@@ -0,0 +1,45 @@
+/**
+ * @file ubx.h
+ * @brief Minimal u-blox UBX configuration messages for the NEO-6M
+ */
+
+#ifndef UBX_H
+#define UBX_H
+
+#include <Arduino.h>
+
+#define UBX_CLASS_CFG 0x06
+#define UBX_CFG_MSG 0x01
+#define UBX_CFG_RATE 0x08
+#define UBX_CFG_RST 0x04
+
+#define NMEA_CLASS 0xF0
+#define NMEA_GGA 0x00
+#define NMEA_GLL 0x01
+#define NMEA_GSA 0x02
+#define NMEA_GSV 0x03
+#define NMEA_RMC 0x04
+#define NMEA_VTG 0x05
+
+/**
+ * @brief - frame and send a UBX message (sync chars, header, payload, Fletcher checksum)
+ */
+void ubx_send(Stream &port, uint8_t msg_class, uint8_t msg_id, const uint8_t *payload, uint16_t length);
+
+/**
+ * @brief - set the navigation solution period (CFG-RATE), e.g. 200 ms for 5 Hz
+ */
+void ubx_set_rate(Stream &port, uint16_t period_ms);
+
+/**
+ * @brief - set how often an NMEA sentence is output on the current port (CFG-MSG), 0 disables it
+ */
+void ubx_set_nmea_rate(Stream &port, uint8_t nmea_id, uint8_t rate);
+
+/**
+ * @brief - restart the GNSS engine only (CFG-RST hot start), keeping the configuration and
+ * the ephemeris; the receiver stays silent for about a second
+ */
+void ubx_reset_gnss(Stream &port);
+
+#endif
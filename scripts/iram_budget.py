@@ -0,0 +1,26 @@
+# Post-link check that the IRAM sections still fit, with some headroom left for the SDK.
+# Set custom_iram_reserve in platformio.ini to change the headroom (bytes).
+Import("env")
+
+import subprocess
+
+IRAM_SIZE = 0x8000
+
+
+def check_iram(source, target, env):
+    elf = str(target[0])
+    reserve = int(env.GetProjectOption("custom_iram_reserve", "1024"))
+    output = subprocess.check_output([env.subst("$SIZETOOL"), "-A", elf]).decode()
+    used = 0
+    for line in output.splitlines():
+        fields = line.split()
+        if len(fields) >= 2 and fields[0].startswith(".iram0"):
+            used += int(fields[1])
+    budget = IRAM_SIZE - reserve
+    print("IRAM: %d of %d bytes used (%d reserved)" % (used, IRAM_SIZE, reserve))
+    if used > budget:
+        print("Error: IRAM over budget by %d bytes" % (used - budget))
+        env.Exit(1)
+
+
+env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", check_iram)
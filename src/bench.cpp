@@ -0,0 +1,229 @@
+/**
+ * @file bench.cpp
+ * @brief On-device cycle benchmarks, see bench.h
+ */
+
+#include <Arduino.h>
+#include <math.h>
+#include "bench.h"
+#include "geo_fixed.h"
+#include "spatial_key.h"
+
+#define FLASH_MAPPED_BASE 0x40200000
+#define EVICT_OFFSET 0x40000
+#define EVICT_SIZE 0x10000 // twice the instruction cache
+#define EVICT_STRIDE 16
+#define GEO_BENCH_POINTS 32
+#define DEG_TO_RAD_E7 (M_PI / 180e7)
+#define EARTH_RADIUS_CM 637100880.0
+
+void bench_evict_cache()
+{
+#if defined(ARDUINO_ARCH_ESP8266)
+    volatile const uint32_t *ptr = (const uint32_t *)(FLASH_MAPPED_BASE + EVICT_OFFSET);
+    uint32_t sink = 0;
+    for (uint32_t i = 0; i < EVICT_SIZE / sizeof(uint32_t); i += EVICT_STRIDE / sizeof(uint32_t))
+    {
+        sink += ptr[i];
+    }
+    (void)sink;
+#endif
+}
+
+static uint32_t count_sentences(const char *burst)
+{
+    uint32_t sentences = 0;
+    for (; *burst; burst++)
+    {
+        sentences += *burst == '$';
+    }
+    return sentences;
+}
+
+BenchResult bench_nmea(NmeaDecoder decode, void *ctx, const char *const *bursts, size_t count, uint8_t rounds)
+{
+    BenchResult result = {0, 0, 0};
+    uint64_t warm = 0, cold = 0;
+    GpsFix fix;
+    for (size_t i = 0; i < count; i++)
+    {
+        uint32_t sentences = count_sentences(bursts[i]);
+        for (uint8_t round = 0; round < rounds; round++)
+        {
+            bench_evict_cache();
+            uint32_t start = ESP.getCycleCount();
+            decode(bursts[i], fix, ctx);
+            cold += ESP.getCycleCount() - start;
+
+            start = ESP.getCycleCount();
+            decode(bursts[i], fix, ctx);
+            warm += ESP.getCycleCount() - start;
+            result.sentences += sentences;
+        }
+        yield();
+    }
+    if (result.sentences)
+    {
+        result.warm_cycles = warm / result.sentences;
+        result.cold_cycles = cold / result.sentences;
+    }
+    return result;
+}
+
+struct GeoPoint
+{
+    int32_t lat_e7;
+    int32_t lng_e7;
+};
+
+static double libm_equirect_cm(const GeoPoint &a, const GeoPoint &b)
+{
+    double x = (b.lng_e7 - a.lng_e7) * DEG_TO_RAD_E7 * cos((a.lat_e7 + b.lat_e7) / 2 * DEG_TO_RAD_E7);
+    double y = (b.lat_e7 - a.lat_e7) * DEG_TO_RAD_E7;
+    return sqrt(x * x + y * y) * EARTH_RADIUS_CM;
+}
+
+static double libm_haversine_cm(const GeoPoint &a, const GeoPoint &b)
+{
+    double lat1 = a.lat_e7 * DEG_TO_RAD_E7, lat2 = b.lat_e7 * DEG_TO_RAD_E7;
+    double sin_dlat = sin((lat2 - lat1) / 2);
+    double sin_dlng = sin((b.lng_e7 - a.lng_e7) * DEG_TO_RAD_E7 / 2);
+    double h = sin_dlat * sin_dlat + cos(lat1) * cos(lat2) * sin_dlng * sin_dlng;
+    return 2 * EARTH_RADIUS_CM * asin(sqrt(h));
+}
+
+const char *geo_kernel_name(GeoKernel kernel)
+{
+    switch (kernel)
+    {
+    case GEO_BENCH_SIN:
+        return "sin";
+    case GEO_BENCH_ATAN2:
+        return "atan2";
+    case GEO_BENCH_SQRT:
+        return "sqrt";
+    case GEO_BENCH_EQUIRECT:
+        return "equirectangular";
+    case GEO_BENCH_HAVERSINE:
+        return "haversine";
+    default:
+        return "unknown";
+    }
+}
+
+GeoBenchResult bench_geo(uint16_t calls)
+{
+    // Points a few km apart around the receiver's latitudes; sin, atan2 and sqrt reuse the
+    // same words as angles, vectors and radicands. The libm side runs in float where float
+    // holds the inputs, and in double for the distances, which 1e-7 degrees needs
+    GeoPoint points[GEO_BENCH_POINTS];
+    uint32_t seed = 0x2545F491;
+    for (uint8_t i = 0; i < GEO_BENCH_POINTS; i++)
+    {
+        seed = seed * 1664525 + 1013904223;
+        points[i].lat_e7 = -12800000 + (int32_t)(seed >> 8) % 400000;
+        seed = seed * 1664525 + 1013904223;
+        points[i].lng_e7 = 368000000 + (int32_t)(seed >> 8) % 400000;
+    }
+
+    GeoBenchResult result = {};
+    volatile int64_t fixed_sink = 0;
+    volatile float float_sink = 0;
+    volatile double double_sink = 0;
+    uint32_t cycles[2 * GEO_BENCH_KERNELS] = {};
+    for (uint16_t call = 0; call < calls; call++)
+    {
+        const GeoPoint &a = points[call % GEO_BENCH_POINTS];
+        const GeoPoint &b = points[(call + 1) % GEO_BENCH_POINTS];
+        uint32_t start = ESP.getCycleCount();
+        fixed_sink = geo_sin(geo_e7_to_angle(a.lat_e7));
+        cycles[0] += ESP.getCycleCount() - start;
+        start = ESP.getCycleCount();
+        float_sink = sinf(a.lat_e7 * (float)DEG_TO_RAD_E7);
+        cycles[1] += ESP.getCycleCount() - start;
+
+        start = ESP.getCycleCount();
+        fixed_sink = geo_atan2(a.lat_e7, a.lng_e7);
+        cycles[2] += ESP.getCycleCount() - start;
+        start = ESP.getCycleCount();
+        float_sink = atan2f(a.lat_e7, a.lng_e7);
+        cycles[3] += ESP.getCycleCount() - start;
+
+        start = ESP.getCycleCount();
+        fixed_sink = geo_isqrt32(a.lng_e7);
+        cycles[4] += ESP.getCycleCount() - start;
+        start = ESP.getCycleCount();
+        float_sink = sqrtf(a.lng_e7);
+        cycles[5] += ESP.getCycleCount() - start;
+
+        start = ESP.getCycleCount();
+        fixed_sink = geo_equirect_cm(a.lat_e7, a.lng_e7, b.lat_e7, b.lng_e7);
+        cycles[6] += ESP.getCycleCount() - start;
+        start = ESP.getCycleCount();
+        double_sink = libm_equirect_cm(a, b);
+        cycles[7] += ESP.getCycleCount() - start;
+
+        start = ESP.getCycleCount();
+        fixed_sink = geo_haversine_cm(a.lat_e7, a.lng_e7, b.lat_e7, b.lng_e7);
+        cycles[8] += ESP.getCycleCount() - start;
+        start = ESP.getCycleCount();
+        double_sink = libm_haversine_cm(a, b);
+        cycles[9] += ESP.getCycleCount() - start;
+
+        if (call % 64 == 63)
+        {
+            yield();
+        }
+    }
+    (void)fixed_sink;
+    (void)float_sink;
+    (void)double_sink;
+    for (uint8_t kernel = 0; calls && kernel < GEO_BENCH_KERNELS; kernel++)
+    {
+        result.fixed_cycles[kernel] = cycles[2 * kernel] / calls;
+        result.libm_cycles[kernel] = cycles[2 * kernel + 1] / calls;
+    }
+    return result;
+}
+
+SpatialBenchResult bench_spatial(uint16_t calls)
+{
+    SpatialBenchResult result = {};
+    volatile uint64_t sink = 0;
+    uint32_t cycles[4] = {};
+    uint32_t seed = 0x9E3779B9;
+    for (uint16_t call = 0; call < calls; call++)
+    {
+        seed = seed * 1664525 + 1013904223;
+        int32_t lat_e7 = (int32_t)(seed % 1800000000) - 900000000;
+        seed = seed * 1664525 + 1013904223;
+        int32_t lng_e7 = (int32_t)(seed % 3600000000UL - 1800000000UL);
+
+        uint32_t start = ESP.getCycleCount();
+        sink = geohash_bits(lat_e7, lng_e7);
+        cycles[0] += ESP.getCycleCount() - start;
+        start = ESP.getCycleCount();
+        sink = geohash_bits_bisect(lat_e7, lng_e7);
+        cycles[1] += ESP.getCycleCount() - start;
+        start = ESP.getCycleCount();
+        sink = hilbert_key(lat_e7, lng_e7, HILBERT_MAX_ORDER);
+        cycles[2] += ESP.getCycleCount() - start;
+        start = ESP.getCycleCount();
+        sink = hilbert_key_iterative(lat_e7, lng_e7, HILBERT_MAX_ORDER);
+        cycles[3] += ESP.getCycleCount() - start;
+
+        if (call % 64 == 63)
+        {
+            yield();
+        }
+    }
+    (void)sink;
+    if (calls)
+    {
+        result.geohash_cycles = cycles[0] / calls;
+        result.geohash_bisect_cycles = cycles[1] / calls;
+        result.hilbert_cycles = cycles[2] / calls;
+        result.hilbert_iterative_cycles = cycles[3] / calls;
+    }
+    return result;
+}
@@ -0,0 +1,114 @@
+/**
+ * @file cell_cache.cpp
+ * @brief Recently visited map cells, see cell_cache.h
+ */
+
+#include <string.h>
+#include "cell_cache.h"
+#include "events.h"
+#include "spatial_key.h"
+
+static CellVisit cells[CELL_CACHE_ENTRIES]; // sorted by key
+static uint8_t cell_count = 0;
+static CellCacheStats stats = {};
+static bool have_current = false;
+
+/**
+ * @return index of the first cell with a key not below key
+ */
+static uint8_t lower_bound(uint32_t key)
+{
+    uint8_t low = 0, high = cell_count;
+    while (low < high)
+    {
+        uint8_t mid = (low + high) / 2;
+        if (cells[mid].key < key)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+static void evict_least_recent()
+{
+    uint8_t oldest = 0;
+    for (uint8_t i = 1; i < cell_count; i++)
+    {
+        if (cells[i].last_utc < cells[oldest].last_utc)
+        {
+            oldest = i;
+        }
+    }
+    memmove(&cells[oldest], &cells[oldest + 1], (cell_count - oldest - 1) * sizeof(CellVisit));
+    cell_count--;
+    stats.evictions++;
+}
+
+static void on_fix(const FixEvent &event, void *ctx)
+{
+    (void)ctx;
+    if (event.fix.utc == 0)
+    {
+        return;
+    }
+    uint32_t key = hilbert_key(event.fix.lat_e7, event.fix.lng_e7, CELL_CACHE_ORDER);
+    uint8_t index = lower_bound(key);
+    if (index == cell_count || cells[index].key != key)
+    {
+        if (cell_count == CELL_CACHE_ENTRIES)
+        {
+            evict_least_recent();
+            index = lower_bound(key);
+        }
+        memmove(&cells[index + 1], &cells[index], (cell_count - index) * sizeof(CellVisit));
+        cells[index] = {key, event.fix.utc, event.fix.utc, 0, 0};
+        cell_count++;
+    }
+    CellVisit &visit = cells[index];
+    if (have_current && stats.current_key == key && event.fix.utc > visit.last_utc)
+    {
+        visit.dwell_s += event.fix.utc - visit.last_utc;
+    }
+    visit.last_utc = event.fix.utc;
+    visit.fixes++;
+    stats.current_key = key;
+    have_current = true;
+}
+
+void cell_cache_begin()
+{
+    fix_events.subscribe(on_fix);
+}
+
+bool cell_cache_find(uint32_t key, CellVisit &visit)
+{
+    uint8_t index = lower_bound(key);
+    if (index == cell_count || cells[index].key != key)
+    {
+        return false;
+    }
+    visit = cells[index];
+    return true;
+}
+
+size_t cell_cache_range(uint32_t first_key, uint32_t last_key, CellVisit *out, size_t max)
+{
+    size_t copied = 0;
+    for (uint8_t i = lower_bound(first_key); i < cell_count && cells[i].key <= last_key && copied < max; i++)
+    {
+        out[copied++] = cells[i];
+    }
+    return copied;
+}
+
+CellCacheStats cell_cache_stats()
+{
+    CellCacheStats result = stats;
+    result.cells = cell_count;
+    return result;
+}
@@ -0,0 +1,399 @@
+/**
+ * @file config_store.cpp
+ * @brief Log-structured key/value store, see config_store.h
+ */
+
+#include <string.h>
+#include "config_store.h"
+#include "crc.h"
+#include "flash_layout.h"
+
+#define STORE_MAGIC 0x3153564B // "KVS1"
+#define STATE_ERASED 0xFFFFFFFF
+#define STATE_ACTIVE 0x00000000
+
+#define RECORD_END 0xFF
+#define RECORD_DELETED 0x01
+#define ALIGN4(n) (((n) + 3) & ~3u)
+
+struct SectorHeader
+{
+    uint32_t magic;
+    uint32_t generation;
+    uint32_t state; // written last, once the sector contents are complete
+    uint32_t reserved;
+};
+
+struct RecordHeader
+{
+    uint8_t key_length; // RECORD_END marks the end of the log
+    uint8_t value_length;
+    uint8_t flags;
+    uint8_t reserved;
+    uint32_t crc; // over the first four header bytes, the key and the value
+};
+
+struct IndexSlot
+{
+    uint16_t hash; // 0 marks an empty slot
+    uint16_t offset;
+};
+
+#define INDEX_SLOTS (CONFIG_MAX_KEYS * 2)
+#define RECORD_BUFFER_SIZE ALIGN4(sizeof(RecordHeader) + CONFIG_MAX_KEY + CONFIG_MAX_VALUE)
+
+static IndexSlot index_slots[INDEX_SLOTS];
+static uint8_t index_count = 0;
+static uint8_t active_sector = 0;
+static uint32_t generation = 0;
+static uint32_t write_offset = 0;
+static uint32_t compactions = 0;
+static bool log_damaged = false;
+static uint8_t record_buffer[RECORD_BUFFER_SIZE] __attribute__((aligned(4)));
+
+static uint32_t sector_address(uint8_t sector)
+{
+    return (CONFIG_STORE_FIRST_SECTOR + sector) * FLASH_SECTOR_SIZE;
+}
+
+static uint16_t key_hash(const char *key, size_t length)
+{
+    uint32_t hash = 2166136261u; // FNV-1a
+    for (size_t i = 0; i < length; i++)
+    {
+        hash = (hash ^ (uint8_t)key[i]) * 16777619u;
+    }
+    uint16_t folded = (uint16_t)(hash ^ (hash >> 16));
+    return folded ? folded : 1;
+}
+
+static uint32_t record_crc(const RecordHeader &header, const uint8_t *payload)
+{
+    uint32_t crc = crc32_update(0, &header, 4);
+    return crc32_update(crc, payload, header.key_length + header.value_length);
+}
+
+/**
+ * @brief - read a record into record_buffer and validate it
+ * @return total aligned record size, or 0 at the end of the log, or -1 if corrupt
+ */
+static int load_record(uint8_t sector, uint32_t offset)
+{
+    if (offset + sizeof(RecordHeader) > FLASH_SECTOR_SIZE)
+    {
+        return 0;
+    }
+    RecordHeader *header = (RecordHeader *)record_buffer;
+    if (!flash_read(sector_address(sector) + offset, header, sizeof(RecordHeader)))
+    {
+        return -1;
+    }
+    if (header->key_length == RECORD_END)
+    {
+        return 0;
+    }
+    size_t payload = header->key_length + header->value_length;
+    size_t total = ALIGN4(sizeof(RecordHeader) + payload);
+    if (header->key_length == 0 || header->key_length > CONFIG_MAX_KEY ||
+        header->value_length > CONFIG_MAX_VALUE || offset + total > FLASH_SECTOR_SIZE)
+    {
+        return -1;
+    }
+    uint8_t *data = record_buffer + sizeof(RecordHeader);
+    if (!flash_read(sector_address(sector) + offset + sizeof(RecordHeader), data, ALIGN4(payload)))
+    {
+        return -1;
+    }
+    return record_crc(*header, data) == header->crc ? (int)total : -1;
+}
+
+/**
+ * @brief - find the index slot for a key
+ * @return the slot holding the key, or the empty slot where it would go
+ */
+static IndexSlot *index_find(const char *key, size_t length)
+{
+    uint16_t hash = key_hash(key, length);
+    for (uint8_t probe = 0; probe < INDEX_SLOTS; probe++)
+    {
+        IndexSlot *slot = &index_slots[(hash + probe) % INDEX_SLOTS];
+        if (slot->hash == 0)
+        {
+            return slot;
+        }
+        if (slot->hash != hash)
+        {
+            continue;
+        }
+        RecordHeader *header = (RecordHeader *)record_buffer;
+        if (load_record(active_sector, slot->offset) > 0 && header->key_length == length &&
+            memcmp(record_buffer + sizeof(RecordHeader), key, length) == 0)
+        {
+            return slot;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * @brief - point the index at the record now held in record_buffer
+ */
+static void index_update(uint16_t offset)
+{
+    RecordHeader header = *(RecordHeader *)record_buffer;
+    char key[CONFIG_MAX_KEY];
+    memcpy(key, record_buffer + sizeof(RecordHeader), header.key_length);
+
+    IndexSlot *slot = index_find(key, header.key_length);
+    if (!slot)
+    {
+        return;
+    }
+    bool existing = slot->hash != 0;
+    if (header.flags & RECORD_DELETED)
+    {
+        if (existing)
+        {
+            // Tombstones stay in the index so the probe chains of other keys are not cut
+            slot->offset = offset;
+        }
+        return;
+    }
+    if (!existing)
+    {
+        if (index_count == CONFIG_MAX_KEYS)
+        {
+            return;
+        }
+        index_count++;
+        slot->hash = key_hash(key, header.key_length);
+    }
+    slot->offset = offset;
+}
+
+static void scan_log()
+{
+    memset(index_slots, 0, sizeof(index_slots));
+    index_count = 0;
+    log_damaged = false;
+    uint32_t offset = sizeof(SectorHeader);
+    while (true)
+    {
+        int size = load_record(active_sector, offset);
+        if (size <= 0)
+        {
+            // A torn write leaves garbage; appending after it is not safe, so compact first
+            log_damaged = size < 0;
+            break;
+        }
+        index_update(offset);
+        offset += size;
+    }
+    write_offset = offset;
+}
+
+static bool read_header(uint8_t sector, SectorHeader &header)
+{
+    return flash_read(sector_address(sector), &header, sizeof(header)) && header.magic == STORE_MAGIC &&
+           header.state == STATE_ACTIVE;
+}
+
+static bool format_sector(uint8_t sector, uint32_t new_generation)
+{
+    SectorHeader header = {STORE_MAGIC, new_generation, STATE_ERASED, 0xFFFFFFFF};
+    return flash_erase_sector(CONFIG_STORE_FIRST_SECTOR + sector) &&
+           flash_write(sector_address(sector), &header, sizeof(header));
+}
+
+static bool activate_sector(uint8_t sector)
+{
+    uint32_t state = STATE_ACTIVE;
+    return flash_write(sector_address(sector) + offsetof(SectorHeader, state), &state, sizeof(state));
+}
+
+static bool append_record(uint8_t sector, uint32_t &offset, size_t total)
+{
+    if (offset + total > FLASH_SECTOR_SIZE)
+    {
+        return false;
+    }
+    if (!flash_write(sector_address(sector) + offset, record_buffer, total))
+    {
+        return false;
+    }
+    offset += total;
+    return true;
+}
+
+/**
+ * @brief - copy the live records into the other sector and switch to it
+ */
+static bool compact()
+{
+    uint8_t target = active_sector ^ 1;
+    if (!format_sector(target, generation + 1))
+    {
+        return false;
+    }
+    uint32_t offset = sizeof(SectorHeader);
+    for (uint8_t i = 0; i < INDEX_SLOTS; i++)
+    {
+        if (index_slots[i].hash == 0)
+        {
+            continue;
+        }
+        int size = load_record(active_sector, index_slots[i].offset);
+        if (size <= 0 || (((RecordHeader *)record_buffer)->flags & RECORD_DELETED))
+        {
+            continue;
+        }
+        if (!append_record(target, offset, size))
+        {
+            return false;
+        }
+    }
+    if (!activate_sector(target))
+    {
+        return false;
+    }
+    uint8_t previous = active_sector;
+    active_sector = target;
+    generation++;
+    compactions++;
+    scan_log();
+    flash_erase_sector(CONFIG_STORE_FIRST_SECTOR + previous);
+    return true;
+}
+
+bool config_begin()
+{
+    SectorHeader headers[2];
+    bool valid[2];
+    for (uint8_t i = 0; i < 2; i++)
+    {
+        valid[i] = read_header(i, headers[i]);
+    }
+    if (!valid[0] && !valid[1])
+    {
+        active_sector = 0;
+        generation = 0;
+        if (!format_sector(0, 0) || !activate_sector(0))
+        {
+            return false;
+        }
+        format_sector(1, 0);
+    }
+    else
+    {
+        // Both active means power was lost before the old sector was erased after compaction
+        active_sector = (valid[0] && (!valid[1] || (int32_t)(headers[0].generation - headers[1].generation) > 0)) ? 0 : 1;
+        generation = headers[active_sector].generation;
+    }
+    scan_log();
+    return true;
+}
+
+static bool write_record(const char *key, const void *value, size_t length, uint8_t flags)
+{
+    size_t key_length = strlen(key);
+    if (key_length == 0 || key_length > CONFIG_MAX_KEY || length > CONFIG_MAX_VALUE)
+    {
+        return false;
+    }
+    IndexSlot *slot = index_find(key, key_length);
+    if (!slot || (slot->hash == 0 && index_count == CONFIG_MAX_KEYS))
+    {
+        return false; // index full
+    }
+    size_t total = ALIGN4(sizeof(RecordHeader) + key_length + length);
+    if (log_damaged || write_offset + total > FLASH_SECTOR_SIZE)
+    {
+        if (!compact() || write_offset + total > FLASH_SECTOR_SIZE)
+        {
+            return false;
+        }
+    }
+
+    RecordHeader *header = (RecordHeader *)record_buffer;
+    uint8_t *data = record_buffer + sizeof(RecordHeader);
+    memset(record_buffer, 0xFF, total);
+    header->key_length = key_length;
+    header->value_length = length;
+    header->flags = flags;
+    header->reserved = 0xFF;
+    memcpy(data, key, key_length);
+    if (length)
+    {
+        memcpy(data + key_length, value, length);
+    }
+    header->crc = record_crc(*header, data);
+
+    uint32_t offset = write_offset;
+    if (!append_record(active_sector, write_offset, total))
+    {
+        log_damaged = true;
+        return false;
+    }
+    index_update(offset);
+    return true;
+}
+
+int config_get(const char *key, void *value, size_t size)
+{
+    IndexSlot *slot = index_find(key, strlen(key));
+    if (!slot || slot->hash == 0)
+    {
+        return -1;
+    }
+    // index_find left the matching record in record_buffer
+    RecordHeader *header = (RecordHeader *)record_buffer;
+    if ((header->flags & RECORD_DELETED) || header->value_length > size)
+    {
+        return -1;
+    }
+    memcpy(value, record_buffer + sizeof(RecordHeader) + header->key_length, header->value_length);
+    return header->value_length;
+}
+
+void config_get_string(const char *key, char *value, size_t size, const char *fallback)
+{
+    int length = size ? config_get(key, value, size - 1) : -1;
+    if (length < 0)
+    {
+        strncpy(value, fallback, size);
+        value[size - 1] = '\0';
+        return;
+    }
+    value[length] = '\0';
+}
+
+bool config_set(const char *key, const void *value, size_t length)
+{
+    uint8_t current[CONFIG_MAX_VALUE];
+    if (config_get(key, current, sizeof(current)) == (int)length && memcmp(current, value, length) == 0)
+    {
+        return true; // unchanged, save the flash wear
+    }
+    return write_record(key, value, length, 0);
+}
+
+bool config_set_string(const char *key, const char *value)
+{
+    return config_set(key, value, strlen(value));
+}
+
+bool config_remove(const char *key)
+{
+    uint8_t current[CONFIG_MAX_VALUE];
+    if (config_get(key, current, sizeof(current)) < 0)
+    {
+        return true;
+    }
+    return write_record(key, nullptr, 0, RECORD_DELETED);
+}
+
+ConfigStats config_stats()
+{
+    ConfigStats stats = {index_count, write_offset, generation, compactions};
+    return stats;
+}
@@ -0,0 +1,128 @@
+/**
+ * @file cpu_governor.cpp
+ * @brief CPU clock governor, see cpu_governor.h
+ */
+
+#include "cpu_governor.h"
+
+static uint32_t (*clock_source)() = nullptr;
+static bool (*apply_speed)(CpuSpeed) = nullptr;
+static GovernorStats stats = {};
+static CpuSpeed speed = CPU_80MHZ;
+static uint32_t updated_us = 0;
+static uint32_t window_start_us = 0;
+static uint64_t window_active_us = 0; // energy_cpu_active_us() when the window opened
+static uint8_t low_windows = 0;       // consecutive windows below GOVERNOR_DOWN_PERCENT
+static bool deferred_this_window = false;
+
+void governor_begin(uint32_t (*clock_us)(), bool (*set_speed)(CpuSpeed))
+{
+    clock_source = clock_us;
+    apply_speed = set_speed;
+    speed = CPU_80MHZ;
+    stats = {};
+    stats.target = CPU_80MHZ;
+    apply_speed(CPU_80MHZ); // the board may have booted at 160 MHz
+    updated_us = window_start_us = clock_source();
+    energy_update();
+    window_active_us = energy_cpu_active_us();
+}
+
+/**
+ * @brief - measure the load of the window just closed and pick the clock it asks for
+ */
+static void close_window(uint32_t now_us)
+{
+    energy_update();
+    uint64_t active = energy_cpu_active_us() - window_active_us;
+    uint32_t length = now_us - window_start_us;
+    window_active_us += active;
+    window_start_us = now_us;
+    deferred_this_window = false;
+    stats.load_percent = active >= length ? 100 : (uint8_t)(active * 100 / length);
+
+    if (stats.load_percent >= GOVERNOR_UP_PERCENT)
+    {
+        low_windows = 0;
+        stats.target = CPU_160MHZ;
+    }
+    else if (stats.load_percent < GOVERNOR_DOWN_PERCENT)
+    {
+        if (low_windows < GOVERNOR_HOLD_WINDOWS)
+        {
+            low_windows++;
+        }
+        if (low_windows >= GOVERNOR_HOLD_WINDOWS)
+        {
+            stats.target = CPU_80MHZ;
+        }
+    }
+    else
+    {
+        low_windows = 0;
+    }
+}
+
+void governor_update(bool quiet, bool pending)
+{
+    if (!clock_source)
+    {
+        return;
+    }
+    uint32_t now_us = clock_source();
+    stats.speed_us[speed] += now_us - updated_us;
+    updated_us = now_us;
+    if (now_us - window_start_us >= GOVERNOR_WINDOW_MS * 1000UL)
+    {
+        close_window(now_us);
+    }
+    if (pending)
+    {
+        // Up at once; the hold before dropping back counts from the last pass with work
+        low_windows = 0;
+        stats.target = CPU_160MHZ;
+    }
+    if (stats.target == speed)
+    {
+        return;
+    }
+    if (!quiet)
+    {
+        if (!deferred_this_window)
+        {
+            deferred_this_window = true;
+            stats.deferred++;
+        }
+        return;
+    }
+    if (!apply_speed || !apply_speed(stats.target))
+    {
+        // Stay put until the load asks again
+        stats.failed++;
+        stats.target = speed;
+        return;
+    }
+    speed = stats.target;
+    stats.switches++;
+    energy_enter(governor_active_state());
+}
+
+CpuSpeed governor_speed()
+{
+    return speed;
+}
+
+uint16_t governor_mhz(CpuSpeed value)
+{
+    return value == CPU_160MHZ ? 160 : 80;
+}
+
+EnergyState governor_active_state()
+{
+    return speed == CPU_160MHZ ? ENERGY_CPU_FAST : ENERGY_CPU_ACTIVE;
+}
+
+GovernorStats governor_stats()
+{
+    return stats;
+}
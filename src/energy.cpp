@@ -0,0 +1,208 @@
+/**
+ * @file energy.cpp
+ * @brief Energy accounting from power state transitions, see energy.h
+ */
+
+#include <string.h>
+#include "energy.h"
+#include "events.h"
+
+/* Battery-side typicals: ESP8266 modem-sleep and light sleep, EC200U idle, LTE TX and RX,
+ * soft AP beaconing and listening, NEO-6M tracking, ESP8266 modem-sleep at 160 MHz */
+static uint32_t currents_ua[ENERGY_STATES] = {15000, 900, 0, 18000, 450000, 75000, 0, 56000, 0, 39000, 23000};
+
+static const char *const STATE_NAMES[ENERGY_STATES] = {
+    "cpu_active", "cpu_light_sleep", "modem_off", "modem_idle", "modem_tx",
+    "modem_rx", "ap_off", "ap_on", "gps_off", "gps_on", "cpu_fast"};
+
+static const EnergyRail STATE_RAILS[ENERGY_STATES] = {
+    ENERGY_RAIL_CPU, ENERGY_RAIL_CPU, ENERGY_RAIL_MODEM, ENERGY_RAIL_MODEM, ENERGY_RAIL_MODEM,
+    ENERGY_RAIL_MODEM, ENERGY_RAIL_AP, ENERGY_RAIL_AP, ENERGY_RAIL_GPS, ENERGY_RAIL_GPS, ENERGY_RAIL_CPU};
+
+static EnergyState rail_states[ENERGY_RAILS];
+static EnergyStats stats = {};
+static uint32_t (*clock_source)() = nullptr;
+static uint32_t updated_us = 0;
+static uint64_t accounted_us = 0;  // accounted time since energy_begin()
+static uint64_t cpu_active_us = 0; // all time, for the per-fix CPU cost in the trace
+static uint64_t cpu_at_last_fix_us = 0;
+static EnergyState traced_speed = ENERGY_CPU_ACTIVE; // clock of the active CPU states, as last traced
+
+static EnergyTraceEntry trace[ENERGY_TRACE_LENGTH];
+static uint32_t trace_count = 0; // entries ever written
+
+static void trace_add(uint8_t kind, uint8_t moved, uint16_t cpu_ms)
+{
+    trace[trace_count % ENERGY_TRACE_LENGTH] = {(uint32_t)(accounted_us / 1000), kind, moved, cpu_ms};
+    trace_count++;
+}
+
+void energy_update()
+{
+    if (!clock_source)
+    {
+        return;
+    }
+    uint32_t now_us = clock_source();
+    uint32_t elapsed = now_us - updated_us;
+    updated_us = now_us;
+    accounted_us += elapsed;
+    for (uint8_t rail = 0; rail < ENERGY_RAILS; rail++)
+    {
+        stats.today.state_us[rail_states[rail]] += elapsed;
+    }
+    if (rail_states[ENERGY_RAIL_CPU] != ENERGY_CPU_LIGHT_SLEEP)
+    {
+        cpu_active_us += elapsed;
+    }
+    stats.today.elapsed_us += elapsed;
+    if (stats.today.elapsed_us >= ENERGY_DAY_US)
+    {
+        stats.yesterday = stats.today;
+        memset(&stats.today, 0, sizeof(stats.today));
+        stats.days++;
+    }
+}
+
+void energy_enter(EnergyState state)
+{
+    if (state >= ENERGY_STATES)
+    {
+        return;
+    }
+    energy_update();
+    EnergyRail rail = STATE_RAILS[state];
+    if (rail_states[rail] == state)
+    {
+        return;
+    }
+    rail_states[rail] = state;
+    // CPU transitions happen every loop; the replay derives them from the per-fix CPU time and
+    // only needs the clock speed, which the governor changes seldom
+    if (rail != ENERGY_RAIL_CPU)
+    {
+        trace_add(state, 0, 0);
+    }
+    else if (state != ENERGY_CPU_LIGHT_SLEEP && state != traced_speed)
+    {
+        traced_speed = state;
+        trace_add(state, 0, 0);
+    }
+}
+
+static void on_modem(const ModemEvent &event, void *ctx)
+{
+    (void)ctx;
+    static const EnergyState MODEM_ENERGY[] = {
+        ENERGY_MODEM_OFF,  // MODEM_OFF
+        ENERGY_MODEM_RX,   // MODEM_RESETTING, scanning for a network
+        ENERGY_MODEM_RX,   // MODEM_ATTACHING
+        ENERGY_MODEM_IDLE, // MODEM_READY
+        ENERGY_MODEM_TX,   // MODEM_UPLOADING
+        ENERGY_MODEM_IDLE  // MODEM_FAILED
+    };
+    if (event.state < sizeof(MODEM_ENERGY) / sizeof(MODEM_ENERGY[0]))
+    {
+        energy_enter(MODEM_ENERGY[event.state]);
+    }
+}
+
+static void on_fix(const FixEvent &event, void *ctx)
+{
+    (void)ctx;
+    uint64_t cpu_ms = (cpu_active_us - cpu_at_last_fix_us) / 1000;
+    cpu_at_last_fix_us = cpu_active_us;
+    trace_add(ENERGY_TRACE_FIX, event.moved, cpu_ms > UINT16_MAX ? UINT16_MAX : (uint16_t)cpu_ms);
+}
+
+void energy_begin(uint32_t (*clock_us)())
+{
+    clock_source = clock_us;
+    updated_us = clock_source();
+    rail_states[ENERGY_RAIL_CPU] = traced_speed = ENERGY_CPU_ACTIVE;
+    rail_states[ENERGY_RAIL_MODEM] = ENERGY_MODEM_OFF;
+    rail_states[ENERGY_RAIL_AP] = ENERGY_AP_OFF;
+    rail_states[ENERGY_RAIL_GPS] = ENERGY_GPS_ON;
+    trace_add(ENERGY_GPS_ON, 0, 0);
+    modem_events.subscribe(on_modem);
+    fix_events.subscribe(on_fix);
+}
+
+EnergyRail energy_rail(EnergyState state)
+{
+    return STATE_RAILS[state];
+}
+
+EnergyState energy_rail_state(EnergyRail rail)
+{
+    return rail_states[rail];
+}
+
+const char *energy_state_name(EnergyState state)
+{
+    return state < ENERGY_STATES ? STATE_NAMES[state] : "unknown";
+}
+
+bool energy_state_from_name(const char *name, EnergyState &state)
+{
+    for (uint8_t i = 0; i < ENERGY_STATES; i++)
+    {
+        if (strcmp(name, STATE_NAMES[i]) == 0)
+        {
+            state = (EnergyState)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+void energy_set_current(EnergyState state, uint32_t current_ua)
+{
+    if (state < ENERGY_STATES)
+    {
+        currents_ua[state] = current_ua;
+    }
+}
+
+uint32_t energy_current(EnergyState state)
+{
+    return state < ENERGY_STATES ? currents_ua[state] : 0;
+}
+
+uint32_t energy_charge_uah(const EnergyDay &day, EnergyState state)
+{
+    // uA x us stays below 2^64 for a day at up to 200 A
+    return (uint32_t)((uint64_t)currents_ua[state] * day.state_us[state] / 3600000000ULL);
+}
+
+uint32_t energy_total_uah(const EnergyDay &day)
+{
+    uint32_t total = 0;
+    for (uint8_t state = 0; state < ENERGY_STATES; state++)
+    {
+        total += energy_charge_uah(day, (EnergyState)state);
+    }
+    return total;
+}
+
+EnergyStats energy_stats()
+{
+    return stats;
+}
+
+uint64_t energy_cpu_active_us()
+{
+    return cpu_active_us;
+}
+
+size_t energy_trace(size_t first, EnergyTraceEntry *out, size_t max)
+{
+    uint32_t kept = trace_count < ENERGY_TRACE_LENGTH ? trace_count : ENERGY_TRACE_LENGTH;
+    uint32_t oldest = trace_count - kept;
+    size_t copied = 0;
+    for (size_t i = first; i < kept && copied < max; i++)
+    {
+        out[copied++] = trace[(oldest + i) % ENERGY_TRACE_LENGTH];
+    }
+    return copied;
+}
@@ -0,0 +1,32 @@
+/**
+ * @file events.cpp
+ * @brief Statically allocated event channels
+ */
+
+#include "events.h"
+
+EventChannel<FixEvent, MAX_FIX_SUBSCRIBERS> fix_events;
+EventChannel<UploadEvent, MAX_UPLOAD_SUBSCRIBERS> upload_events;
+EventChannel<ModemEvent, MAX_MODEM_SUBSCRIBERS> modem_events;
+EventChannel<ControlEvent, MAX_CONTROL_SUBSCRIBERS> control_events;
+EventChannel<RouteEvent, MAX_ROUTE_SUBSCRIBERS> route_events;
+
+const char *modem_state_name(ModemState state)
+{
+    switch (state)
+    {
+    case MODEM_OFF:
+        return "off";
+    case MODEM_RESETTING:
+        return "resetting";
+    case MODEM_ATTACHING:
+        return "attaching";
+    case MODEM_READY:
+        return "ready";
+    case MODEM_UPLOADING:
+        return "uploading";
+    case MODEM_FAILED:
+        return "failed";
+    }
+    return "unknown";
+}
@@ -0,0 +1,30 @@
+/**
+ * @file fix_snapshot.cpp
+ * @brief Keeps the seqlock-protected fix snapshot up to date from fix events
+ */
+
+#include "fix_snapshot.h"
+#include "events.h"
+
+Seqlock<FixSnapshot> fix_snapshot;
+
+/* Writer-side state; only touched from the fix event dispatch */
+static FixSnapshot pending = {};
+
+static void on_fix(const FixEvent &event, void *ctx)
+{
+    (void)ctx;
+    if (event.moved)
+    {
+        pending.previous = pending.current;
+    }
+    pending.current = event.fix;
+    pending.valid = true;
+    pending.updated = event.moved;
+    fix_snapshot.write(pending);
+}
+
+void fix_snapshot_begin()
+{
+    fix_events.subscribe(on_fix);
+}
@@ -0,0 +1,124 @@
+/**
+ * @file flash_blocks.cpp
+ * @brief Append-only flash blocks, see flash_blocks.h
+ */
+
+#include <string.h>
+#include "crc.h"
+#include "flash_blocks.h"
+#include "flash_layout.h"
+
+static uint16_t payload_length(const FlashBlockLayout &layout, const void *header)
+{
+    uint16_t length;
+    memcpy(&length, (const uint8_t *)header + layout.length_offset, sizeof(length));
+    return length;
+}
+
+uint32_t flash_block_size(const FlashBlockLayout &layout, const void *header)
+{
+    return FLASH_ALIGN4(layout.header_size + payload_length(layout, header));
+}
+
+uint32_t flash_block_crc(const FlashBlockLayout &layout, const void *header, const uint8_t *payload)
+{
+    // From after the magic up to the CRC itself
+    uint32_t crc = crc32_update(0, (const uint8_t *)header + sizeof(uint32_t), layout.header_size - 2 * sizeof(uint32_t));
+    return crc32_update(crc, payload, payload_length(layout, header));
+}
+
+uint32_t flash_block_at(const FlashBlockLayout &layout, uint32_t sector_address, uint32_t offset, void *header)
+{
+    uint32_t magic;
+    if (offset + layout.header_size > FLASH_SECTOR_SIZE || !flash_read(sector_address + offset, header, layout.header_size))
+    {
+        return 0;
+    }
+    memcpy(&magic, header, sizeof(magic));
+    return magic == layout.magic ? flash_block_size(layout, header) : 0;
+}
+
+bool flash_block_write(const FlashBlockLayout &layout, uint32_t address, uint8_t *block, bool commit)
+{
+    uint32_t magic = FLASH_MAGIC_ERASED;
+    uint32_t length = payload_length(layout, block);
+    uint32_t size = FLASH_ALIGN4(layout.header_size + length);
+    memset(block + layout.header_size + length, 0xFF, size - layout.header_size - length);
+    memcpy(block, &magic, sizeof(magic));
+    uint32_t crc = flash_block_crc(layout, block, block + layout.header_size);
+    memcpy(block + layout.header_size - sizeof(crc), &crc, sizeof(crc));
+    // A block whose magic never made it to flash is ignored, and the sector closed, at boot
+    return flash_write(address, block, size) && (!commit || flash_block_commit(layout, address));
+}
+
+bool flash_block_commit(const FlashBlockLayout &layout, uint32_t address)
+{
+    uint32_t magic = layout.magic;
+    return flash_write(address, &magic, sizeof(magic));
+}
+
+uint32_t flash_blocks_end(const FlashBlockLayout &layout, uint32_t sector_address, void *last)
+{
+    uint32_t header[FLASH_BLOCK_HEADER_MAX / sizeof(uint32_t)];
+    uint32_t offset = 0;
+    while (offset + layout.header_size <= FLASH_SECTOR_SIZE)
+    {
+        if (!flash_read(sector_address + offset, header, layout.header_size))
+        {
+            return FLASH_SECTOR_SIZE;
+        }
+        if (header[0] != layout.magic)
+        {
+            // Anything but erased flash here is an interrupted write; start afresh in the next sector
+            for (size_t i = 0; i < layout.header_size / sizeof(uint32_t); i++)
+            {
+                if (header[i] != FLASH_MAGIC_ERASED)
+                {
+                    return FLASH_SECTOR_SIZE;
+                }
+            }
+            return offset;
+        }
+        if (last)
+        {
+            memcpy(last, header, layout.header_size);
+        }
+        offset += flash_block_size(layout, header);
+    }
+    return offset;
+}
+
+uint8_t varint_size(uint32_t value)
+{
+    uint8_t size = 1;
+    for (; value >= 0x80; value >>= 7)
+    {
+        size++;
+    }
+    return size;
+}
+
+uint8_t *put_varint(uint8_t *out, uint32_t value)
+{
+    for (; value >= 0x80; value >>= 7)
+    {
+        *out++ = (uint8_t)(value | 0x80);
+    }
+    *out++ = (uint8_t)value;
+    return out;
+}
+
+const uint8_t *get_varint(const uint8_t *in, const uint8_t *end, uint32_t &value)
+{
+    value = 0;
+    for (uint8_t shift = 0; in < end && shift < 35; shift += 7)
+    {
+        uint8_t byte = *in++;
+        value |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+        {
+            return in;
+        }
+    }
+    return nullptr;
+}
@@ -0,0 +1,45 @@
+/**
+ * @file flash_hal.cpp
+ * @brief Flash access for the tracker region on the ESP8266
+ */
+
+#include <Arduino.h>
+#include "flash_layout.h"
+
+#if defined(ARDUINO_ARCH_ESP8266)
+
+extern "C" uint32_t _FS_start;
+extern "C" uint32_t _FS_end;
+
+#define FLASH_MAPPED_BASE 0x40200000
+
+static uint32_t region_start()
+{
+    return (uint32_t)(uintptr_t)&_FS_start - FLASH_MAPPED_BASE;
+}
+
+uint32_t flash_region_sectors()
+{
+    return ((uint32_t)(uintptr_t)&_FS_end - (uint32_t)(uintptr_t)&_FS_start) / FLASH_SECTOR_SIZE;
+}
+
+bool flash_erase_sector(uint32_t sector)
+{
+    if (sector >= flash_region_sectors())
+    {
+        return false;
+    }
+    return ESP.flashEraseSector(region_start() / FLASH_SECTOR_SIZE + sector);
+}
+
+bool flash_write(uint32_t address, const void *data, size_t length)
+{
+    return ESP.flashWrite(region_start() + address, (const uint8_t *)data, length);
+}
+
+bool flash_read(uint32_t address, void *data, size_t length)
+{
+    return ESP.flashRead(region_start() + address, (uint8_t *)data, length);
+}
+
+#endif
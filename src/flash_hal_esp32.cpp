@@ -0,0 +1,47 @@
+/**
+ * @file flash_hal_esp32.cpp
+ * @brief Flash access for the tracker region on the ESP32
+ *
+ * The tracker sectors live in the data partition the default partition table reserves for
+ * SPIFFS, which the tracker does not mount.
+ */
+
+#include <Arduino.h>
+#include "flash_layout.h"
+
+#if defined(ARDUINO_ARCH_ESP32)
+
+#include <esp_partition.h>
+
+static const esp_partition_t *region()
+{
+    static const esp_partition_t *partition =
+        esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_SPIFFS, nullptr);
+    return partition;
+}
+
+uint32_t flash_region_sectors()
+{
+    return region() ? region()->size / FLASH_SECTOR_SIZE : 0;
+}
+
+bool flash_erase_sector(uint32_t sector)
+{
+    if (sector >= flash_region_sectors())
+    {
+        return false;
+    }
+    return esp_partition_erase_range(region(), sector * FLASH_SECTOR_SIZE, FLASH_SECTOR_SIZE) == ESP_OK;
+}
+
+bool flash_write(uint32_t address, const void *data, size_t length)
+{
+    return region() && esp_partition_write(region(), address, data, length) == ESP_OK;
+}
+
+bool flash_read(uint32_t address, void *data, size_t length)
+{
+    return region() && esp_partition_read(region(), address, data, length) == ESP_OK;
+}
+
+#endif
@@ -0,0 +1,462 @@
+/**
+ * @file flight_recorder.cpp
+ * @brief Serial link capture, see flight_recorder.h
+ */
+
+#include <string.h>
+#include "flash_blocks.h"
+#include "flash_layout.h"
+#include "flight_recorder.h"
+
+#ifdef TRACKER_TASKS
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+static SemaphoreHandle_t lock;
+#define RECORDER_LOCK() xSemaphoreTake(lock, portMAX_DELAY)
+#define RECORDER_UNLOCK() xSemaphoreGive(lock)
+#else
+#define RECORDER_LOCK()
+#define RECORDER_UNLOCK()
+#endif
+
+#define RECORDER_MAGIC 0x31524C46 // "FLR1"
+
+#define ENTRY_HEADER_MAX 9 // time delta and length varints at full width, and the channel
+
+/* LZ matches are two bytes: a 10-bit distance back into the block and a 6-bit length */
+#define LZ_MIN_MATCH 3
+#define LZ_MAX_MATCH (LZ_MIN_MATCH + 63)
+#define LZ_MAX_DISTANCE 1024
+#define LZ_HASH_BITS 8
+
+struct BlockHeader
+{
+    uint32_t magic;    // RECORDER_MAGIC
+    uint32_t sequence; // of the sector, increasing around the ring
+    uint32_t boot;
+    uint32_t first_ms;
+    uint16_t raw_length;
+    uint16_t length; // payload bytes after the header; equal to raw_length if stored uncompressed
+    uint32_t crc;    // over the header from sequence to length, and the payload
+};
+
+static_assert(RECORDER_RAW_SIZE <= LZ_MAX_DISTANCE, "the LZ window must cover a whole block");
+static_assert(offsetof(BlockHeader, crc) + sizeof(uint32_t) == sizeof(BlockHeader), "the CRC ends the header");
+
+static const FlashBlockLayout BLOCKS = {RECORDER_MAGIC, sizeof(BlockHeader), offsetof(BlockHeader, length)};
+
+static uint32_t (*clock_source)() = nullptr;
+static uint32_t sector_sequence[RECORDER_SECTORS]; // 0 if the sector holds no blocks
+static uint16_t head_sector = 0;
+static uint32_t head_sequence = 0;
+static uint32_t head_offset = FLASH_SECTOR_SIZE; // next write position in the head sector
+
+static uint8_t raw[RECORDER_RAW_SIZE];
+static uint16_t raw_length = 0;
+static uint32_t first_ms = 0;
+static uint32_t last_ms = 0;
+static uint8_t block[sizeof(BlockHeader) + RECORDER_RAW_SIZE] __attribute__((aligned(4)));
+static BlockHeader &header = *(BlockHeader *)block;
+
+static RecorderStats stats = {};
+
+static const char *const CHANNEL_NAMES[RECORDER_CHANNELS] = {"gps_rx", "gps_tx", "modem_rx", "modem_tx"};
+
+static uint32_t sector_address(uint16_t sector)
+{
+    return (RECORDER_FIRST_SECTOR + sector) * FLASH_SECTOR_SIZE;
+}
+
+static inline uint16_t lz_hash(const uint8_t *in)
+{
+    return (uint16_t)(((uint32_t)in[0] | (uint32_t)in[1] << 8 | (uint32_t)in[2] << 16) * 2654435761u >> (32 - LZ_HASH_BITS));
+}
+
+/**
+ * @brief - LZSS with one candidate per hash bucket. A control byte precedes every eight items,
+ * a set bit marking a match
+ * @return compressed length, or 0 if it would not be shorter than the input
+ */
+static size_t lz_compress(const uint8_t *in, size_t length, uint8_t *out)
+{
+    uint16_t table[1 << LZ_HASH_BITS];
+    memset(table, 0xFF, sizeof(table));
+    size_t written = 0, position = 0;
+    uint8_t *control = nullptr;
+    uint8_t items = 8;
+    while (position < length)
+    {
+        // Give up as soon as the output could reach the input length
+        if (written + 3 >= length)
+        {
+            return 0;
+        }
+        if (items == 8)
+        {
+            control = out + written++;
+            *control = 0;
+            items = 0;
+        }
+        size_t match = 0, distance = 0;
+        if (position + LZ_MIN_MATCH <= length)
+        {
+            uint16_t hash = lz_hash(in + position);
+            uint16_t candidate = table[hash];
+            table[hash] = position;
+            if (candidate != 0xFFFF && position - candidate <= LZ_MAX_DISTANCE)
+            {
+                size_t limit = length - position < LZ_MAX_MATCH ? length - position : LZ_MAX_MATCH;
+                while (match < limit && in[candidate + match] == in[position + match])
+                {
+                    match++;
+                }
+                distance = position - candidate;
+            }
+        }
+        if (match >= LZ_MIN_MATCH)
+        {
+            uint16_t code = (uint16_t)((distance - 1) << 6 | (match - LZ_MIN_MATCH));
+            out[written++] = code >> 8;
+            out[written++] = code & 0xFF;
+            *control |= 1 << items;
+            position += match;
+        }
+        else
+        {
+            out[written++] = in[position++];
+        }
+        items++;
+    }
+    return written;
+}
+
+/**
+ * @return decompressed length, or 0 if the input is malformed
+ */
+static size_t lz_decompress(const uint8_t *in, size_t length, uint8_t *out, size_t max)
+{
+    const uint8_t *end = in + length;
+    size_t written = 0;
+    while (in < end)
+    {
+        uint8_t control = *in++;
+        for (uint8_t item = 0; item < 8 && in < end; item++)
+        {
+            if (control & (1 << item))
+            {
+                if (end - in < 2)
+                {
+                    return 0;
+                }
+                uint16_t code = (uint16_t)(in[0] << 8 | in[1]);
+                in += 2;
+                size_t distance = (code >> 6) + 1, match = (code & 0x3F) + LZ_MIN_MATCH;
+                if (distance > written || written + match > max)
+                {
+                    return 0;
+                }
+                // Byte by byte: a match may overlap the bytes it produces
+                for (size_t i = 0; i < match; i++, written++)
+                {
+                    out[written] = out[written - distance];
+                }
+            }
+            else
+            {
+                if (written == max)
+                {
+                    return 0;
+                }
+                out[written++] = *in++;
+            }
+        }
+    }
+    return written;
+}
+
+/**
+ * @brief - erase the sector after the head and make it the head
+ */
+static bool advance_head()
+{
+    uint16_t next = (head_sector + 1) % RECORDER_SECTORS;
+    if (sector_sequence[next])
+    {
+        BlockHeader old;
+        for (uint32_t offset = 0, size; (size = flash_block_at(BLOCKS, sector_address(next), offset, &old)); offset += size)
+        {
+            stats.blocks--;
+            stats.stored_bytes -= size;
+        }
+        sector_sequence[next] = 0;
+    }
+    if (!flash_erase_sector(RECORDER_FIRST_SECTOR + next))
+    {
+        return false;
+    }
+    head_sector = next;
+    head_sequence++;
+    head_offset = 0;
+    return true;
+}
+
+static uint16_t oldest_sector()
+{
+    for (uint16_t i = 1; i <= RECORDER_SECTORS; i++)
+    {
+        uint16_t sector = (head_sector + i) % RECORDER_SECTORS;
+        if (sector_sequence[sector])
+        {
+            return sector;
+        }
+    }
+    return head_sector;
+}
+
+/**
+ * @brief - compress the pending entries into a block and write it. Called with the lock held
+ */
+static bool write_block()
+{
+    if (raw_length == 0)
+    {
+        return true;
+    }
+    uint8_t *payload = block + sizeof(BlockHeader);
+    size_t length = lz_compress(raw, raw_length, payload);
+    if (length == 0)
+    {
+        memcpy(payload, raw, raw_length);
+        length = raw_length;
+    }
+    header.boot = stats.boot;
+    header.first_ms = first_ms;
+    header.raw_length = raw_length;
+    header.length = length;
+    uint32_t size = flash_block_size(BLOCKS, &header);
+    bool written = false;
+    if (head_offset + size <= FLASH_SECTOR_SIZE || advance_head())
+    {
+        header.sequence = head_sequence;
+        uint32_t address = sector_address(head_sector) + head_offset;
+        head_offset += size;
+        written = flash_block_write(BLOCKS, address, block, true);
+    }
+    if (written)
+    {
+        sector_sequence[head_sector] = head_sequence;
+        stats.blocks++;
+        stats.stored_bytes += size;
+    }
+    else
+    {
+        stats.dropped_bytes += raw_length;
+    }
+    raw_length = 0;
+    stats.pending = 0;
+    return written;
+}
+
+void recorder_log(RecorderChannel channel, const void *data, size_t length)
+{
+    if (!clock_source || channel >= RECORDER_CHANNELS)
+    {
+        return;
+    }
+    const uint8_t *bytes = (const uint8_t *)data;
+    RECORDER_LOCK();
+    uint32_t now = clock_source();
+    stats.logged_bytes += length;
+    while (length)
+    {
+        if (raw_length + ENTRY_HEADER_MAX >= RECORDER_RAW_SIZE)
+        {
+            write_block();
+        }
+        if (raw_length == 0)
+        {
+            first_ms = now;
+            last_ms = now;
+        }
+        // Entries too long for the rest of the block continue in the next one
+        uint8_t *out = put_varint(raw + raw_length, now - last_ms);
+        *out++ = channel;
+        size_t room = RECORDER_RAW_SIZE - (out - raw) - 2;
+        size_t chunk = length < room ? length : room;
+        out = put_varint(out, chunk);
+        memcpy(out, bytes, chunk);
+        raw_length = out + chunk - raw;
+        last_ms = now;
+        bytes += chunk;
+        length -= chunk;
+    }
+    stats.pending = raw_length;
+    if (raw_length && now - first_ms >= RECORDER_FLUSH_MS)
+    {
+        write_block();
+    }
+    RECORDER_UNLOCK();
+}
+
+bool recorder_flush()
+{
+    RECORDER_LOCK();
+    bool written = write_block();
+    RECORDER_UNLOCK();
+    return written;
+}
+
+void recorder_begin(uint32_t (*clock_ms)())
+{
+#ifdef TRACKER_TASKS
+    lock = xSemaphoreCreateMutex();
+#endif
+    memset(&stats, 0, sizeof(stats));
+    bool any = false;
+    for (uint16_t sector = 0; sector < RECORDER_SECTORS; sector++)
+    {
+        BlockHeader found;
+        sector_sequence[sector] = 0;
+        if (!flash_block_at(BLOCKS, sector_address(sector), 0, &found))
+        {
+            continue;
+        }
+        sector_sequence[sector] = found.sequence;
+        for (uint32_t offset = 0, size; (size = flash_block_at(BLOCKS, sector_address(sector), offset, &found)); offset += size)
+        {
+            stats.blocks++;
+            stats.stored_bytes += size;
+        }
+        if (!any || (int32_t)(sector_sequence[sector] - head_sequence) > 0)
+        {
+            head_sector = sector;
+            head_sequence = sector_sequence[sector];
+            any = true;
+        }
+    }
+    if (any)
+    {
+        // Continue after the last boot that wrote to the head sector
+        BlockHeader last;
+        last.boot = 0;
+        head_offset = flash_blocks_end(BLOCKS, sector_address(head_sector), &last);
+        stats.boot = last.boot + 1;
+    }
+    else
+    {
+        // Start the first advance at sector 0, with sequence 1 so that 0 can mean empty
+        head_sector = RECORDER_SECTORS - 1;
+        head_sequence = 0;
+        head_offset = FLASH_SECTOR_SIZE;
+        stats.boot = 1;
+    }
+    raw_length = 0;
+    clock_source = clock_ms;
+}
+
+size_t recorder_read(uint32_t offset, uint8_t *out, size_t max)
+{
+    RECORDER_LOCK();
+    uint32_t position = 0;
+    size_t copied = 0;
+    uint16_t sector = oldest_sector();
+    for (uint16_t i = 0; i < RECORDER_SECTORS && copied < max; i++, sector = (sector + 1) % RECORDER_SECTORS)
+    {
+        if (sector_sequence[sector] == 0)
+        {
+            continue;
+        }
+        BlockHeader found;
+        for (uint32_t at = 0, size; copied < max && (size = flash_block_at(BLOCKS, sector_address(sector), at, &found)); at += size)
+        {
+            if (position + size > offset)
+            {
+                // Copy the part of this block at or after the offset; flash reads stay aligned
+                uint32_t skip = offset > position ? offset - position : 0;
+                uint32_t length = size - skip < max - copied ? size - skip : max - copied;
+                uint8_t chunk[64] __attribute__((aligned(4)));
+                uint32_t aligned = skip & ~3u;
+                for (uint32_t done = 0; done < length;)
+                {
+                    uint32_t lead = skip + done - aligned;
+                    uint32_t take = sizeof(chunk) - lead < length - done ? sizeof(chunk) - lead : length - done;
+                    if (!flash_read(sector_address(sector) + at + aligned, chunk, FLASH_ALIGN4(lead + take)))
+                    {
+                        RECORDER_UNLOCK();
+                        return copied;
+                    }
+                    memcpy(out + copied, chunk + lead, take);
+                    copied += take;
+                    done += take;
+                    aligned += FLASH_ALIGN4(lead + take);
+                }
+                offset = position + size;
+            }
+            position += size;
+        }
+    }
+    RECORDER_UNLOCK();
+    return copied;
+}
+
+const char *recorder_channel_name(RecorderChannel channel)
+{
+    return channel < RECORDER_CHANNELS ? CHANNEL_NAMES[channel] : "?";
+}
+
+size_t recorder_parse_block(const uint8_t *in, size_t available, void (*visit)(const RecorderEntry &entry, void *ctx), void *ctx)
+{
+    static uint8_t entries[RECORDER_RAW_SIZE];
+    BlockHeader found;
+    if (available < sizeof(found))
+    {
+        return 0;
+    }
+    memcpy(&found, in, sizeof(found));
+    size_t size = flash_block_size(BLOCKS, &found);
+    const uint8_t *payload = in + sizeof(found);
+    if (found.magic != RECORDER_MAGIC || found.raw_length > RECORDER_RAW_SIZE || found.length > found.raw_length ||
+        size > available || flash_block_crc(BLOCKS, &found, payload) != found.crc)
+    {
+        return 0;
+    }
+    size_t length = found.raw_length;
+    if (found.length == found.raw_length)
+    {
+        memcpy(entries, payload, length);
+    }
+    else if (lz_decompress(payload, found.length, entries, sizeof(entries)) != length)
+    {
+        return 0;
+    }
+    RecorderEntry entry = {found.boot, found.first_ms, RECORDER_GPS_RX, nullptr, 0};
+    const uint8_t *at = entries, *end = entries + length;
+    while (at < end)
+    {
+        uint32_t delta, chunk;
+        if (!(at = get_varint(at, end, delta)) || at == end)
+        {
+            return 0;
+        }
+        entry.channel = (RecorderChannel)*at++;
+        if (!(at = get_varint(at, end, chunk)) || chunk > (size_t)(end - at))
+        {
+            return 0;
+        }
+        entry.ms += delta;
+        entry.data = at;
+        entry.length = chunk;
+        visit(entry, ctx);
+        at += chunk;
+    }
+    return size;
+}
+
+RecorderStats recorder_stats()
+{
+    RECORDER_LOCK();
+    RecorderStats result = stats;
+    RECORDER_UNLOCK();
+    result.sectors = RECORDER_SECTORS;
+    return result;
+}
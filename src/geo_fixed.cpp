@@ -0,0 +1,292 @@
+/**
+ * @file geo_fixed.cpp
+ * @brief Fixed-point trigonometry and geodesy kernels, see geo_fixed.h
+ */
+
+#include "geo_fixed.h"
+
+#if defined(ARDUINO)
+#include <pgmspace.h>
+#else
+#define PROGMEM
+#define pgm_read_dword(addr) (*(const uint32_t *)(addr))
+#endif
+
+/* sin(i * 90 / 256 degrees) in Q30 */
+static const int32_t SIN_TABLE[257] PROGMEM = {
+    0, 6588356, 13176464, 19764076, 26350943, 32936819, 39521455, 46104602,
+    52686014, 59265442, 65842639, 72417357, 78989349, 85558366, 92124163, 98686491,
+    105245103, 111799753, 118350194, 124896179, 131437462, 137973796, 144504935, 151030634,
+    157550647, 164064728, 170572633, 177074115, 183568930, 190056834, 196537583, 203010932,
+    209476638, 215934457, 222384147, 228825464, 235258165, 241682010, 248096755, 254502159,
+    260897982, 267283981, 273659918, 280025552, 286380643, 292724951, 299058239, 305380268,
+    311690799, 317989595, 324276419, 330551034, 336813204, 343062693, 349299266, 355522689,
+    361732726, 367929144, 374111709, 380280190, 386434353, 392573967, 398698801, 404808624,
+    410903207, 416982319, 423045732, 429093217, 435124548, 441139496, 447137835, 453119340,
+    459083786, 465030947, 470960600, 476872522, 482766489, 488642281, 494499676, 500338453,
+    506158392, 511959275, 517740883, 523502998, 529245404, 534967884, 540670223, 546352205,
+    552013618, 557654248, 563273883, 568872310, 574449320, 580004702, 585538248, 591049748,
+    596538995, 602005783, 607449906, 612871159, 618269338, 623644239, 628995660, 634323400,
+    639627258, 644907034, 650162530, 655393548, 660599890, 665781362, 670937767, 676068911,
+    681174602, 686254647, 691308855, 696337036, 701339000, 706314559, 711263525, 716185713,
+    721080937, 725949013, 730789757, 735602987, 740388522, 745146182, 749875788, 754577161,
+    759250125, 763894504, 768510122, 773096806, 777654384, 782182683, 786681534, 791150767,
+    795590213, 799999706, 804379079, 808728167, 813046808, 817334838, 821592095, 825818421,
+    830013654, 834177638, 838310216, 842411232, 846480531, 850517961, 854523370, 858496606,
+    862437520, 866345964, 870221790, 874064853, 877875009, 881652112, 885396022, 889106597,
+    892783698, 896427186, 900036924, 903612776, 907154608, 910662286, 914135678, 917574653,
+    920979082, 924348837, 927683790, 930983817, 934248793, 937478595, 940673101, 943832191,
+    946955747, 950043650, 953095785, 956112036, 959092290, 962036435, 964944360, 967815955,
+    970651112, 973449725, 976211688, 978936898, 981625251, 984276646, 986890984, 989468165,
+    992008094, 994510675, 996975812, 999403415, 1001793390, 1004145648, 1006460100, 1008736660,
+    1010975242, 1013175761, 1015338134, 1017462281, 1019548121, 1021595575, 1023604567, 1025575020,
+    1027506862, 1029400018, 1031254418, 1033069992, 1034846671, 1036584389, 1038283080, 1039942680,
+    1041563127, 1043144360, 1044686319, 1046188946, 1047652185, 1049075980, 1050460278, 1051805027,
+    1053110176, 1054375676, 1055601479, 1056787540, 1057933813, 1059040255, 1060106826, 1061133483,
+    1062120190, 1063066909, 1063973603, 1064840240, 1065666786, 1066453210, 1067199483, 1067905576,
+    1068571464, 1069197120, 1069782521, 1070327646, 1070832474, 1071296985, 1071721163, 1072104991,
+    1072448455, 1072751542, 1073014240, 1073236540, 1073418433, 1073559913, 1073660973, 1073721611,
+    1073741824,
+};
+
+/* atan(2^-i) as binary angles */
+static const uint32_t ATAN_TABLE[30] = {
+    536870912, 316933406, 167458907, 85004756, 42667331, 21354465, 10679838, 5340245,
+    2670163, 1335087, 667544, 333772, 166886, 83443, 41722, 20861,
+    10430, 5215, 2608, 1304, 652, 326, 163, 81,
+    41, 20, 10, 5, 3, 1};
+
+#define E7_TO_ANGLE_Q31 2562047788LL // 2^32 / 3.6e9 in Q31
+#define E7_TO_CM_Q16 72873LL         // centimetres per 1e-7 degree of arc, Q16
+#define E7_TO_DM_Q20 116596LL        // decimetres per 1e-7 degree of arc, Q20
+#define ANGLE_TO_CM_Q16 61081LL      // centimetres per binary angle unit of arc, Q16
+#define E7_HALF_TURN 1800000000LL
+#define HALF_CHORD_TO_CM_Q16 77771LL // 2 * earth radius in cm / 2^30, Q16
+#define SMALL_HALF_CHORD (1L << 20)  // about 12 km
+#define SHORT_ARC_E7 (1L << 23)      // about 90 km
+#define SHORT_ARC_FRACTION_BITS 8
+
+geo_angle_t geo_e7_to_angle(int32_t deg_e7)
+{
+    return (geo_angle_t)(((int64_t)deg_e7 * E7_TO_ANGLE_Q31) >> 31);
+}
+
+int32_t geo_sin(geo_angle_t angle)
+{
+    uint8_t quadrant = angle >> 30;
+    uint32_t offset = angle & (GEO_ANGLE_QUARTER - 1);
+    if (quadrant & 1)
+    {
+        offset = GEO_ANGLE_QUARTER - offset; // mirror: sin(90 + a) = sin(90 - a)
+    }
+    uint32_t index = offset >> 22;
+    uint32_t fraction = offset & 0x3FFFFF;
+    int32_t value = (int32_t)pgm_read_dword(&SIN_TABLE[index]);
+    if (fraction)
+    {
+        int32_t next = (int32_t)pgm_read_dword(&SIN_TABLE[index + 1]);
+        value += (int32_t)(((int64_t)(next - value) * fraction) >> 22);
+    }
+    return quadrant & 2 ? -value : value;
+}
+
+int32_t geo_cos(geo_angle_t angle)
+{
+    return geo_sin(angle + GEO_ANGLE_QUARTER);
+}
+
+geo_angle_t geo_atan2(int32_t y, int32_t x)
+{
+    int64_t vx = x, vy = y;
+    geo_angle_t angle = 0;
+    if (vx < 0)
+    {
+        vx = -vx;
+        vy = -vy;
+        angle = 2 * GEO_ANGLE_QUARTER;
+    }
+    if (vx == 0 && vy == 0)
+    {
+        return 0;
+    }
+    // Normalise the magnitude to just under 2^29: large enough for precision, small enough that
+    // the CORDIC gain (1.65) cannot overflow 32 bits
+    while (vx >= (1L << 29) || vy >= (1L << 29) || vy <= -(1L << 29))
+    {
+        vx >>= 1;
+        vy >>= 1;
+    }
+    while (vx < (1L << 28) && vy < (1L << 28) && vy > -(1L << 28))
+    {
+        vx <<= 1;
+        vy <<= 1;
+    }
+    int32_t cx = vx, cy = vy;
+    for (uint8_t i = 0; i < 30; i++)
+    {
+        int32_t dx = cy >> i;
+        int32_t dy = cx >> i;
+        if (cy > 0)
+        {
+            cx += dx;
+            cy -= dy;
+            angle += ATAN_TABLE[i];
+        }
+        else
+        {
+            cx -= dx;
+            cy += dy;
+            angle -= ATAN_TABLE[i];
+        }
+    }
+    return angle;
+}
+
+uint32_t geo_isqrt32(uint32_t value)
+{
+    uint32_t root = 0;
+    uint32_t bit = 1UL << 30;
+    while (bit > value)
+    {
+        bit >>= 2;
+    }
+    while (bit)
+    {
+        if (value >= root + bit)
+        {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        }
+        else
+        {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
+
+uint32_t geo_isqrt64(uint64_t value)
+{
+    if (value <= 0xFFFFFFFFULL)
+    {
+        return geo_isqrt32((uint32_t)value);
+    }
+    uint64_t root = 0;
+    uint64_t bit = 1ULL << 62;
+    while (bit > value)
+    {
+        bit >>= 2;
+    }
+    while (bit)
+    {
+        if (value >= root + bit)
+        {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        }
+        else
+        {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t)root;
+}
+
+/**
+ * @brief - longitude difference wrapped into -180..180 degrees
+ */
+static int64_t delta_lng_e7(int32_t lng1_e7, int32_t lng2_e7)
+{
+    int64_t delta = (int64_t)lng2_e7 - lng1_e7;
+    if (delta > E7_HALF_TURN)
+    {
+        delta -= 2 * E7_HALF_TURN;
+    }
+    else if (delta < -E7_HALF_TURN)
+    {
+        delta += 2 * E7_HALF_TURN;
+    }
+    return delta;
+}
+
+/**
+ * @brief - east and north components between two points, in 1e-7 degrees of arc
+ * @return number of fraction bits in the components; short hops keep SHORT_ARC_FRACTION_BITS
+ * below the 1e-7 degree unit so they do not round away
+ */
+static uint8_t equirect_components(int32_t lat1_e7, int32_t lng1_e7, int32_t lat2_e7, int32_t lng2_e7, int64_t &east, int64_t &north)
+{
+    int32_t mean_lat = (int32_t)(((int64_t)lat1_e7 + lat2_e7) / 2);
+    int64_t dlng = delta_lng_e7(lng1_e7, lng2_e7);
+    int32_t cos_lat = geo_cos(geo_e7_to_angle(mean_lat));
+    north = (int64_t)lat2_e7 - lat1_e7;
+    if (dlng > -SHORT_ARC_E7 && dlng < SHORT_ARC_E7 && north > -SHORT_ARC_E7 && north < SHORT_ARC_E7)
+    {
+        east = (dlng * cos_lat) >> (30 - SHORT_ARC_FRACTION_BITS);
+        north <<= SHORT_ARC_FRACTION_BITS;
+        return SHORT_ARC_FRACTION_BITS;
+    }
+    east = (dlng * cos_lat) >> 30;
+    return 0;
+}
+
+uint32_t geo_equirect_cm(int32_t lat1_e7, int32_t lng1_e7, int32_t lat2_e7, int32_t lng2_e7)
+{
+    int64_t east, north;
+    uint8_t fraction_bits = equirect_components(lat1_e7, lng1_e7, lat2_e7, lng2_e7, east, north);
+    uint64_t arc = geo_isqrt64((uint64_t)(east * east) + (uint64_t)(north * north));
+    return (uint32_t)((arc * E7_TO_CM_Q16) >> (16 + fraction_bits));
+}
+
+uint32_t geo_haversine_cm(int32_t lat1_e7, int32_t lng1_e7, int32_t lat2_e7, int32_t lng2_e7)
+{
+    int32_t half_dlat = geo_sin((geo_angle_t)((int32_t)geo_e7_to_angle(lat2_e7 - lat1_e7) / 2));
+    int32_t half_dlng = geo_sin((geo_angle_t)((int32_t)geo_e7_to_angle((int32_t)delta_lng_e7(lng1_e7, lng2_e7)) / 2));
+    int64_t cos_product = ((int64_t)geo_cos(geo_e7_to_angle(lat1_e7)) * geo_cos(geo_e7_to_angle(lat2_e7))) >> 30;
+    // a = sin^2(dlat/2) + cos(lat1) cos(lat2) sin^2(dlng/2), kept in Q60 so short distances keep their precision
+    int64_t lng_term = (cos_product * half_dlng) >> 30;
+    uint64_t a = (uint64_t)((int64_t)half_dlat * half_dlat) + (uint64_t)(lng_term * half_dlng);
+    const uint64_t one = 1ULL << 60;
+    if (a > one)
+    {
+        a = one;
+    }
+    uint32_t half_chord = geo_isqrt64(a); // sin(central angle / 2), Q30
+    if (half_chord < SMALL_HALF_CHORD)
+    {
+        // asin(s) = s within 2e-7 here, and this avoids the CORDIC's absolute error
+        return (uint32_t)(((uint64_t)half_chord * HALF_CHORD_TO_CM_Q16) >> 16);
+    }
+    geo_angle_t central = 2 * geo_atan2(half_chord, geo_isqrt64(one - a));
+    return (uint32_t)(((uint64_t)central * ANGLE_TO_CM_Q16) >> 16);
+}
+
+uint16_t geo_bearing_cdeg(int32_t lat1_e7, int32_t lng1_e7, int32_t lat2_e7, int32_t lng2_e7)
+{
+    int64_t east, north;
+    if (equirect_components(lat1_e7, lng1_e7, lat2_e7, lng2_e7, east, north) == 0)
+    {
+        // Long hops keep whole units; halve them into atan2's 32-bit range
+        east /= 2;
+        north /= 2;
+    }
+    // atan2 measures counter-clockwise from east; a compass bearing is clockwise from north
+    geo_angle_t angle = geo_atan2((int32_t)east, (int32_t)north);
+    return (uint16_t)(((uint64_t)angle * 36000) >> 32);
+}
+
+void geo_projection_init(GeoProjection &projection, int32_t lat0_e7, int32_t lng0_e7)
+{
+    projection.lat0_e7 = lat0_e7;
+    projection.lng0_e7 = lng0_e7;
+    projection.cos_lat_q30 = geo_cos(geo_e7_to_angle(lat0_e7));
+}
+
+void geo_project_dm(const GeoProjection &projection, int32_t lat_e7, int32_t lng_e7, int32_t &x, int32_t &y)
+{
+    int64_t east = (delta_lng_e7(projection.lng0_e7, lng_e7) * projection.cos_lat_q30) >> 30;
+    x = (int32_t)((east * E7_TO_DM_Q20) >> 20);
+    y = (int32_t)((((int64_t)lat_e7 - projection.lat0_e7) * E7_TO_DM_Q20) >> 20);
+}
@@ -0,0 +1,384 @@
+/**
+ * @file gpsd_server.cpp
+ * @brief gpsd-compatible NMEA and JSON feed, see gpsd_server.h
+ */
+
+#include <Arduino.h>
+#if defined(ARDUINO_ARCH_ESP32)
+#include <WiFi.h>
+#else
+#include <ESP8266WiFi.h>
+#endif
+#include <stdio.h>
+#include <string.h>
+#include "events.h"
+#include "gpsd_server.h"
+
+#define GPSD_ESP32_WRITABLE 1460 // one TCP segment, see live_channel.cpp
+#define GPSD_TPV_SIZE 192
+#define GPSD_REPLY_SIZE 320
+
+/**
+ * @brief Byte stream with a single writer and any number of cursors reading behind it.
+ * Positions count bytes ever written. The writer reserves the positions it is about to
+ * overwrite before copying and publishes the head after, so a reader that finds the
+ * reservation less than SIZE ahead of its cursor after reading knows its bytes were intact.
+ */
+template <size_t SIZE>
+class ByteRing
+{
+    static_assert((SIZE & (SIZE - 1)) == 0, "SIZE must be a power of two");
+
+public:
+    ByteRing() : _head(0), _reserved(0) {}
+
+    void write(const char *data, size_t length)
+    {
+        if (length > SIZE)
+        {
+            data += length - SIZE;
+            length = SIZE;
+        }
+        uint32_t head = __atomic_load_n(&_head, __ATOMIC_RELAXED);
+        __atomic_store_n(&_reserved, head + length, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST); // the reservation is visible before any byte changes
+        size_t offset = head & (SIZE - 1);
+        size_t first = length < SIZE - offset ? length : SIZE - offset;
+        memcpy(_data + offset, data, first);
+        memcpy(_data, data + first, length - first);
+        __atomic_store_n(&_head, head + length, __ATOMIC_RELEASE);
+    }
+
+    uint32_t head() const { return __atomic_load_n(&_head, __ATOMIC_ACQUIRE); }
+
+    /**
+     * @brief - end of the bytes being or already written; call after reading
+     */
+    uint32_t reserved() const
+    {
+        __atomic_thread_fence(__ATOMIC_SEQ_CST); // the bytes were read before the reservation is
+        return __atomic_load_n(&_reserved, __ATOMIC_RELAXED);
+    }
+    const uint8_t *at(uint32_t position) const { return _data + (position & (SIZE - 1)); }
+
+    /**
+     * @brief - bytes readable at position without wrapping
+     */
+    size_t contiguous(uint32_t position, uint32_t head) const
+    {
+        size_t to_end = SIZE - (position & (SIZE - 1));
+        return head - position < to_end ? head - position : to_end;
+    }
+
+private:
+    uint8_t _data[SIZE];
+    uint32_t _head;
+    uint32_t _reserved;
+};
+
+struct GpsdClient
+{
+    WiFiClient socket;
+    bool nmea;
+    bool json;
+    uint32_t nmea_cursor;
+    uint32_t json_cursor;
+    uint8_t command_length;
+    char command[GPSD_COMMAND_SIZE];
+};
+
+static WiFiServer listener(GPSD_PORT);
+static GpsdClient clients[GPSD_MAX_CLIENTS];
+static ByteRing<GPSD_NMEA_RING_SIZE> nmea_ring;
+static ByteRing<GPSD_JSON_RING_SIZE> json_ring;
+static char last_tpv[GPSD_TPV_SIZE] = "";
+static uint32_t last_utc = 0;
+static uint8_t watchers = 0;
+static GpsdStats stats = {0, 0, 0, 0};
+
+static size_t writable(WiFiClient &socket)
+{
+#if defined(ARDUINO_ARCH_ESP32)
+    return socket.connected() ? GPSD_ESP32_WRITABLE : 0;
+#else
+    return socket.availableForWrite();
+#endif
+}
+
+static void count_watchers()
+{
+    uint8_t count = 0;
+    for (GpsdClient &client : clients)
+    {
+        count += client.socket && (client.nmea || client.json);
+    }
+    __atomic_store_n(&watchers, count, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief - ISO 8601 UTC time with milliseconds, as gpsd reports it
+ */
+static void format_time(uint32_t utc, char *out, size_t size)
+{
+    // Civil from days, the inverse of utc_from_civil()
+    int32_t days = utc / 86400 + 719468;
+    uint32_t seconds = utc % 86400;
+    int32_t era = days / 146097;
+    uint32_t doe = days - era * 146097;
+    uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    uint32_t mp = (5 * doy + 2) / 153;
+    uint32_t day = doy - (153 * mp + 2) / 5 + 1;
+    uint32_t month = mp < 10 ? mp + 3 : mp - 9;
+    uint32_t year = yoe + era * 400 + (month <= 2);
+    snprintf(out, size, "%04u-%02u-%02uT%02u:%02u:%02u.000Z", (unsigned)year, (unsigned)month, (unsigned)day,
+             (unsigned)(seconds / 3600), (unsigned)(seconds / 60 % 60), (unsigned)(seconds % 60));
+}
+
+/**
+ * @brief - 1e-7 degrees as a decimal without going through a double
+ */
+static void format_e7(int32_t value, char *out, size_t size)
+{
+    uint32_t magnitude = value < 0 ? -(uint32_t)value : value;
+    snprintf(out, size, "%s%u.%07u", value < 0 ? "-" : "", (unsigned)(magnitude / 10000000), (unsigned)(magnitude % 10000000));
+}
+
+static void on_fix(const FixEvent &event, void *ctx)
+{
+    (void)ctx;
+    const GpsFix &fix = event.fix;
+    last_utc = fix.utc;
+    char lat[16], lng[16], time[32] = "";
+    format_e7(fix.lat_e7, lat, sizeof(lat));
+    format_e7(fix.lng_e7, lng, sizeof(lng));
+    if (fix.utc)
+    {
+        time[0] = '"';
+        format_time(fix.utc, time + 1, sizeof(time) - 3);
+        strcat(time, "\",");
+    }
+    // Knots x100 to mm/s; no altitude is decoded, so fixes are 2D
+    uint32_t speed_mm_s = (uint32_t)fix.speed * 5144 / 1000;
+    snprintf(last_tpv, sizeof(last_tpv),
+             "{\"class\":\"TPV\",\"device\":\"" GPSD_DEVICE "\",\"mode\":2,%s%s\"lat\":%s,\"lon\":%s,\"speed\":%u.%03u,\"track\":%u.%02u}",
+             fix.utc ? "\"time\":" : "", time, lat, lng, (unsigned)(speed_mm_s / 1000), (unsigned)(speed_mm_s % 1000),
+             (unsigned)(fix.course / 100), (unsigned)(fix.course % 100));
+    for (GpsdClient &client : clients)
+    {
+        if (client.socket && client.json)
+        {
+            json_ring.write(last_tpv, strlen(last_tpv));
+            json_ring.write("\r\n", 2);
+            break;
+        }
+    }
+}
+
+static void send_reply(GpsdClient &client, const char *reply)
+{
+    size_t length = strlen(reply);
+    client.socket.write((const uint8_t *)reply, length);
+    client.socket.write((const uint8_t *)"\r\n", 2);
+    stats.bytes_sent += length + 2;
+}
+
+static void send_devices(GpsdClient &client)
+{
+    send_reply(client, "{\"class\":\"DEVICES\",\"devices\":[{\"class\":\"DEVICE\",\"path\":\"" GPSD_DEVICE "\",\"driver\":\"NMEA0183\",\"bps\":9600,\"flags\":1}]}");
+}
+
+static void send_version(GpsdClient &client)
+{
+    send_reply(client, "{\"class\":\"VERSION\",\"release\":\"3.17\",\"rev\":\"tracker\",\"proto_major\":3,\"proto_minor\":11}");
+}
+
+static bool json_flag(const char *json, const char *key, bool fallback)
+{
+    const char *found = strstr(json, key);
+    if (!found)
+    {
+        return fallback;
+    }
+    found += strlen(key);
+    return *found == 't' || (*found >= '1' && *found <= '9');
+}
+
+static void handle_command(GpsdClient &client)
+{
+    char reply[GPSD_REPLY_SIZE];
+    const char *command = client.command;
+    if (strncmp(command, "?WATCH", 6) == 0)
+    {
+        bool enable = json_flag(command, "\"enable\":", true);
+        bool nmea = enable && (json_flag(command, "\"nmea\":", false) || json_flag(command, "\"raw\":", false));
+        bool json = enable && json_flag(command, "\"json\":", !nmea);
+        // A new watch starts at the live edge of each stream
+        client.nmea_cursor = nmea_ring.head();
+        client.json_cursor = json_ring.head();
+        client.nmea = nmea;
+        client.json = json;
+        count_watchers();
+        send_devices(client);
+        snprintf(reply, sizeof(reply), "{\"class\":\"WATCH\",\"enable\":%s,\"json\":%s,\"nmea\":%s,\"raw\":0,\"scaled\":false,\"timing\":false}",
+                 enable ? "true" : "false", json ? "true" : "false", nmea ? "true" : "false");
+        send_reply(client, reply);
+    }
+    else if (strncmp(command, "?DEVICES", 8) == 0)
+    {
+        send_devices(client);
+    }
+    else if (strncmp(command, "?VERSION", 8) == 0)
+    {
+        send_version(client);
+    }
+    else if (strncmp(command, "?POLL", 5) == 0)
+    {
+        char time[32] = "";
+        if (last_utc)
+        {
+            format_time(last_utc, time, sizeof(time));
+        }
+        snprintf(reply, sizeof(reply), "{\"class\":\"POLL\",\"time\":\"%s\",\"active\":1,\"tpv\":[%s],\"sky\":[]}", time, last_tpv);
+        send_reply(client, reply);
+    }
+    else
+    {
+        snprintf(reply, sizeof(reply), "{\"class\":\"ERROR\",\"message\":\"Unrecognized request '%.32s'\"}", command);
+        send_reply(client, reply);
+    }
+}
+
+static void read_commands(GpsdClient &client)
+{
+    while (client.socket.available())
+    {
+        char c = client.socket.read();
+        if (c == ';' || c == '\n' || c == '\r')
+        {
+            if (client.command_length)
+            {
+                client.command[client.command_length] = '\0';
+                handle_command(client);
+                client.command_length = 0;
+            }
+        }
+        else if (client.command_length < GPSD_COMMAND_SIZE - 1)
+        {
+            client.command[client.command_length++] = c;
+        }
+    }
+}
+
+/**
+ * @brief - send a client as much of a stream as its socket takes, straight from the ring
+ * @return false if the client fell a whole ring behind
+ */
+template <size_t SIZE>
+static bool send_stream(GpsdClient &client, const ByteRing<SIZE> &ring, uint32_t &cursor)
+{
+    uint32_t head = ring.head();
+    while (cursor != head)
+    {
+        if (head - cursor > SIZE)
+        {
+            return false;
+        }
+        size_t room = writable(client.socket);
+        if (room == 0)
+        {
+            break;
+        }
+        size_t length = ring.contiguous(cursor, head);
+        length = length < room ? length : room;
+        size_t sent = client.socket.write(ring.at(cursor), length);
+        // The writer may have started overwriting the bytes while they were being sent
+        if (ring.reserved() - cursor > SIZE)
+        {
+            return false;
+        }
+        cursor += sent;
+        stats.bytes_sent += sent;
+        if (sent < length)
+        {
+            break;
+        }
+    }
+    return true;
+}
+
+void gpsd_begin()
+{
+    listener.begin();
+    listener.setNoDelay(true);
+    fix_events.subscribe(on_fix);
+}
+
+void gpsd_feed(const char *data, size_t length)
+{
+    nmea_ring.write(data, length);
+}
+
+void gpsd_loop()
+{
+    while (listener.hasClient())
+    {
+        GpsdClient *slot = nullptr;
+        for (GpsdClient &client : clients)
+        {
+            if (!client.socket)
+            {
+                slot = &client;
+                break;
+            }
+        }
+        if (!slot)
+        {
+            listener.available().stop(); // full: refuse rather than evict a watcher
+            continue;
+        }
+        slot->socket = listener.available();
+        slot->nmea = slot->json = false;
+        slot->command_length = 0;
+        stats.connections++;
+        send_version(*slot);
+    }
+
+    uint8_t connected = 0;
+    for (GpsdClient &client : clients)
+    {
+        if (!client.socket)
+        {
+            continue;
+        }
+        if (!client.socket.connected())
+        {
+            client.socket.stop();
+            client.nmea = client.json = false;
+            continue;
+        }
+        read_commands(client);
+        bool keeping_up = (!client.nmea || send_stream(client, nmea_ring, client.nmea_cursor)) &&
+                          (!client.json || send_stream(client, json_ring, client.json_cursor));
+        if (!keeping_up)
+        {
+            client.socket.stop();
+            client.nmea = client.json = false;
+            stats.clients_dropped++;
+            continue;
+        }
+        connected++;
+    }
+    stats.clients = connected;
+    count_watchers();
+}
+
+uint8_t gpsd_watchers()
+{
+    return __atomic_load_n(&watchers, __ATOMIC_RELAXED);
+}
+
+GpsdStats gpsd_stats()
+{
+    return stats;
+}
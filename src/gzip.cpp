@@ -0,0 +1,191 @@
+/**
+ * @file gzip.cpp
+ * @brief Fixed-Huffman deflate in a gzip wrapper, see gzip.h
+ */
+
+#include <string.h>
+#include "crc.h"
+#include "gzip.h"
+
+#define MIN_MATCH 3
+#define MAX_MATCH 258
+#define MAX_DISTANCE 32768
+#define END_OF_BLOCK 256
+
+static const uint16_t LENGTH_BASE[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const uint8_t LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const uint16_t DISTANCE_BASE[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const uint8_t DISTANCE_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+static uint16_t hash_head[1 << GZIP_HASH_BITS]; // last position + 1 of each hash, 0 if none
+
+/**
+ * @brief Deflate bit stream, least significant bit first, into a bounded buffer
+ */
+struct BitWriter
+{
+    uint8_t *out;
+    size_t max;
+    size_t length;
+    uint32_t bits;
+    uint8_t count;
+    bool overflow;
+
+    void put(uint32_t value, uint8_t width)
+    {
+        bits |= value << count;
+        count += width;
+        while (count >= 8)
+        {
+            byte((uint8_t)bits);
+            bits >>= 8;
+            count -= 8;
+        }
+    }
+
+    /**
+     * @brief - Huffman codes go most significant bit first
+     */
+    void put_code(uint32_t code, uint8_t width)
+    {
+        uint32_t reversed = 0;
+        for (uint8_t i = 0; i < width; i++)
+        {
+            reversed = (reversed << 1) | ((code >> i) & 1);
+        }
+        put(reversed, width);
+    }
+
+    void byte(uint8_t value)
+    {
+        if (length < max)
+        {
+            out[length++] = value;
+        }
+        else
+        {
+            overflow = true;
+        }
+    }
+
+    void flush()
+    {
+        if (count)
+        {
+            byte((uint8_t)bits);
+        }
+        bits = 0;
+        count = 0;
+    }
+};
+
+static void put_literal(BitWriter &writer, uint16_t symbol)
+{
+    if (symbol < 144)
+    {
+        writer.put_code(0x30 + symbol, 8);
+    }
+    else if (symbol < 256)
+    {
+        writer.put_code(0x190 + symbol - 144, 9);
+    }
+    else if (symbol < 280)
+    {
+        writer.put_code(symbol - 256, 7);
+    }
+    else
+    {
+        writer.put_code(0xC0 + symbol - 280, 8);
+    }
+}
+
+static void put_match(BitWriter &writer, uint16_t length, uint16_t distance)
+{
+    uint8_t code = 28;
+    while (LENGTH_BASE[code] > length)
+    {
+        code--;
+    }
+    put_literal(writer, 257 + code);
+    writer.put(length - LENGTH_BASE[code], LENGTH_EXTRA[code]);
+    code = 29;
+    while (DISTANCE_BASE[code] > distance)
+    {
+        code--;
+    }
+    writer.put_code(code, 5);
+    writer.put(distance - DISTANCE_BASE[code], DISTANCE_EXTRA[code]);
+}
+
+static uint16_t hash3(const uint8_t *p)
+{
+    uint32_t value = (uint32_t)p[0] << 16 | (uint32_t)p[1] << 8 | p[2];
+    return (uint16_t)((value * 2654435761u) >> (32 - GZIP_HASH_BITS));
+}
+
+static void put_le32(BitWriter &writer, uint32_t value)
+{
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        writer.byte((uint8_t)(value >> (8 * i)));
+    }
+}
+
+size_t gzip_compress(const uint8_t *in, size_t length, uint8_t *out, size_t max)
+{
+    if (length > GZIP_MAX_INPUT)
+    {
+        return 0;
+    }
+    static const uint8_t HEADER[10] = {0x1F, 0x8B, 8, 0, 0, 0, 0, 0, 0, 0xFF}; // deflate, no name or time, unknown OS
+    BitWriter writer = {out, max, 0, 0, 0, false};
+    for (uint8_t value : HEADER)
+    {
+        writer.byte(value);
+    }
+    writer.put(1, 1); // final block
+    writer.put(1, 2); // fixed Huffman codes
+
+    memset(hash_head, 0, sizeof(hash_head));
+    size_t position = 0;
+    while (position < length && !writer.overflow)
+    {
+        uint16_t match = 0;
+        size_t candidate = 0;
+        if (position + MIN_MATCH <= length)
+        {
+            uint16_t hash = hash3(in + position);
+            candidate = hash_head[hash];
+            hash_head[hash] = (uint16_t)(position + 1);
+            if (candidate && position - (candidate - 1) <= MAX_DISTANCE)
+            {
+                candidate--;
+                size_t limit = length - position < MAX_MATCH ? length - position : MAX_MATCH;
+                while (match < limit && in[candidate + match] == in[position + match])
+                {
+                    match++;
+                }
+            }
+        }
+        if (match < MIN_MATCH)
+        {
+            put_literal(writer, in[position++]);
+            continue;
+        }
+        put_match(writer, match, (uint16_t)(position - candidate));
+        // Index the positions inside the match too, so the next repeat finds the newest copy
+        size_t end = position + match;
+        for (position++; position < end; position++)
+        {
+            if (position + MIN_MATCH <= length)
+            {
+                hash_head[hash3(in + position)] = (uint16_t)(position + 1);
+            }
+        }
+    }
+    put_literal(writer, END_OF_BLOCK);
+    writer.flush();
+    put_le32(writer, crc32_update(0, in, length));
+    put_le32(writer, (uint32_t)length);
+    return writer.overflow ? 0 : writer.length;
+}
@@ -0,0 +1,209 @@
+/**
+ * @file health.cpp
+ * @brief Health supervisor, see health.h
+ */
+
+#include "health.h"
+
+#define HEALTH_STALL_MS 2000 // a longer gap between services means the owner was held up
+
+struct Supervised
+{
+    bool registered;
+    uint32_t silent_ms;
+    uint8_t max_failures;
+    bool (*probe)();
+    bool (*restart)();
+    uint8_t failures;      // bad reports in a row
+    uint8_t restarts_run;  // restarts in a row without a recovery
+    uint32_t last_ok_ms;
+    uint32_t bad_since_ms; // first bad report of the current run
+    uint32_t down_since_ms;
+    uint32_t restarted_ms;
+    uint32_t probed_ms;
+    uint32_t serviced_ms;
+    uint32_t retry_ms;     // backoff while failed
+    HealthStats stats;
+};
+
+static Supervised subsystems[HEALTH_SUBSYSTEMS];
+static uint32_t (*clock_source)() = nullptr;
+static bool (*escalate_restart)(HealthSubsystem) = nullptr;
+
+void health_begin(uint32_t (*clock_ms)(), bool (*escalate)(HealthSubsystem))
+{
+    clock_source = clock_ms;
+    escalate_restart = escalate;
+}
+
+void health_register(HealthSubsystem subsystem, uint32_t silent_ms, uint8_t max_failures, bool (*probe)(), bool (*restart)())
+{
+    if (subsystem >= HEALTH_SUBSYSTEMS || !clock_source)
+    {
+        return;
+    }
+    uint32_t now = clock_source();
+    Supervised &s = subsystems[subsystem];
+    s = {};
+    s.registered = true;
+    s.silent_ms = silent_ms;
+    s.max_failures = max_failures ? max_failures : 1;
+    s.probe = probe;
+    s.restart = restart;
+    s.last_ok_ms = s.probed_ms = s.serviced_ms = now;
+}
+
+static void recovered(Supervised &s, uint32_t now)
+{
+    s.stats.state = HEALTH_OK;
+    s.stats.recoveries++;
+    s.stats.last_recovery_ms = now - s.down_since_ms;
+    s.stats.total_recovery_ms += s.stats.last_recovery_ms;
+    s.restarts_run = 0;
+    s.failures = 0;
+    s.last_ok_ms = now;
+}
+
+void health_report(HealthSubsystem subsystem, bool ok)
+{
+    if (subsystem >= HEALTH_SUBSYSTEMS || !subsystems[subsystem].registered)
+    {
+        return;
+    }
+    Supervised &s = subsystems[subsystem];
+    if (s.stats.state == HEALTH_RESTARTING)
+    {
+        return;
+    }
+    uint32_t now = clock_source();
+    if (ok)
+    {
+        s.failures = 0;
+        s.last_ok_ms = now;
+        if (s.stats.state != HEALTH_OK)
+        {
+            recovered(s, now);
+        }
+        return;
+    }
+    if (s.failures == 0)
+    {
+        s.bad_since_ms = now;
+    }
+    if (s.failures < UINT8_MAX)
+    {
+        s.failures++;
+    }
+}
+
+void health_service(HealthSubsystem subsystem)
+{
+    if (subsystem >= HEALTH_SUBSYSTEMS || !subsystems[subsystem].registered)
+    {
+        return;
+    }
+    Supervised &s = subsystems[subsystem];
+    if (s.stats.state == HEALTH_RESTARTING)
+    {
+        return;
+    }
+    uint32_t now = clock_source();
+    // Nothing was read while the owner was blocked (an upload, another subsystem's restart),
+    // so that time is not silence
+    uint32_t gap = now - s.serviced_ms;
+    s.serviced_ms = now;
+    if (gap > HEALTH_STALL_MS)
+    {
+        s.last_ok_ms = now - s.last_ok_ms > gap ? s.last_ok_ms + gap : now;
+        s.restarted_ms = now - s.restarted_ms > gap ? s.restarted_ms + gap : now;
+    }
+    if (s.probe && now - s.probed_ms >= HEALTH_PROBE_MS)
+    {
+        s.probed_ms = now;
+        health_report(subsystem, s.probe());
+    }
+
+    bool failed = s.failures >= s.max_failures;
+    if (s.stats.state == HEALTH_FAILED)
+    {
+        if (now - s.restarted_ms < s.retry_ms)
+        {
+            return;
+        }
+        s.retry_ms = s.retry_ms < HEALTH_RETRY_MAX_MS / 2 ? s.retry_ms * 2 : HEALTH_RETRY_MAX_MS;
+    }
+    else if (s.stats.state == HEALTH_OK)
+    {
+        if (failed)
+        {
+            s.down_since_ms = s.bad_since_ms;
+        }
+        else if (s.silent_ms && now - s.last_ok_ms >= s.silent_ms)
+        {
+            s.down_since_ms = s.last_ok_ms;
+        }
+        else
+        {
+            return;
+        }
+    }
+    else if (!failed && !(s.silent_ms && now - s.restarted_ms >= s.silent_ms))
+    {
+        return; // give the last restart its chance
+    }
+
+    if (s.restarts_run >= HEALTH_MAX_RESTARTS)
+    {
+        s.restarts_run = 0;
+        s.restarted_ms = now;
+        s.failures = 0;
+        if (escalate_restart && escalate_restart(subsystem)) // does not return on the device
+        {
+            s.stats.escalations++;
+            s.stats.state = HEALTH_RECOVERING;
+        }
+        else
+        {
+            s.stats.failures++;
+            s.stats.state = HEALTH_FAILED;
+            s.retry_ms = HEALTH_RETRY_MS;
+        }
+        return;
+    }
+    HealthState after = s.stats.state == HEALTH_FAILED ? HEALTH_FAILED : HEALTH_RECOVERING;
+    s.stats.state = HEALTH_RESTARTING;
+    s.stats.restarts++;
+    if (after == HEALTH_RECOVERING)
+    {
+        s.restarts_run++; // retries of a failed subsystem do not escalate again
+    }
+    s.failures = 0;
+    bool ok = s.restart && s.restart();
+    now = clock_source();
+    s.restarted_ms = s.probed_ms = s.serviced_ms = now;
+    s.stats.state = after;
+    if (ok)
+    {
+        recovered(s, now);
+    }
+}
+
+const char *health_subsystem_name(HealthSubsystem subsystem)
+{
+    switch (subsystem)
+    {
+    case HEALTH_MODEM:
+        return "modem";
+    case HEALTH_GPS:
+        return "gps";
+    case HEALTH_WEB:
+        return "web";
+    default:
+        return "unknown";
+    }
+}
+
+HealthStats health_stats(HealthSubsystem subsystem)
+{
+    return subsystem < HEALTH_SUBSYSTEMS ? subsystems[subsystem].stats : HealthStats{};
+}
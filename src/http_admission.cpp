@@ -0,0 +1,103 @@
+/**
+ * @file http_admission.cpp
+ * @brief Per-client token buckets and CPU budget for the web server, see http_admission.h
+ */
+
+#include "http_admission.h"
+
+struct ClientBucket
+{
+    uint32_t ip;
+    uint32_t refilled_at;
+    uint32_t last_seen;
+    uint8_t tokens;
+};
+
+static ClientBucket buckets[HTTP_CLIENT_SLOTS];
+/* CPU credit is kept in 1/100 ms so short loop iterations still earn their share */
+#define CPU_CREDIT_SCALE 100
+#define CPU_CREDIT_MAX (HTTP_CPU_CREDIT_MAX_MS * CPU_CREDIT_SCALE)
+static int32_t cpu_credit = CPU_CREDIT_MAX;
+static uint32_t cpu_updated_at = 0;
+static HttpAdmissionStats stats = {0, 0, 0};
+
+/**
+ * @brief - find the bucket for an IP, recycling the least recently seen one if needed
+ */
+static ClientBucket &bucket_for(uint32_t ip, uint32_t now)
+{
+    ClientBucket *oldest = &buckets[0];
+    for (uint8_t i = 0; i < HTTP_CLIENT_SLOTS; i++)
+    {
+        if (buckets[i].ip == ip && buckets[i].last_seen != 0)
+        {
+            return buckets[i];
+        }
+        if ((int32_t)(buckets[i].last_seen - oldest->last_seen) < 0 || buckets[i].last_seen == 0)
+        {
+            oldest = &buckets[i];
+        }
+    }
+    oldest->ip = ip;
+    oldest->refilled_at = now;
+    oldest->tokens = HTTP_BUCKET_SIZE;
+    return *oldest;
+}
+
+bool http_admit(uint32_t ip, uint32_t now)
+{
+    if (now == 0)
+    {
+        now = 1; // last_seen == 0 marks a free slot
+    }
+    ClientBucket &bucket = bucket_for(ip, now);
+    bucket.last_seen = now;
+    uint32_t refills = (now - bucket.refilled_at) / HTTP_REFILL_MS;
+    if (refills)
+    {
+        bucket.tokens = refills >= (uint32_t)(HTTP_BUCKET_SIZE - bucket.tokens) ? HTTP_BUCKET_SIZE : bucket.tokens + refills;
+        bucket.refilled_at += refills * HTTP_REFILL_MS;
+    }
+    if (bucket.tokens == 0)
+    {
+        stats.rejected++;
+        return false;
+    }
+    bucket.tokens--;
+    stats.admitted++;
+    return true;
+}
+
+bool http_cpu_available(uint32_t now)
+{
+    uint32_t elapsed = now - cpu_updated_at;
+    cpu_updated_at = now;
+    if (elapsed > HTTP_CPU_CREDIT_MAX_MS * CPU_CREDIT_SCALE / HTTP_CPU_SHARE_PERCENT)
+    {
+        cpu_credit = CPU_CREDIT_MAX;
+    }
+    else
+    {
+        cpu_credit += elapsed * HTTP_CPU_SHARE_PERCENT;
+        if (cpu_credit > CPU_CREDIT_MAX)
+        {
+            cpu_credit = CPU_CREDIT_MAX;
+        }
+    }
+    if (cpu_credit <= 0)
+    {
+        stats.deferred++;
+        return false;
+    }
+    return true;
+}
+
+void http_cpu_charge(uint32_t elapsed_us)
+{
+    cpu_credit -= (int32_t)(elapsed_us / (1000 / CPU_CREDIT_SCALE));
+}
+
+HttpAdmissionStats http_admission_stats()
+{
+    return stats;
+}
@@ -0,0 +1,234 @@
+/**
+ * @file live_channel.cpp
+ * @brief Binary WebSocket channel for live map clients, see live_channel.h
+ */
+
+#include <Arduino.h>
+#include <WebSocketsServer.h>
+#include "live_channel.h"
+#include "live_session.h"
+#include "track_archive.h"
+
+#define LIVE_ESP32_WRITABLE 1460 // one TCP segment
+
+/**
+ * @brief WebSocketsServer with access to the client sockets, to check for room before sending
+ */
+class LiveSocketServer : public WebSocketsServer
+{
+public:
+    LiveSocketServer(uint16_t port) : WebSocketsServer(port) {}
+
+    size_t writable(uint8_t num)
+    {
+        WSclient_t *client = &_clients[num];
+#if defined(ARDUINO_ARCH_ESP32)
+        // The ESP32 WiFiClient does not report its send space. Writes wait on the socket
+        // instead, which only holds up the HTTP task, so offer room for a history page
+        return client->tcp && client->tcp->connected() ? LIVE_ESP32_WRITABLE : 0;
+#else
+        return client->tcp ? client->tcp->availableForWrite() : 0;
+#endif
+    }
+};
+
+struct LiveClient
+{
+    bool connected;
+    bool fix_pending;
+    uint32_t blocked_since; // 0 while the client keeps up
+    // History request being paged out
+    bool history_pending;
+    uint32_t history_from;
+    uint32_t history_to;
+    size_t history_sent; // the skip given to track_archive_query()
+};
+
+#define FIX_FRAME_SIZE (1 + sizeof(FixRecord))
+#define HISTORY_FRAME_SIZE (2 + LIVE_HISTORY_PAGE * sizeof(FixRecord))
+// Room to leave for the WebSocket header on top of the payload
+#define WS_HEADER_SIZE 4
+
+static LiveSocketServer socket_server(LIVE_PORT);
+static LiveClient clients[WEBSOCKETS_SERVER_CLIENT_MAX];
+static uint8_t fix_frame[FIX_FRAME_SIZE];
+static uint32_t fix_frame_time_ms = 0;
+static bool fix_frame_delivered = false;
+static LiveChannelStats stats = {0, 0, 0, 0};
+
+static uint32_t read_le32(const uint8_t *ptr)
+{
+    return ptr[0] | (ptr[1] << 8) | ((uint32_t)ptr[2] << 16) | ((uint32_t)ptr[3] << 24);
+}
+
+static void handle_command(uint8_t num, const uint8_t *payload, size_t length)
+{
+    if (length == 0)
+    {
+        return;
+    }
+    ControlEvent control;
+    switch (payload[0])
+    {
+    case LIVE_CMD_START:
+        if (length >= 3)
+        {
+            control.command = CONTROL_START_LIVE;
+            control.duration_s = payload[1] | (payload[2] << 8);
+            control_events.publish(control);
+        }
+        break;
+    case LIVE_CMD_STOP:
+        control.command = CONTROL_STOP_LIVE;
+        control.duration_s = 0;
+        control_events.publish(control);
+        break;
+    case LIVE_CMD_HISTORY:
+        if (length >= 9)
+        {
+            clients[num].history_pending = true;
+            clients[num].history_from = read_le32(payload + 1);
+            clients[num].history_to = read_le32(payload + 5);
+            clients[num].history_sent = 0;
+        }
+        break;
+    }
+}
+
+static void on_socket_event(uint8_t num, WStype_t type, uint8_t *payload, size_t length)
+{
+    if (num >= WEBSOCKETS_SERVER_CLIENT_MAX)
+    {
+        return;
+    }
+    switch (type)
+    {
+    case WStype_CONNECTED:
+        memset(&clients[num], 0, sizeof(LiveClient));
+        clients[num].connected = true;
+        clients[num].fix_pending = fix_events.has_last();
+        stats.clients++;
+        break;
+    case WStype_DISCONNECTED:
+        if (clients[num].connected)
+        {
+            clients[num].connected = false;
+            stats.clients--;
+        }
+        break;
+    case WStype_BIN:
+        handle_command(num, payload, length);
+        break;
+    default:
+        break;
+    }
+}
+
+static void on_fix(const FixEvent &event, void *ctx)
+{
+    (void)ctx;
+    FixRecord record = make_fix_record(event);
+    fix_frame[0] = LIVE_FRAME_FIX;
+    memcpy(fix_frame + 1, &record, sizeof(record));
+    fix_frame_time_ms = event.fix.time_ms;
+    fix_frame_delivered = false;
+    for (uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++)
+    {
+        if (!clients[i].connected)
+        {
+            continue;
+        }
+        if (clients[i].fix_pending)
+        {
+            stats.frames_coalesced++;
+        }
+        clients[i].fix_pending = true;
+    }
+}
+
+/**
+ * @brief - send the next page of a history request if the client has room for it
+ * @return false if the client is blocked
+ */
+static bool send_history_page(uint8_t num)
+{
+    LiveClient &client = clients[num];
+    if (socket_server.writable(num) < HISTORY_FRAME_SIZE + WS_HEADER_SIZE)
+    {
+        return false;
+    }
+    uint8_t frame[HISTORY_FRAME_SIZE];
+    size_t count = track_archive_query(client.history_from, client.history_to, client.history_sent,
+                                      (FixRecord *)(frame + 2), LIVE_HISTORY_PAGE);
+    frame[0] = LIVE_FRAME_HISTORY;
+    frame[1] = count;
+    socket_server.sendBIN(num, frame, 2 + count * sizeof(FixRecord));
+    stats.frames_sent++;
+    client.history_sent += count;
+    // An empty or short page ends the slice
+    client.history_pending = count == LIVE_HISTORY_PAGE;
+    return true;
+}
+
+void live_channel_begin()
+{
+    socket_server.begin();
+    socket_server.onEvent(on_socket_event);
+    fix_events.subscribe(on_fix);
+}
+
+void live_channel_loop()
+{
+    socket_server.loop();
+    uint32_t now = millis();
+    for (uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++)
+    {
+        LiveClient &client = clients[i];
+        if (!client.connected || (!client.fix_pending && !client.history_pending))
+        {
+            continue;
+        }
+        bool blocked = false;
+        if (client.fix_pending)
+        {
+            if (socket_server.writable(i) >= FIX_FRAME_SIZE + WS_HEADER_SIZE)
+            {
+                socket_server.sendBIN(i, fix_frame, FIX_FRAME_SIZE);
+                stats.frames_sent++;
+                client.fix_pending = false;
+                if (!fix_frame_delivered)
+                {
+                    live_session_record_latency(millis() - fix_frame_time_ms);
+                    fix_frame_delivered = true;
+                }
+            }
+            else
+            {
+                blocked = true;
+            }
+        }
+        if (!blocked && client.history_pending)
+        {
+            blocked = !send_history_page(i);
+        }
+
+        if (!blocked)
+        {
+            client.blocked_since = 0;
+        }
+        else if (client.blocked_since == 0)
+        {
+            client.blocked_since = now | 1;
+        }
+        else if (now - client.blocked_since > LIVE_STALL_MS)
+        {
+            socket_server.disconnect(i);
+            stats.clients_dropped++;
+        }
+    }
+}
+
+LiveChannelStats live_channel_stats()
+{
+    return stats;
+}
@@ -0,0 +1,120 @@
+/**
+ * @file live_session.cpp
+ * @brief High-rate live-follow mode, see live_session.h
+ */
+
+#include "events.h"
+#include "live_session.h"
+#include "ubx.h"
+
+#define NORMAL_RATE_MS 1000
+
+static Stream *gps = nullptr;
+static bool active = false;
+static uint32_t started_at = 0;
+static uint32_t duration_ms = 0;
+static LiveSessionStats stats = {};
+
+/* Sentences the tracker does not decode, switched off during a session */
+static const uint8_t UNUSED_SENTENCES[] = {NMEA_GLL, NMEA_GSA, NMEA_GSV, NMEA_VTG};
+
+static void configure_receiver(bool live)
+{
+    for (uint8_t id : UNUSED_SENTENCES)
+    {
+        ubx_set_nmea_rate(*gps, id, live ? 0 : 1);
+    }
+    ubx_set_rate(*gps, live ? LIVE_SESSION_RATE_MS : NORMAL_RATE_MS);
+}
+
+static void stop()
+{
+    if (!active)
+    {
+        return;
+    }
+    active = false;
+    configure_receiver(false);
+    Serial.println("Live session ended");
+}
+
+static void start(uint16_t duration_s)
+{
+    if (duration_s == 0)
+    {
+        duration_s = LIVE_SESSION_DEFAULT_S;
+    }
+    if (duration_s > LIVE_SESSION_MAX_S)
+    {
+        duration_s = LIVE_SESSION_MAX_S;
+    }
+    // A repeated start only extends the session
+    if (!active)
+    {
+        configure_receiver(true);
+        stats.sessions++;
+    }
+    active = true;
+    started_at = millis();
+    duration_ms = duration_s * 1000UL;
+    Serial.print("Live session for ");
+    Serial.print(duration_s);
+    Serial.println(" s");
+}
+
+static void on_control(const ControlEvent &event, void *ctx)
+{
+    (void)ctx;
+    if (event.command == CONTROL_START_LIVE)
+    {
+        start(event.duration_s);
+    }
+    else if (event.command == CONTROL_STOP_LIVE)
+    {
+        stop();
+    }
+}
+
+void live_session_begin(Stream *gps_port)
+{
+    gps = gps_port;
+    control_events.subscribe(on_control);
+}
+
+void live_session_loop()
+{
+    if (active && millis() - started_at >= duration_ms)
+    {
+        stop();
+    }
+}
+
+bool live_session_active()
+{
+    return active;
+}
+
+void live_session_record_latency(uint32_t latency_ms)
+{
+    if (!active)
+    {
+        return;
+    }
+    if (stats.fixes == 0 || latency_ms < stats.latency_min)
+    {
+        stats.latency_min = latency_ms;
+    }
+    if (latency_ms > stats.latency_max)
+    {
+        stats.latency_max = latency_ms;
+    }
+    stats.latency_last = latency_ms;
+    stats.latency_total += latency_ms;
+    stats.fixes++;
+}
+
+LiveSessionStats live_session_stats()
+{
+    stats.remaining_s = active ? (duration_ms - (millis() - started_at)) / 1000 : 0;
+    return stats;
+}
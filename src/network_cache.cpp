@@ -0,0 +1,247 @@
+/**
+ * @file network_cache.cpp
+ * @brief Targeted network attach, see network_cache.h
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "network_cache.h"
+
+/* COPS access technologies */
+#define ACT_GSM 0
+#define ACT_GSM_COMPACT 1
+#define ACT_EGPRS 3
+#define ACT_EUTRAN 7
+
+/* AT+QCFG="nwscanmode" values */
+#define SCAN_MODE_AUTO 0
+#define SCAN_MODE_GSM 1
+#define SCAN_MODE_LTE 3
+
+/* GSM bands in the order of the <gsmbandval> bits, with the space so " 900" is not in "PCS 1900" */
+static const char *const GSM_BANDS[] = {" 900", " 1800", " 850", " 1900"};
+
+/**
+ * @brief - parse a decimal number, advancing the cursor
+ * @return false if there are no digits
+ */
+static bool parse_number(const char *&ptr, uint32_t &value)
+{
+    char *end;
+    value = strtoul(ptr, &end, 10);
+    if (end == ptr)
+    {
+        return false;
+    }
+    ptr = end;
+    return true;
+}
+
+bool network_parse_cops(const char *reply, NetworkSelection &selection)
+{
+    const char *ptr = strstr(reply, "+COPS:");
+    uint32_t mode, format, act;
+    if (!ptr)
+    {
+        return false;
+    }
+    ptr += 6;
+    while (*ptr == ' ')
+    {
+        ptr++;
+    }
+    if (!parse_number(ptr, mode) || *ptr++ != ',' || !parse_number(ptr, format) || format != 2 || *ptr++ != ',' || *ptr++ != '"')
+    {
+        return false;
+    }
+    const char *quote = strchr(ptr, '"');
+    size_t length = quote ? quote - ptr : 0;
+    if (length < 5 || length >= sizeof(selection.plmn))
+    {
+        return false;
+    }
+    for (size_t i = 0; i < length; i++)
+    {
+        if (ptr[i] < '0' || ptr[i] > '9')
+        {
+            return false;
+        }
+    }
+    ptr = quote + 1;
+    if (*ptr++ != ',' || !parse_number(ptr, act))
+    {
+        return false;
+    }
+    if (act == ACT_EUTRAN)
+    {
+        selection.rat = NETWORK_RAT_LTE;
+    }
+    else if (act == ACT_GSM || act == ACT_GSM_COMPACT || act == ACT_EGPRS)
+    {
+        selection.rat = NETWORK_RAT_GSM;
+    }
+    else
+    {
+        return false;
+    }
+    memcpy(selection.plmn, quote - length, length);
+    selection.plmn[length] = '\0';
+    (void)mode;
+    return true;
+}
+
+bool network_parse_qnwinfo(const char *reply, NetworkSelection &selection)
+{
+    // +QNWINFO: "FDD LTE","63902","LTE BAND 3",1300 or +QNWINFO: "GSM","63902","GSM 900",62
+    const char *ptr = strstr(reply, "+QNWINFO:");
+    for (uint8_t field = 0; ptr && field < 5; field++)
+    {
+        ptr = strchr(ptr + 1, '"');
+    }
+    const char *end = ptr ? strchr(ptr + 1, '"') : nullptr;
+    if (!end)
+    {
+        return false;
+    }
+    ptr++;
+    const char *band = strstr(ptr, "BAND ");
+    if (band && band < end)
+    {
+        uint32_t number;
+        band += 5;
+        if (!parse_number(band, number) || number == 0 || number > 128)
+        {
+            return false;
+        }
+        selection.band = number;
+        return true;
+    }
+    for (uint8_t i = 0; i < sizeof(GSM_BANDS) / sizeof(GSM_BANDS[0]); i++)
+    {
+        const char *found = strstr(ptr, GSM_BANDS[i]);
+        if (found && found < end)
+        {
+            selection.band = i + 1;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief - copy a hex band mask up to the next separator
+ */
+static bool copy_mask(const char *&ptr, char *out)
+{
+    size_t length = strcspn(ptr, ",\r\n");
+    if (length < 3 || length > NETWORK_BAND_MASK_CHARS || ptr[0] != '0' || (ptr[1] != 'x' && ptr[1] != 'X'))
+    {
+        return false;
+    }
+    memcpy(out, ptr, length);
+    out[length] = '\0';
+    ptr += length;
+    return true;
+}
+
+bool network_parse_bands(const char *reply, NetworkBands &bands)
+{
+    const char *ptr = strstr(reply, "\"band\",");
+    if (!ptr)
+    {
+        return false;
+    }
+    ptr += 7;
+    NetworkBands parsed;
+    if (!copy_mask(ptr, parsed.gsm) || *ptr++ != ',' || !copy_mask(ptr, parsed.lte))
+    {
+        return false;
+    }
+    bands = parsed;
+    return true;
+}
+
+bool network_registered(const char *reply)
+{
+    static const char *const PREFIXES[] = {"+CREG:", "+CGREG:", "+CEREG:"};
+    for (const char *prefix : PREFIXES)
+    {
+        for (const char *ptr = strstr(reply, prefix); ptr; ptr = strstr(ptr, prefix))
+        {
+            ptr += strlen(prefix);
+            while (*ptr == ' ')
+            {
+                ptr++;
+            }
+            // A query answers <n>,<stat>; an unsolicited result starts with <stat>
+            uint32_t stat;
+            if (!parse_number(ptr, stat))
+            {
+                continue;
+            }
+            if (ptr[0] == ',' && ptr[1] >= '0' && ptr[1] <= '9')
+            {
+                ptr++;
+                parse_number(ptr, stat);
+            }
+            if (stat == 1 || stat == 5)
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void network_scan_mode_command(const NetworkSelection &selection, char *out, size_t size)
+{
+    snprintf(out, size, "AT+QCFG=\"nwscanmode\",%u,1", selection.rat == NETWORK_RAT_LTE ? SCAN_MODE_LTE : SCAN_MODE_GSM);
+}
+
+/**
+ * @brief - hex mask with only the bit of a band set, band 1 being bit 0
+ */
+static void band_mask(uint8_t band, char *out)
+{
+    uint8_t digits = (band - 1) / 4;
+    *out++ = '0';
+    *out++ = 'x';
+    *out++ = "1248"[(band - 1) % 4];
+    memset(out, '0', digits);
+    out[digits] = '\0';
+}
+
+void network_band_command(const NetworkSelection &selection, const NetworkBands &bands, char *out, size_t size)
+{
+    char mask[NETWORK_BAND_MASK_CHARS + 1];
+    if (!selection.band || !bands.gsm[0] || !bands.lte[0] || (selection.rat == NETWORK_RAT_GSM && selection.band > 4))
+    {
+        out[0] = '\0';
+        return;
+    }
+    band_mask(selection.band, mask);
+    // The other RAT is not scanned, so its bands stay as they were
+    snprintf(out, size, "AT+QCFG=\"band\",%s,%s,1", selection.rat == NETWORK_RAT_GSM ? mask : bands.gsm,
+             selection.rat == NETWORK_RAT_LTE ? mask : bands.lte);
+}
+
+void network_operator_command(const NetworkSelection &selection, char *out, size_t size)
+{
+    snprintf(out, size, "AT+COPS=4,2,\"%s\",%u", selection.plmn, selection.rat == NETWORK_RAT_LTE ? ACT_EUTRAN : ACT_GSM);
+}
+
+void network_full_band_command(const NetworkBands &bands, bool immediate, char *out, size_t size)
+{
+    if (!bands.gsm[0] || !bands.lte[0])
+    {
+        out[0] = '\0';
+        return;
+    }
+    snprintf(out, size, "AT+QCFG=\"band\",%s,%s,%u", bands.gsm, bands.lte, immediate ? 1 : 0);
+}
+
+void network_full_scan_mode_command(bool immediate, char *out, size_t size)
+{
+    snprintf(out, size, "AT+QCFG=\"nwscanmode\",%u,%u", SCAN_MODE_AUTO, immediate ? 1 : 0);
+}
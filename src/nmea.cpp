@@ -0,0 +1,251 @@
+/**
+ * @file nmea.cpp
+ * @brief Field-slicing NMEA parser, see nmea.h
+ */
+
+#include <string.h>
+#include "hot_path.h"
+#include "nmea.h"
+
+/**
+ * @return true if the field has no content
+ */
+static inline bool field_empty(const char *const *fields, uint8_t count, uint8_t index)
+{
+    return index >= count || *fields[index] == ',' || *fields[index] == '*';
+}
+
+static inline int8_t hex_digit(char c)
+{
+    if (c >= '0' && c <= '9')
+    {
+        return c - '0';
+    }
+    if (c >= 'A' && c <= 'F')
+    {
+        return c - 'A' + 10;
+    }
+    if (c >= 'a' && c <= 'f')
+    {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+static inline bool is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+static HOT_PATH uint32_t parse_uint(const char *ptr)
+{
+    uint32_t value = 0;
+    for (; is_digit(*ptr); ptr++)
+    {
+        value = value * 10 + (*ptr - '0');
+    }
+    return value;
+}
+
+/**
+ * @brief - decimal to x100, truncating further digits as TinyGPSPlus does
+ */
+static HOT_PATH int32_t parse_x100(const char *ptr)
+{
+    bool negative = *ptr == '-';
+    if (negative)
+    {
+        ptr++;
+    }
+    int32_t value = 100 * (int32_t)parse_uint(ptr);
+    while (is_digit(*ptr))
+    {
+        ptr++;
+    }
+    if (*ptr == '.' && is_digit(ptr[1]))
+    {
+        value += 10 * (ptr[1] - '0');
+        if (is_digit(ptr[2]))
+        {
+            value += ptr[2] - '0';
+        }
+    }
+    return negative ? -value : value;
+}
+
+/**
+ * @brief - unsigned (d)ddmm.mmmm to 1e-7 degrees, rounded as TinyGPSPlus RawDegrees
+ */
+static HOT_PATH int32_t parse_degrees_e7(const char *ptr)
+{
+    uint32_t whole = parse_uint(ptr);
+    uint32_t multiplier = 10000000UL;
+    uint32_t minutes_e7 = (whole % 100) * multiplier;
+    while (is_digit(*ptr))
+    {
+        ptr++;
+    }
+    if (*ptr == '.')
+    {
+        while (is_digit(*++ptr))
+        {
+            multiplier /= 10;
+            minutes_e7 += (*ptr - '0') * multiplier;
+        }
+    }
+    uint32_t billionths = (5 * minutes_e7 + 1) / 3;
+    return (int32_t)(whole / 100) * 10000000L + (int32_t)(billionths / 100);
+}
+
+NmeaParser::NmeaParser()
+    : _new_lat{0, false}, _new_lng{0, false}, _new_speed(0), _new_course(0), _lat_e7(0), _lng_e7(0),
+      _time(0), _date(0), _hdop(0), _speed(0), _course(0), _sats(0), _location_valid(false),
+      _time_valid(false), _date_valid(false), _passed(0), _failed(0)
+{
+}
+
+/**
+ * @brief - take latitude, N/S, longitude, E/W from fields[first] into the pending location
+ */
+HOT_PATH void NmeaParser::location(const char *const *fields, uint8_t count, uint8_t first)
+{
+    // As in TinyGPSPlus, a new coordinate resets its hemisphere until the N/S or E/W field
+    if (!field_empty(fields, count, first))
+    {
+        _new_lat.magnitude_e7 = parse_degrees_e7(fields[first]);
+        _new_lat.negative = false;
+    }
+    if (!field_empty(fields, count, first + 1))
+    {
+        _new_lat.negative = *fields[first + 1] == 'S';
+    }
+    if (!field_empty(fields, count, first + 2))
+    {
+        _new_lng.magnitude_e7 = parse_degrees_e7(fields[first + 2]);
+        _new_lng.negative = false;
+    }
+    if (!field_empty(fields, count, first + 3))
+    {
+        _new_lng.negative = *fields[first + 3] == 'W';
+    }
+}
+
+HOT_PATH void NmeaParser::commit_location()
+{
+    _lat_e7 = _new_lat.negative ? -_new_lat.magnitude_e7 : _new_lat.magnitude_e7;
+    _lng_e7 = _new_lng.negative ? -_new_lng.magnitude_e7 : _new_lng.magnitude_e7;
+    _location_valid = true;
+}
+
+/* $xxRMC,time,status,lat,N/S,lon,E/W,speed,course,date,... */
+HOT_PATH void NmeaParser::rmc(const char *const *fields, uint8_t count)
+{
+    if (!field_empty(fields, count, 1))
+    {
+        _time = (uint32_t)parse_x100(fields[1]);
+        _time_valid = true;
+    }
+    if (!field_empty(fields, count, 9))
+    {
+        _date = parse_uint(fields[9]);
+        _date_valid = true;
+    }
+    location(fields, count, 3);
+    if (!field_empty(fields, count, 7))
+    {
+        _new_speed = parse_x100(fields[7]);
+    }
+    if (!field_empty(fields, count, 8))
+    {
+        _new_course = parse_x100(fields[8]);
+    }
+    if (!field_empty(fields, count, 2) && *fields[2] == 'A')
+    {
+        commit_location();
+        _speed = _new_speed;
+        _course = _new_course;
+    }
+}
+
+/* $xxGGA,time,lat,N/S,lon,E/W,quality,sats,hdop,... */
+HOT_PATH void NmeaParser::gga(const char *const *fields, uint8_t count)
+{
+    if (!field_empty(fields, count, 1))
+    {
+        _time = (uint32_t)parse_x100(fields[1]);
+        _time_valid = true;
+    }
+    location(fields, count, 2);
+    if (!field_empty(fields, count, 6) && *fields[6] > '0')
+    {
+        commit_location();
+    }
+    if (!field_empty(fields, count, 7))
+    {
+        _sats = parse_uint(fields[7]);
+    }
+    if (!field_empty(fields, count, 8))
+    {
+        _hdop = parse_x100(fields[8]);
+    }
+}
+
+HOT_PATH bool NmeaParser::decode(const char *burst, GpsFix &fix)
+{
+    const char *fields[NMEA_MAX_FIELDS];
+    for (const char *ptr = burst; (ptr = strchr(ptr, '$'));)
+    {
+        // One pass checksums the sentence and records where each field starts
+        uint8_t parity = 0;
+        uint8_t count = 1;
+        fields[0] = ++ptr;
+        for (; *ptr && *ptr != '*' && *ptr != '$' && *ptr != '\r' && *ptr != '\n'; ptr++)
+        {
+            parity ^= *ptr;
+            if (*ptr == ',' && count < NMEA_MAX_FIELDS)
+            {
+                fields[count++] = ptr + 1;
+            }
+        }
+        if (*ptr != '*')
+        {
+            continue; // cut off by the end of the read
+        }
+        int8_t high = hex_digit(ptr[1]);
+        int8_t low = high < 0 ? -1 : hex_digit(ptr[2]);
+        if (low < 0 || ((high << 4) | low) != parity)
+        {
+            _failed++;
+            continue;
+        }
+        _passed++;
+
+        const char *type = fields[0];
+        if (count < 2 || fields[1] - type != 6)
+        {
+            continue; // not a two-letter talker and three-letter type
+        }
+        if (type[2] == 'R' && type[3] == 'M' && type[4] == 'C')
+        {
+            rmc(fields, count);
+        }
+        else if (type[2] == 'G' && type[3] == 'G' && type[4] == 'A')
+        {
+            gga(fields, count);
+        }
+    }
+
+    fix.lat_e7 = _lat_e7;
+    fix.lng_e7 = _lng_e7;
+    fix.utc = 0;
+    if (_time_valid && _date_valid)
+    {
+        fix.utc = utc_from_civil(_date % 100 + 2000, (_date / 100) % 100, _date / 10000,
+                                 _time / 1000000, (_time / 10000) % 100, (_time / 100) % 100);
+    }
+    fix.hdop = _hdop;
+    fix.sats = _sats;
+    fix.speed = _speed;
+    fix.course = _course;
+    return _location_valid;
+}
@@ -0,0 +1,61 @@
+/**
+ * @file nmea_reader.cpp
+ * @brief Non-blocking burst assembly, see nmea_reader.h
+ */
+
+#include "hot_path.h"
+#include "nmea_reader.h"
+
+NmeaReader::NmeaReader(char *buffer, size_t size)
+    : _buffer(buffer), _size(size), _length(0), _fresh(0), _started_ms(0), _drained_ms(0), _complete(false), _bursts(0), _cut(0)
+{
+    _buffer[0] = '\0';
+}
+
+HOT_PATH bool NmeaReader::poll(Stream &port, uint32_t now_ms)
+{
+    _fresh = _length;
+    if (_complete)
+    {
+        return true;
+    }
+    while (_length < _size - 1 && port.available() > 0)
+    {
+        int c = port.read();
+        if (c < 0)
+        {
+            break;
+        }
+        if (_length == 0)
+        {
+            _started_ms = now_ms;
+        }
+        _buffer[_length++] = (char)c;
+    }
+    _buffer[_length] = '\0';
+    if (_length > _fresh)
+    {
+        _drained_ms = now_ms;
+        if (_length == _size - 1)
+        {
+            _cut++;
+            _complete = true;
+        }
+    }
+    else if (_length && now_ms - _drained_ms >= NMEA_BURST_GAP_MS)
+    {
+        _complete = true;
+    }
+    if (_complete)
+    {
+        _bursts++;
+    }
+    return _complete;
+}
+
+void NmeaReader::clear()
+{
+    _length = _fresh = 0;
+    _buffer[0] = '\0';
+    _complete = false;
+}
@@ -0,0 +1,155 @@
+/**
+ * @file response_cache.cpp
+ * @brief Rendered page cache, see response_cache.h
+ */
+
+#include <string.h>
+#include "events.h"
+#include "gzip.h"
+#include "response_cache.h"
+
+struct CacheEntry
+{
+    uint16_t offset; // of the page; the gzip copy follows it
+    uint16_t length;
+    uint16_t gzip_length; // 0 if there is no gzip copy
+    bool valid;
+    uint32_t version;
+    uint32_t miss_version; // version when the last miss sent the handler to render
+    uint32_t stored_at;
+};
+
+static uint8_t buffer[RESPONSE_CACHE_SIZE] __attribute__((aligned(4)));
+static CacheEntry entries[CACHED_ROUTES];
+static uint32_t version = 1;
+static ResponseCacheStats stats = {};
+
+static uint32_t current_version()
+{
+    return __atomic_load_n(&version, __ATOMIC_ACQUIRE);
+}
+
+void response_cache_invalidate()
+{
+    __atomic_fetch_add(&version, 1, __ATOMIC_RELEASE);
+}
+
+static void on_fix(const FixEvent &event, void *ctx)
+{
+    (void)event;
+    (void)ctx;
+    response_cache_invalidate();
+}
+
+static void on_modem(const ModemEvent &event, void *ctx)
+{
+    (void)event;
+    (void)ctx;
+    response_cache_invalidate();
+}
+
+static void on_upload(const UploadEvent &event, void *ctx)
+{
+    (void)event;
+    (void)ctx;
+    response_cache_invalidate();
+}
+
+void response_cache_begin()
+{
+    memset(entries, 0, sizeof(entries));
+    fix_events.subscribe(on_fix);
+    modem_events.subscribe(on_modem);
+    upload_events.subscribe(on_upload);
+}
+
+bool response_cache_get(CachedRoute route, bool accept_gzip, uint32_t now, CachedResponse &out)
+{
+    CacheEntry &entry = entries[route];
+    uint32_t current = current_version();
+    if (!entry.valid || entry.version != current || now - entry.stored_at >= RESPONSE_CACHE_MAX_AGE_MS)
+    {
+        entry.valid = false;
+        entry.miss_version = current;
+        return false;
+    }
+    stats.hits++;
+    if (accept_gzip && entry.gzip_length)
+    {
+        stats.gzip_hits++;
+        stats.bytes_saved += entry.length - entry.gzip_length;
+        out.body = buffer + entry.offset + entry.length;
+        out.length = entry.gzip_length;
+        out.gzip = true;
+    }
+    else
+    {
+        out.body = buffer + entry.offset;
+        out.length = entry.length;
+        out.gzip = false;
+    }
+    return true;
+}
+
+/**
+ * @brief - move the entries still valid to the front of the buffer
+ * @return the end of them
+ */
+static size_t compact()
+{
+    size_t end = 0;
+    for (;;)
+    {
+        // Lowest valid entry not yet moved, so moves never overlap a later entry
+        CacheEntry *next = nullptr;
+        for (CacheEntry &entry : entries)
+        {
+            if (entry.valid && entry.offset >= end && (!next || entry.offset < next->offset))
+            {
+                next = &entry;
+            }
+        }
+        if (!next)
+        {
+            return end;
+        }
+        size_t size = next->length + next->gzip_length;
+        memmove(buffer + end, buffer + next->offset, size);
+        next->offset = (uint16_t)end;
+        end += (size + 3) & ~3u;
+    }
+}
+
+bool response_cache_put(CachedRoute route, const char *body, size_t length, uint32_t now)
+{
+    CacheEntry &entry = entries[route];
+    uint32_t current = current_version();
+    stats.renders++;
+    entry.valid = false;
+    for (CacheEntry &other : entries)
+    {
+        other.valid = other.valid && other.version == current;
+    }
+    size_t offset = compact();
+    // Rendered under a version that has moved on since: send it, but do not keep it
+    if (entry.miss_version != current || offset + length > RESPONSE_CACHE_SIZE)
+    {
+        return false;
+    }
+    memcpy(buffer + offset, body, length);
+    size_t gzip_length = gzip_compress(buffer + offset, length, buffer + offset + length, RESPONSE_CACHE_SIZE - offset - length);
+    entry.offset = (uint16_t)offset;
+    entry.length = (uint16_t)length;
+    entry.gzip_length = gzip_length < length ? (uint16_t)gzip_length : 0;
+    entry.version = current;
+    entry.stored_at = now;
+    entry.valid = true;
+    return true;
+}
+
+ResponseCacheStats response_cache_stats()
+{
+    ResponseCacheStats result = stats;
+    result.version = current_version();
+    return result;
+}
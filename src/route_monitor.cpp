@@ -0,0 +1,434 @@
+/**
+ * @file route_monitor.cpp
+ * @brief Planned-route corridor monitoring, see route_monitor.h
+ */
+
+#include <algorithm>
+#include <string.h>
+#include "crc.h"
+#include "events.h"
+#include "flash_layout.h"
+#include "geo_fixed.h"
+#include "route_monitor.h"
+
+#define ROUTE_MAGIC 0x31455452 // "RTE1"
+#define ROUTE_DATA_OFFSET sizeof(RouteHeader)
+#define ROUTE_MAX_ENCODED (ROUTE_SECTORS * FLASH_SECTOR_SIZE - ROUTE_DATA_OFFSET)
+#define ROUTE_MIN_CELL_M 100
+#define READ_CHUNK 64
+
+struct RouteHeader
+{
+    uint32_t magic; // written last
+    uint32_t length;
+    uint32_t crc;
+    uint16_t corridor_m;
+    uint16_t reserved;
+};
+
+/**
+ * @brief Incremental decoder for the encoded polyline format
+ */
+struct PolylineDecoder
+{
+    int32_t lat_e5;
+    int32_t lng_e5;
+    uint32_t value;
+    uint8_t shift;
+    bool have_lat;
+
+    void reset() { memset(this, 0, sizeof(*this)); }
+
+    /**
+     * @brief - consume one character
+     * @return 1 when a point is complete, 0 if more input is needed, -1 on invalid input
+     */
+    int feed(char c)
+    {
+        if (c < 63 || c > 126 || shift > 30)
+        {
+            return -1;
+        }
+        uint8_t chunk = c - 63;
+        value |= (uint32_t)(chunk & 0x1F) << shift;
+        shift += 5;
+        if (chunk & 0x20)
+        {
+            return 0;
+        }
+        int32_t delta = (value & 1) ? ~(int32_t)(value >> 1) : (int32_t)(value >> 1);
+        value = 0;
+        shift = 0;
+        if (!have_lat)
+        {
+            lat_e5 += delta;
+            have_lat = true;
+            return 0;
+        }
+        lng_e5 += delta;
+        have_lat = false;
+        return 1;
+    }
+};
+
+/* Route geometry, in decimetres east/north of the first point */
+static int32_t point_x[ROUTE_MAX_POINTS];
+static int32_t point_y[ROUTE_MAX_POINTS];
+static uint32_t cumulative_m[ROUTE_MAX_POINTS]; // distance from the start to each point
+static uint16_t point_count = 0;
+static GeoProjection projection;
+
+/* Grid index: segments overlapping each cell, in compressed row form */
+static int32_t grid_min_x, grid_min_y;
+static int32_t cell_size_dm;
+static int32_t grid_cols, grid_rows;
+static uint16_t cell_start[ROUTE_MAX_CELLS + 1];
+static uint16_t cell_segments[ROUTE_MAX_CELL_ENTRIES];
+
+static RouteStatus status = {};
+static uint8_t outside_fixes = 0;
+
+static void add_point(int32_t lat_e7, int32_t lng_e7)
+{
+    if (point_count == 0)
+    {
+        geo_projection_init(projection, lat_e7, lng_e7);
+    }
+    geo_project_dm(projection, lat_e7, lng_e7, point_x[point_count], point_y[point_count]);
+    cumulative_m[point_count] = 0;
+    if (point_count > 0)
+    {
+        int64_t dx = point_x[point_count] - point_x[point_count - 1];
+        int64_t dy = point_y[point_count] - point_y[point_count - 1];
+        cumulative_m[point_count] = cumulative_m[point_count - 1] + (geo_isqrt64(dx * dx + dy * dy) + 5) / 10;
+    }
+    point_count++;
+}
+
+/**
+ * @brief - add (or, with fill, count) the segments overlapping each cell
+ * @return number of entries, or -1 if they do not fit
+ */
+static int32_t index_segments(bool fill)
+{
+    int32_t entries = 0;
+    int32_t margin = status.corridor_m * 10;
+    for (uint16_t seg = 0; seg + 1 < point_count; seg++)
+    {
+        int32_t x0 = std::min(point_x[seg], point_x[seg + 1]) - margin - grid_min_x;
+        int32_t x1 = std::max(point_x[seg], point_x[seg + 1]) + margin - grid_min_x;
+        int32_t y0 = std::min(point_y[seg], point_y[seg + 1]) - margin - grid_min_y;
+        int32_t y1 = std::max(point_y[seg], point_y[seg + 1]) + margin - grid_min_y;
+        for (int32_t row = std::max(y0, (int32_t)0) / cell_size_dm; row <= y1 / cell_size_dm && row < grid_rows; row++)
+        {
+            for (int32_t col = std::max(x0, (int32_t)0) / cell_size_dm; col <= x1 / cell_size_dm && col < grid_cols; col++)
+            {
+                uint16_t cell = row * grid_cols + col;
+                if (fill)
+                {
+                    cell_segments[cell_start[cell + 1]++] = seg;
+                }
+                else
+                {
+                    cell_start[cell + 1]++;
+                }
+                entries++;
+            }
+        }
+    }
+    return entries <= ROUTE_MAX_CELL_ENTRIES ? entries : -1;
+}
+
+static bool build_index()
+{
+    int32_t margin = status.corridor_m * 10;
+    int32_t min_x = point_x[0], max_x = point_x[0], min_y = point_y[0], max_y = point_y[0];
+    for (uint16_t i = 1; i < point_count; i++)
+    {
+        min_x = std::min(min_x, point_x[i]);
+        max_x = std::max(max_x, point_x[i]);
+        min_y = std::min(min_y, point_y[i]);
+        max_y = std::max(max_y, point_y[i]);
+    }
+    grid_min_x = min_x - margin;
+    grid_min_y = min_y - margin;
+    uint32_t width = max_x - min_x + 2 * margin + 1;
+    uint32_t height = max_y - min_y + 2 * margin + 1;
+
+    for (cell_size_dm = ROUTE_MIN_CELL_M * 10;; cell_size_dm *= 2)
+    {
+        uint32_t cols = (width + cell_size_dm - 1) / cell_size_dm;
+        uint32_t rows = (height + cell_size_dm - 1) / cell_size_dm;
+        if (cols * rows > ROUTE_MAX_CELLS)
+        {
+            continue;
+        }
+        grid_cols = cols;
+        grid_rows = rows;
+        memset(cell_start, 0, sizeof(cell_start));
+        if (index_segments(false) < 0)
+        {
+            if (cols * rows == 1)
+            {
+                return false;
+            }
+            continue;
+        }
+        for (uint16_t cell = 0; cell < cols * rows; cell++)
+        {
+            cell_start[cell + 1] += cell_start[cell];
+        }
+        // Shift the starts up one slot; filling moves each back to its cell's end, which leaves
+        // cell_start[c]..cell_start[c + 1] as the range of cell c
+        memmove(cell_start + 1, cell_start, cols * rows * sizeof(cell_start[0]));
+        cell_start[0] = 0;
+        index_segments(true);
+        return true;
+    }
+}
+
+/**
+ * @brief - distance from a point to a segment
+ * @param t: set to the position of the closest point along the segment, Q16 (0..65536)
+ * @param cross_track: set to the signed distance, positive on the right
+ * @return absolute distance in decimetres
+ */
+static uint32_t segment_distance(uint16_t seg, int32_t x, int32_t y, int32_t &t, int32_t &cross_track)
+{
+    int64_t dx = (int64_t)point_x[seg + 1] - point_x[seg], dy = (int64_t)point_y[seg + 1] - point_y[seg];
+    int64_t px = (int64_t)x - point_x[seg], py = (int64_t)y - point_y[seg];
+    int64_t length2 = dx * dx + dy * dy;
+    int64_t dot = px * dx + py * dy;
+    t = dot <= 0 || length2 == 0 ? 0 : (dot >= length2 ? 1 << 16 : (int32_t)((dot << 16) / length2));
+    int64_t ex = px - ((t * dx) >> 16), ey = py - ((t * dy) >> 16);
+    uint32_t distance = geo_isqrt64((uint64_t)(ex * ex + ey * ey));
+    cross_track = (dx * py - dy * px) > 0 ? -(int32_t)distance : (int32_t)distance;
+    return distance;
+}
+
+static int32_t floor_div(int32_t value, int32_t divisor)
+{
+    return value >= 0 ? value / divisor : -((-value + divisor - 1) / divisor);
+}
+
+struct Match
+{
+    uint16_t segment;
+    uint32_t distance; // decimetres
+    int32_t t;         // Q16
+    int32_t cross_track;
+};
+
+static void match_range(uint16_t first, uint16_t last, int32_t x, int32_t y, Match &best)
+{
+    for (uint16_t seg = first; seg <= last; seg++)
+    {
+        int32_t t, cross_track;
+        uint32_t distance = segment_distance(seg, x, y, t, cross_track);
+        if (distance < best.distance)
+        {
+            best = {seg, distance, t, cross_track};
+        }
+    }
+}
+
+static void publish(RouteEventType type, uint32_t utc)
+{
+    RouteEvent event = {type, status.segment, status.cross_track_m, status.progress_m, utc};
+    route_events.publish(event);
+}
+
+static void on_fix(const FixEvent &event, void *ctx)
+{
+    (void)ctx;
+    if (!status.loaded)
+    {
+        return;
+    }
+    int32_t x, y;
+    geo_project_dm(projection, event.fix.lat_e7, event.fix.lng_e7, x, y);
+    uint32_t corridor_dm = status.corridor_m * 10UL;
+    uint16_t last_segment = point_count - 2;
+
+    Match best = {0, UINT32_MAX, 0, 0};
+    uint16_t first = status.segment > ROUTE_CURSOR_WINDOW ? status.segment - ROUTE_CURSOR_WINDOW : 0;
+    uint16_t last = std::min((uint16_t)(status.segment + ROUTE_CURSOR_WINDOW), last_segment);
+    match_range(first, last, x, y, best);
+    if (best.distance <= corridor_dm)
+    {
+        status.cursor_hits++;
+    }
+    else
+    {
+        status.index_lookups++;
+        // The fix's cell and its neighbours, so a nearest segment just off the corridor is found too
+        int32_t col = floor_div(x - grid_min_x, cell_size_dm);
+        int32_t row = floor_div(y - grid_min_y, cell_size_dm);
+        for (int32_t r = std::max(row - 1, (int32_t)0); r <= std::min(row + 1, grid_rows - 1); r++)
+        {
+            for (int32_t c = std::max(col - 1, (int32_t)0); c <= std::min(col + 1, grid_cols - 1); c++)
+            {
+                uint16_t cell = r * grid_cols + c;
+                for (uint16_t i = cell_start[cell]; i < cell_start[cell + 1]; i++)
+                {
+                    match_range(cell_segments[i], cell_segments[i], x, y, best);
+                }
+            }
+        }
+    }
+
+    status.segment = best.segment;
+    status.cross_track_m = (best.cross_track + (best.cross_track < 0 ? -5 : 5)) / 10;
+    uint32_t segment_length = cumulative_m[best.segment + 1] - cumulative_m[best.segment];
+    status.progress_m = cumulative_m[best.segment] + (uint32_t)(((uint64_t)best.t * segment_length + 0x8000) >> 16);
+
+    if (status.on_route)
+    {
+        outside_fixes = best.distance > corridor_dm ? outside_fixes + 1 : 0;
+        if (outside_fixes >= ROUTE_DEVIATE_FIXES)
+        {
+            status.on_route = false;
+            publish(ROUTE_DEVIATED, event.fix.utc);
+        }
+    }
+    else if (best.distance <= corridor_dm * ROUTE_RETURN_PERCENT / 100)
+    {
+        status.on_route = true;
+        outside_fixes = 0;
+        publish(ROUTE_RETURNED, event.fix.utc);
+    }
+}
+
+/**
+ * @brief - decode a polyline into the route, reading it from flash in chunks
+ */
+static bool load_from_flash(const RouteHeader &header)
+{
+    PolylineDecoder decoder;
+    decoder.reset();
+    point_count = 0;
+    uint32_t crc = 0;
+    char chunk[READ_CHUNK] __attribute__((aligned(4)));
+    for (uint32_t offset = 0; offset < header.length; offset += READ_CHUNK)
+    {
+        uint32_t length = std::min((uint32_t)READ_CHUNK, header.length - offset);
+        if (!flash_read(ROUTE_FIRST_SECTOR * FLASH_SECTOR_SIZE + ROUTE_DATA_OFFSET + offset, chunk, READ_CHUNK))
+        {
+            return false;
+        }
+        crc = crc32_update(crc, chunk, length);
+        for (uint32_t i = 0; i < length; i++)
+        {
+            int result = decoder.feed(chunk[i]);
+            if (result < 0 || (result == 1 && point_count == ROUTE_MAX_POINTS))
+            {
+                return false;
+            }
+            if (result == 1)
+            {
+                add_point(decoder.lat_e5 * 100, decoder.lng_e5 * 100);
+            }
+        }
+    }
+    return crc == header.crc && decoder.shift == 0 && !decoder.have_lat && point_count >= 2;
+}
+
+static bool load_route()
+{
+    memset(&status, 0, sizeof(status));
+    status.on_route = true;
+    outside_fixes = 0;
+    RouteHeader header;
+    if (!flash_read(ROUTE_FIRST_SECTOR * FLASH_SECTOR_SIZE, &header, sizeof(header)) ||
+        header.magic != ROUTE_MAGIC || header.length > ROUTE_MAX_ENCODED)
+    {
+        return false;
+    }
+    status.corridor_m = header.corridor_m;
+    if (!load_from_flash(header) || !build_index())
+    {
+        point_count = 0;
+        return false;
+    }
+    status.loaded = true;
+    status.points = point_count;
+    status.length_m = cumulative_m[point_count - 1];
+    return true;
+}
+
+void route_begin()
+{
+    load_route();
+    fix_events.subscribe(on_fix);
+}
+
+static bool validate(const char *polyline, size_t length)
+{
+    PolylineDecoder decoder;
+    decoder.reset();
+    size_t points = 0;
+    for (size_t i = 0; i < length; i++)
+    {
+        int result = decoder.feed(polyline[i]);
+        if (result < 0)
+        {
+            return false;
+        }
+        points += result;
+    }
+    return decoder.shift == 0 && !decoder.have_lat && points >= 2 && points <= ROUTE_MAX_POINTS;
+}
+
+static bool erase_route()
+{
+    for (uint8_t i = 0; i < ROUTE_SECTORS; i++)
+    {
+        if (!flash_erase_sector(ROUTE_FIRST_SECTOR + i))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool route_set(const char *polyline, size_t length, uint16_t corridor_m)
+{
+    if (length > ROUTE_MAX_ENCODED || !validate(polyline, length) || !erase_route())
+    {
+        return false;
+    }
+    // Flash writes are whole words; stage the tail through a padded buffer
+    uint32_t base = ROUTE_FIRST_SECTOR * FLASH_SECTOR_SIZE + ROUTE_DATA_OFFSET;
+    size_t aligned = length & ~3u;
+    if (aligned && !flash_write(base, polyline, aligned))
+    {
+        return false;
+    }
+    if (aligned < length)
+    {
+        uint8_t tail[4] = {0xFF, 0xFF, 0xFF, 0xFF};
+        memcpy(tail, polyline + aligned, length - aligned);
+        if (!flash_write(base + aligned, tail, sizeof(tail)))
+        {
+            return false;
+        }
+    }
+    RouteHeader header = {0xFFFFFFFF, (uint32_t)length, crc32_update(0, polyline, length), corridor_m, 0xFFFF};
+    if (!flash_write(ROUTE_FIRST_SECTOR * FLASH_SECTOR_SIZE, &header, sizeof(header)))
+    {
+        return false;
+    }
+    uint32_t magic = ROUTE_MAGIC;
+    return flash_write(ROUTE_FIRST_SECTOR * FLASH_SECTOR_SIZE, &magic, sizeof(magic)) && load_route();
+}
+
+void route_clear()
+{
+    erase_route();
+    load_route();
+}
+
+RouteStatus route_status()
+{
+    return status;
+}
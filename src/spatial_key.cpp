@@ -0,0 +1,195 @@
+/**
+ * @file spatial_key.cpp
+ * @brief Geohash and Hilbert-curve cell keys, see spatial_key.h
+ */
+
+#include "spatial_key.h"
+
+#define LAT_OFFSET_E7 900000000L
+#define LNG_OFFSET_E7 1800000000L
+#define LAT_RANGE_E7 1800000000ULL
+#define LNG_RANGE_E7 3600000000ULL
+#define E7_TO_FRACTION 2562047788ULL // 2^62 / 1.8e9, and 2^63 / 3.6e9
+
+static const char GEOHASH_ALPHABET[] = "0123456789bcdefghjkmnpqrstuvwxyz";
+
+/**
+ * @brief - floor(offset * 2^32 / range) for offset < range, with a multiply instead of a divide
+ * @param shift: 30 for the latitude range, 31 for the longitude range
+ */
+static uint32_t range_fraction(uint64_t offset, uint64_t range, uint8_t shift)
+{
+    // The truncated reciprocal can come out one short; one check makes the result exact
+    uint32_t fraction = (uint32_t)((offset * E7_TO_FRACTION) >> shift);
+    if (fraction != 0xFFFFFFFF && ((uint64_t)fraction + 1) * range <= offset << 32)
+    {
+        fraction++;
+    }
+    return fraction;
+}
+
+/* Latitude and longitude as fractions of their range, 0..2^32 - 1 */
+static uint32_t lat_fraction(int32_t lat_e7)
+{
+    return range_fraction((uint32_t)(lat_e7 + LAT_OFFSET_E7), LAT_RANGE_E7, 30);
+}
+
+static uint32_t lng_fraction(int32_t lng_e7)
+{
+    return range_fraction((uint64_t)((int64_t)lng_e7 + LNG_OFFSET_E7), LNG_RANGE_E7, 31);
+}
+
+/**
+ * @brief - move the bits of a 32-bit value to the even bit positions of a 64-bit one
+ */
+static uint64_t spread32(uint32_t value)
+{
+    uint64_t x = value;
+    x = (x | (x << 16)) & 0x0000FFFF0000FFFFULL;
+    x = (x | (x << 8)) & 0x00FF00FF00FF00FFULL;
+    x = (x | (x << 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    x = (x | (x << 2)) & 0x3333333333333333ULL;
+    x = (x | (x << 1)) & 0x5555555555555555ULL;
+    return x;
+}
+
+static uint32_t spread16(uint32_t x)
+{
+    x = (x | (x << 8)) & 0x00FF00FF;
+    x = (x | (x << 4)) & 0x0F0F0F0F;
+    x = (x | (x << 2)) & 0x33333333;
+    x = (x | (x << 1)) & 0x55555555;
+    return x;
+}
+
+uint64_t geohash_bits(int32_t lat_e7, int32_t lng_e7)
+{
+    return (spread32(lng_fraction(lng_e7)) << 1) | spread32(lat_fraction(lat_e7));
+}
+
+void geohash_encode(int32_t lat_e7, int32_t lng_e7, uint8_t chars, char *out)
+{
+    if (chars > GEOHASH_MAX_CHARS)
+    {
+        chars = GEOHASH_MAX_CHARS;
+    }
+    uint64_t bits = geohash_bits(lat_e7, lng_e7);
+    for (uint8_t i = 0; i < chars; i++)
+    {
+        out[i] = GEOHASH_ALPHABET[(bits >> (59 - 5 * i)) & 0x1F];
+    }
+    out[chars] = '\0';
+}
+
+/**
+ * @brief - Hilbert index of a point on a 65536 x 65536 grid
+ *
+ * The curve's orientation at each level depends on all the quadrants above it. Rather than
+ * walking the levels one at a time, the orientation changes are expressed as a pair of 2x2
+ * boolean transforms per bit and combined with a parallel prefix scan: four rounds of shifts
+ * by 1, 2, 4 and 8 cover all 16 levels.
+ */
+static uint32_t hilbert_index16(uint32_t x, uint32_t y)
+{
+    uint32_t A, B, C, D;
+    {
+        uint32_t a = x ^ y;
+        uint32_t b = 0xFFFF ^ a;
+        uint32_t c = 0xFFFF ^ (x | y);
+        uint32_t d = x & (y ^ 0xFFFF);
+        A = a | (b >> 1);
+        B = (a >> 1) ^ a;
+        C = ((c >> 1) ^ (b & (d >> 1))) ^ c;
+        D = ((a & (c >> 1)) ^ (d >> 1)) ^ d;
+    }
+    {
+        uint32_t a = A, b = B, c = C, d = D;
+        A = (a & (a >> 2)) ^ (b & (b >> 2));
+        B = (a & (b >> 2)) ^ (b & ((a ^ b) >> 2));
+        C ^= (a & (c >> 2)) ^ (b & (d >> 2));
+        D ^= (b & (c >> 2)) ^ ((a ^ b) & (d >> 2));
+    }
+    {
+        uint32_t a = A, b = B, c = C, d = D;
+        A = (a & (a >> 4)) ^ (b & (b >> 4));
+        B = (a & (b >> 4)) ^ (b & ((a ^ b) >> 4));
+        C ^= (a & (c >> 4)) ^ (b & (d >> 4));
+        D ^= (b & (c >> 4)) ^ ((a ^ b) & (d >> 4));
+    }
+    {
+        uint32_t a = A, b = B, c = C, d = D;
+        C ^= (a & (c >> 8)) ^ (b & (d >> 8));
+        D ^= (b & (c >> 8)) ^ ((a ^ b) & (d >> 8));
+    }
+    uint32_t a = C ^ (C >> 1);
+    uint32_t b = D ^ (D >> 1);
+    uint32_t i0 = x ^ y;
+    uint32_t i1 = b | (0xFFFF ^ (i0 | a));
+    return (spread16(i1) << 1) | spread16(i0);
+}
+
+uint32_t hilbert_key(int32_t lat_e7, int32_t lng_e7, uint8_t order)
+{
+    if (order == 0 || order > HILBERT_MAX_ORDER)
+    {
+        order = HILBERT_MAX_ORDER;
+    }
+    // Truncating the full-resolution index gives the index of the enclosing coarser cell
+    uint32_t index = hilbert_index16(lng_fraction(lng_e7) >> 16, lat_fraction(lat_e7) >> 16);
+    return index >> (2 * (HILBERT_MAX_ORDER - order));
+}
+
+uint64_t geohash_bits_bisect(int32_t lat_e7, int32_t lng_e7)
+{
+    // Bisect in units of 2^-32 of a 1e-7 degree so every midpoint is exact
+    uint64_t lat = (uint64_t)(uint32_t)(lat_e7 + LAT_OFFSET_E7) << 32;
+    uint64_t lng = (uint64_t)((int64_t)lng_e7 + LNG_OFFSET_E7) << 32;
+    uint64_t lat_low = 0, lat_span = LAT_RANGE_E7 << 32;
+    uint64_t lng_low = 0, lng_span = LNG_RANGE_E7 << 32;
+    uint64_t bits = 0;
+    for (uint8_t i = 0; i < 64; i++)
+    {
+        uint64_t &value = (i & 1) ? lat : lng;
+        uint64_t &low = (i & 1) ? lat_low : lng_low;
+        uint64_t &span = (i & 1) ? lat_span : lng_span;
+        span >>= 1;
+        bits <<= 1;
+        if (value >= low + span)
+        {
+            bits |= 1;
+            low += span;
+        }
+    }
+    return bits;
+}
+
+uint32_t hilbert_key_iterative(int32_t lat_e7, int32_t lng_e7, uint8_t order)
+{
+    if (order == 0 || order > HILBERT_MAX_ORDER)
+    {
+        order = HILBERT_MAX_ORDER;
+    }
+    uint32_t x = lng_fraction(lng_e7) >> (32 - order);
+    uint32_t y = lat_fraction(lat_e7) >> (32 - order);
+    uint32_t n = 1UL << order;
+    uint32_t index = 0;
+    for (uint32_t s = n >> 1; s > 0; s >>= 1)
+    {
+        uint32_t rx = (x & s) > 0;
+        uint32_t ry = (y & s) > 0;
+        index += s * s * ((3 * rx) ^ ry);
+        // Rotate the quadrant so the sub-curve starts where the parent curve enters it
+        if (ry == 0)
+        {
+            if (rx == 1)
+            {
+                x = n - 1 - x;
+                y = n - 1 - y;
+            }
+            uint32_t t = x;
+            x = y;
+            y = t;
+        }
+    }
+    return index;
+}
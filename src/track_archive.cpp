@@ -0,0 +1,1106 @@
+/**
+ * @file track_archive.cpp
+ * @brief Compressed track history, see track_archive.h
+ */
+
+#include <string.h>
+#include "flash_blocks.h"
+#include "flash_layout.h"
+#include "track_archive.h"
+
+#define ARCHIVE_MAGIC 0x31524B54 // "TKR1"
+#define JOURNAL_MAGIC 0x314A4B54 // "TKJ1"
+
+#define MAX_POINT_SIZE 19 // tag, two coordinates and a long quality field, all at full width
+#define MAX_TIME_STEP (1L << 27) // larger interval changes start a new block
+#define MAX_BLOCK_RECORDS 255
+
+#define TAG_QUALITY 0x01
+#define TAG_MOVED 0x02
+#define TAG_PREDICTED 0x04
+#define TAG_BITS 3
+#define QUALITY_LONG 0x80
+
+#define LEVEL_RESERVED 0xFF // sector_level of a sector thinning is writing into
+#define MAX_THIN_OUTPUTS 3  // sectors one source may spill into before thinning gives up on it
+
+struct BlockHeader
+{
+    uint32_t magic;    // ARCHIVE_MAGIC, or JOURNAL_MAGIC in the journal
+    uint32_t sequence; // of the head sector, increasing around the ring
+    uint32_t first_utc;
+    uint32_t last_utc;
+    int32_t lat_e7;
+    int32_t lng_e7;
+    uint16_t hdop;
+    uint8_t sats;
+    uint8_t flags;
+    uint16_t length; // payload bytes after the header
+    uint8_t count;   // records, the one in the header included
+    uint8_t level;   // thinning passes applied, inverted so 0xFF is none as in older blocks
+    uint32_t crc; // over the header from sequence to level, and the payload
+};
+
+#define PAYLOAD_MAX (ARCHIVE_BLOCK_SIZE - sizeof(BlockHeader))
+
+static_assert(offsetof(BlockHeader, crc) + sizeof(uint32_t) == sizeof(BlockHeader), "the CRC ends the header");
+
+static const FlashBlockLayout BLOCKS = {ARCHIVE_MAGIC, sizeof(BlockHeader), offsetof(BlockHeader, length)};
+static const FlashBlockLayout JOURNAL = {JOURNAL_MAGIC, sizeof(BlockHeader), offsetof(BlockHeader, length)};
+static const FlashBlockLayout UNCOMMITTED = {FLASH_MAGIC_ERASED, sizeof(BlockHeader), offsetof(BlockHeader, length)};
+
+/**
+ * @brief Running state shared by the block encoder and decoder
+ */
+struct BlockCodec
+{
+    FixRecord last;
+    int32_t interval;
+    int32_t dlat;
+    int32_t dlng;
+
+    void start(const FixRecord &first)
+    {
+        last = first;
+        interval = 0;
+        dlat = 0;
+        dlng = 0;
+    }
+};
+
+/**
+ * @brief A block being filled in RAM
+ */
+struct BlockBuffer
+{
+    uint8_t bytes[ARCHIVE_BLOCK_SIZE] __attribute__((aligned(4)));
+    BlockCodec codec;
+
+    BlockHeader &header() { return *(BlockHeader *)bytes; }
+    uint8_t *payload() { return bytes + sizeof(BlockHeader); }
+};
+
+/**
+ * @brief Blocks, fixes and flash of one sector, from its headers
+ */
+struct SectorTotals
+{
+    uint32_t records;
+    uint32_t blocks;
+    uint32_t bytes;
+    uint32_t last_utc;
+};
+
+enum ThinStep : uint8_t
+{
+    THIN_IDLE,
+    THIN_READ,   // one source block per step, thinned into blocks written without their magic
+    THIN_COMMIT, // the thinned blocks made valid and the source retired
+};
+
+/**
+ * @brief Decimation of one source sector into the sector before it in time
+ *
+ * A fix is decided once the next one is known, so the fixes either side of a stop, a start
+ * or a gap can be kept.
+ */
+struct Thinning
+{
+    ThinStep step;
+    uint8_t level; // of the output
+    uint16_t source;
+    uint32_t offset; // of the next source block
+    SectorTotals removed;
+    uint16_t outputs[MAX_THIN_OUTPUTS];
+    uint8_t output_count;
+    uint32_t output_offset; // next write position in the last output
+    uint32_t commit_offset; // where this source's blocks start in the first output
+    FixRecord before;       // the fix preceding held
+    FixRecord held;         // not decided yet
+    bool has_before;
+    bool has_held;
+    bool held_first; // held is the first fix of the source
+    uint8_t since_kept;
+};
+
+static uint32_t sector_first_utc[ARCHIVE_SECTORS]; // 0 if the sector holds no blocks
+static uint8_t sector_level[ARCHIVE_SECTORS];
+static uint16_t by_time[ARCHIVE_SECTORS]; // sectors holding blocks, oldest first
+static uint16_t used_sectors = 0;
+static uint16_t head_sector = 0;
+static uint16_t next_free = 0; // where the search for a free sector starts
+static uint32_t head_sequence = 0;
+static uint32_t head_offset = FLASH_SECTOR_SIZE; // next write position in the head sector
+
+static BlockBuffer incoming; // fixes waiting for the head sector
+static BlockHeader &pending = incoming.header();
+static uint32_t unsaved_utc = 0; // first pending fix not yet journalled, 0 if none
+
+static uint16_t journal_sector = ARCHIVE_JOURNAL_SECTORS - 1;
+static uint32_t journal_offset = FLASH_SECTOR_SIZE; // next write position; full moves to the other sector
+static uint32_t journal_sequence = 0;
+
+static Thinning thin = {};
+static BlockBuffer thinned;
+
+static ArchiveStats stats = {};
+
+static uint32_t sector_address(uint16_t sector)
+{
+    return (ARCHIVE_FIRST_SECTOR + sector) * FLASH_SECTOR_SIZE;
+}
+
+static uint32_t journal_address(uint16_t sector)
+{
+    return (ARCHIVE_JOURNAL_FIRST_SECTOR + sector) * FLASH_SECTOR_SIZE;
+}
+
+static uint32_t zigzag(int32_t value)
+{
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static int32_t unzigzag(uint32_t value)
+{
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+/**
+ * @brief - append a record to a block
+ * @return false if it does not fit and the block must be written first
+ */
+static bool encode(BlockBuffer &target, const FixRecord &record)
+{
+    BlockHeader &header = target.header();
+    BlockCodec &encoder = target.codec;
+    int32_t interval = (int32_t)(record.utc - encoder.last.utc);
+    int32_t step = interval - encoder.interval;
+    if (header.count == MAX_BLOCK_RECORDS || (size_t)header.length + MAX_POINT_SIZE > PAYLOAD_MAX ||
+        step >= MAX_TIME_STEP || step <= -MAX_TIME_STEP)
+    {
+        return false;
+    }
+    // Coordinate arithmetic wraps at 32 bits, which keeps longitude deltas across the
+    // antimeridian exact
+    int32_t dlat = (int32_t)((uint32_t)record.lat_e7 - (uint32_t)encoder.last.lat_e7);
+    int32_t dlng = (int32_t)((uint32_t)record.lng_e7 - (uint32_t)encoder.last.lng_e7);
+    int32_t rlat = (int32_t)((uint32_t)dlat - (uint32_t)encoder.dlat);
+    int32_t rlng = (int32_t)((uint32_t)dlng - (uint32_t)encoder.dlng);
+    bool predicted = varint_size(zigzag(rlat)) + varint_size(zigzag(rlng)) <
+                     varint_size(zigzag(dlat)) + varint_size(zigzag(dlng));
+    bool quality = record.hdop != encoder.last.hdop || record.sats != encoder.last.sats;
+
+    uint32_t tag = zigzag(step) << TAG_BITS;
+    tag |= predicted ? TAG_PREDICTED : 0;
+    tag |= (record.flags & FIX_FLAG_MOVED) ? TAG_MOVED : 0;
+    tag |= quality ? TAG_QUALITY : 0;
+
+    uint8_t *payload = target.payload();
+    uint8_t *out = put_varint(payload + header.length, tag);
+    out = put_varint(out, zigzag(predicted ? rlat : dlat));
+    out = put_varint(out, zigzag(predicted ? rlng : dlng));
+    if (quality)
+    {
+        // Small changes pack into one byte: 4 bits of HDOP change and 3 of satellite change
+        int32_t dhdop = (int32_t)record.hdop - encoder.last.hdop;
+        int32_t dsats = (int32_t)record.sats - encoder.last.sats;
+        if (dhdop >= -8 && dhdop < 8 && dsats >= -4 && dsats < 4)
+        {
+            *out++ = (uint8_t)(zigzag(dhdop) << 3 | zigzag(dsats));
+        }
+        else
+        {
+            *out++ = QUALITY_LONG | (record.sats < 0x7F ? record.sats : 0x7F);
+            out = put_varint(out, record.hdop);
+        }
+    }
+
+    header.length = out - payload;
+    header.count++;
+    header.last_utc = record.utc;
+    encoder.last = record;
+    encoder.last.sats = record.sats < 0x7F ? record.sats : 0x7F;
+    encoder.interval = interval;
+    encoder.dlat = dlat;
+    encoder.dlng = dlng;
+    return true;
+}
+
+/**
+ * @brief - decode one record after the first
+ * @return the position after it, or nullptr if the payload is malformed
+ */
+static const uint8_t *decode(const uint8_t *in, const uint8_t *end, BlockCodec &codec, FixRecord &record)
+{
+    uint32_t tag, lat, lng;
+    if (!(in = get_varint(in, end, tag)) || !(in = get_varint(in, end, lat)) || !(in = get_varint(in, end, lng)))
+    {
+        return nullptr;
+    }
+    codec.interval += unzigzag(tag >> TAG_BITS);
+    int32_t dlat = unzigzag(lat), dlng = unzigzag(lng);
+    if (tag & TAG_PREDICTED)
+    {
+        dlat = (int32_t)((uint32_t)dlat + (uint32_t)codec.dlat);
+        dlng = (int32_t)((uint32_t)dlng + (uint32_t)codec.dlng);
+    }
+    record = codec.last;
+    record.utc += codec.interval;
+    record.lat_e7 = (int32_t)((uint32_t)record.lat_e7 + (uint32_t)dlat);
+    record.lng_e7 = (int32_t)((uint32_t)record.lng_e7 + (uint32_t)dlng);
+    record.flags = (tag & TAG_MOVED) ? FIX_FLAG_MOVED : 0;
+    if (tag & TAG_QUALITY)
+    {
+        if (in == end)
+        {
+            return nullptr;
+        }
+        uint8_t packed = *in++;
+        if (packed & QUALITY_LONG)
+        {
+            uint32_t hdop;
+            if (!(in = get_varint(in, end, hdop)))
+            {
+                return nullptr;
+            }
+            record.sats = packed & 0x7F;
+            record.hdop = hdop;
+        }
+        else
+        {
+            record.hdop += unzigzag(packed >> 3);
+            record.sats += unzigzag(packed & 0x07);
+        }
+    }
+    codec.last = record;
+    codec.dlat = dlat;
+    codec.dlng = dlng;
+    return in;
+}
+
+static void start_block(BlockBuffer &target, const FixRecord &record, uint8_t level)
+{
+    BlockHeader &header = target.header();
+    memset(target.bytes, 0xFF, sizeof(target.bytes));
+    header.first_utc = record.utc;
+    header.last_utc = record.utc;
+    header.lat_e7 = record.lat_e7;
+    header.lng_e7 = record.lng_e7;
+    header.hdop = record.hdop;
+    header.sats = record.sats;
+    header.flags = record.flags;
+    header.length = 0;
+    header.count = 1;
+    header.level = (uint8_t)~level;
+    target.codec.start(record);
+}
+
+/**
+ * @return true if sector a sorts before sector b: older, or a thinned copy of the same start
+ */
+static bool sorts_before(uint16_t a, uint16_t b)
+{
+    return sector_first_utc[a] < sector_first_utc[b] ||
+           (sector_first_utc[a] == sector_first_utc[b] && sector_level[a] > sector_level[b]);
+}
+
+static void index_insert(uint16_t sector)
+{
+    uint16_t position = used_sectors;
+    while (position > 0 && sorts_before(sector, by_time[position - 1]))
+    {
+        by_time[position] = by_time[position - 1];
+        position--;
+    }
+    by_time[position] = sector;
+    used_sectors++;
+}
+
+static void index_remove(uint16_t sector)
+{
+    for (uint16_t i = 0; i < used_sectors; i++)
+    {
+        if (by_time[i] == sector)
+        {
+            memmove(&by_time[i], &by_time[i + 1], (used_sectors - i - 1) * sizeof(by_time[0]));
+            used_sectors--;
+            return;
+        }
+    }
+}
+
+static void scan_sector(uint16_t sector, SectorTotals &totals)
+{
+    BlockHeader header;
+    memset(&totals, 0, sizeof(totals));
+    for (uint32_t offset = 0, size; (size = flash_block_at(BLOCKS, sector_address(sector), offset, &header)); offset += size)
+    {
+        totals.records += header.count;
+        totals.blocks++;
+        totals.bytes += size;
+        totals.last_utc = header.last_utc;
+    }
+}
+
+static uint32_t sector_end(uint16_t sector)
+{
+    return flash_blocks_end(BLOCKS, sector_address(sector), nullptr);
+}
+
+static void remove_totals(const SectorTotals &totals)
+{
+    stats.records -= totals.records;
+    stats.blocks -= totals.blocks;
+    stats.stored_bytes -= totals.bytes;
+}
+
+/**
+ * @brief - take a sector out of the index and clear its first magic so it is free at boot;
+ * it is erased when next used
+ */
+static void retire_sector(uint16_t sector)
+{
+    uint32_t zero = 0;
+    flash_write(sector_address(sector), &zero, sizeof(zero));
+    index_remove(sector);
+    sector_first_utc[sector] = 0;
+    sector_level[sector] = 0;
+}
+
+static bool sector_free(uint16_t sector)
+{
+    return sector_first_utc[sector] == 0 && sector_level[sector] != LEVEL_RESERVED && sector != head_sector;
+}
+
+/**
+ * @return the next free sector round the ring from the last one taken, -1 if there is none
+ */
+static int16_t find_free_sector()
+{
+    for (uint16_t i = 0; i < ARCHIVE_SECTORS; i++)
+    {
+        uint16_t sector = (next_free + i) % ARCHIVE_SECTORS;
+        if (sector_free(sector))
+        {
+            return sector;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief - erase a free sector for writing and move the allocation past it, which spreads
+ * the erases over the ring
+ */
+static bool take_sector(uint16_t sector)
+{
+    next_free = (sector + 1) % ARCHIVE_SECTORS;
+    return flash_erase_sector(ARCHIVE_FIRST_SECTOR + sector);
+}
+
+static uint16_t free_sectors()
+{
+    uint16_t count = 0;
+    for (uint16_t sector = 0; sector < ARCHIVE_SECTORS; sector++)
+    {
+        count += sector_free(sector);
+    }
+    return count;
+}
+
+/**
+ * @brief - give up on the source being thinned; blocks written without their magic stay invisible
+ */
+static void abort_thinning()
+{
+    for (uint8_t i = 0; i < thin.output_count; i++)
+    {
+        if (sector_first_utc[thin.outputs[i]] == 0)
+        {
+            sector_level[thin.outputs[i]] = 0;
+        }
+    }
+    thin.step = THIN_IDLE;
+}
+
+static bool thinning_uses(uint16_t sector)
+{
+    if (thin.step == THIN_IDLE)
+    {
+        return false;
+    }
+    for (uint8_t i = 0; i < thin.output_count; i++)
+    {
+        if (thin.outputs[i] == sector)
+        {
+            return true;
+        }
+    }
+    return thin.source == sector;
+}
+
+/**
+ * @brief - erase a free sector and make it the head, first dropping the oldest sector if that
+ * would leave thinning no sector to write into
+ */
+static bool advance_head()
+{
+    if (free_sectors() <= 1 && used_sectors > 0 && by_time[0] != head_sector)
+    {
+        uint16_t oldest = by_time[0];
+        if (thinning_uses(oldest))
+        {
+            abort_thinning();
+        }
+        SectorTotals totals;
+        scan_sector(oldest, totals);
+        remove_totals(totals);
+        retire_sector(oldest);
+        stats.dropped += totals.records;
+    }
+    // Through the same rotation as thinning, or one sector would take every short-lived one
+    int16_t next = find_free_sector();
+    if (next < 0 || !take_sector(next))
+    {
+        return false;
+    }
+    head_sector = next;
+    head_sequence++;
+    head_offset = 0;
+    return true;
+}
+
+/**
+ * @brief - write a block, leaving its magic erased unless committing it
+ */
+static bool write_block(BlockBuffer &source, uint16_t sector, uint32_t offset, bool commit)
+{
+    source.header().sequence = head_sequence;
+    return flash_block_write(BLOCKS, sector_address(sector) + offset, source.bytes, commit);
+}
+
+bool track_archive_flush()
+{
+    if (pending.count == 0)
+    {
+        return true;
+    }
+    uint32_t size = flash_block_size(BLOCKS, &pending);
+    if (head_offset + size > FLASH_SECTOR_SIZE && !advance_head())
+    {
+        // Drop the block rather than stall every later fix behind it
+        stats.records -= pending.count;
+        stats.pending = 0;
+        pending.count = 0;
+        return false;
+    }
+    uint32_t offset = head_offset;
+    head_offset += size;
+    if (!write_block(incoming, head_sector, offset, true))
+    {
+        stats.records -= pending.count;
+        stats.pending = 0;
+        pending.count = 0;
+        return false;
+    }
+    if (sector_first_utc[head_sector] == 0)
+    {
+        sector_first_utc[head_sector] = pending.first_utc;
+        sector_level[head_sector] = 0;
+        index_insert(head_sector);
+    }
+    stats.blocks++;
+    stats.stored_bytes += size;
+    stats.pending = 0;
+    pending.count = 0;
+    unsaved_utc = 0;
+    return true;
+}
+
+/**
+ * @brief - append a copy of the pending block to the journal, moving to the other journal
+ * sector when this one is full. Written like a block, its magic last
+ */
+static bool checkpoint()
+{
+    uint32_t size = flash_block_size(BLOCKS, &pending);
+    if (journal_offset + size > FLASH_SECTOR_SIZE)
+    {
+        journal_sector = (journal_sector + 1) % ARCHIVE_JOURNAL_SECTORS;
+        journal_offset = 0;
+        if (!flash_erase_sector(ARCHIVE_JOURNAL_FIRST_SECTOR + journal_sector))
+        {
+            journal_offset = FLASH_SECTOR_SIZE;
+            return false;
+        }
+    }
+    pending.sequence = journal_sequence++;
+    uint32_t address = journal_address(journal_sector) + journal_offset;
+    journal_offset += size;
+    unsaved_utc = 0;
+    stats.checkpoints++;
+    return flash_block_write(JOURNAL, address, incoming.bytes, true);
+}
+
+static void on_fix(const FixEvent &event, void *ctx)
+{
+    (void)ctx;
+    if (event.fix.utc == 0)
+    {
+        return;
+    }
+    FixRecord record = make_fix_record(event);
+    if (pending.count && !encode(incoming, record))
+    {
+        track_archive_flush();
+    }
+    if (pending.count == 0)
+    {
+        start_block(incoming, record, 0);
+    }
+    stats.records++;
+    stats.pending = pending.count;
+    if (unsaved_utc == 0)
+    {
+        unsaved_utc = record.utc;
+    }
+    if (record.utc - pending.first_utc >= ARCHIVE_FLUSH_S)
+    {
+        track_archive_flush();
+    }
+    else if (record.utc - unsaved_utc >= ARCHIVE_CHECKPOINT_S)
+    {
+        checkpoint();
+    }
+}
+
+/**
+ * @brief - write the thinned block after the source's earlier ones, in a fresh sector if needed
+ */
+static bool write_thinned()
+{
+    uint32_t size = flash_block_size(BLOCKS, &thinned.header());
+    if (thin.output_count == 0 || thin.output_offset + size > FLASH_SECTOR_SIZE)
+    {
+        int16_t sector = thin.output_count < MAX_THIN_OUTPUTS ? find_free_sector() : -1;
+        if (sector < 0 || !take_sector(sector))
+        {
+            return false;
+        }
+        sector_level[sector] = LEVEL_RESERVED;
+        thin.outputs[thin.output_count++] = sector;
+        thin.output_offset = 0;
+    }
+    if (!write_block(thinned, thin.outputs[thin.output_count - 1], thin.output_offset, false))
+    {
+        return false;
+    }
+    thin.output_offset += size;
+    thinned.header().count = 0;
+    return true;
+}
+
+static bool keep(const FixRecord &record)
+{
+    if (thinned.header().count && encode(thinned, record))
+    {
+        return true;
+    }
+    if (thinned.header().count && !write_thinned())
+    {
+        return false;
+    }
+    start_block(thinned, record, thin.level);
+    return true;
+}
+
+/**
+ * @brief - decide the held fix now that the next one is known
+ * @param next: nullptr at the end of the source, whose last fix is always kept
+ */
+static bool decide(const FixRecord *next)
+{
+    const FixRecord &held = thin.held;
+    bool event = thin.held_first || !next;
+    event |= thin.has_before && (held.flags != thin.before.flags || held.utc - thin.before.utc > ARCHIVE_GAP_S);
+    event |= next && (next->flags != held.flags || next->utc - held.utc > ARCHIVE_GAP_S);
+    if (event || ++thin.since_kept >= ARCHIVE_THIN_STRIDE)
+    {
+        thin.since_kept = 0;
+        return keep(held);
+    }
+    stats.thinned++;
+    return true;
+}
+
+static bool thin_take(const FixRecord &record)
+{
+    if (thin.has_held && !decide(&record))
+    {
+        return false;
+    }
+    thin.before = thin.held;
+    thin.has_before = thin.has_held;
+    thin.held = record;
+    thin.held_first = !thin.has_held;
+    thin.has_held = true;
+    return true;
+}
+
+static void start_thinning(uint16_t position)
+{
+    uint16_t source = by_time[position];
+    memset(&thin, 0, sizeof(thin));
+    thin.step = THIN_READ;
+    thin.source = source;
+    thin.level = sector_level[source] + 1;
+    thinned.header().count = 0;
+    // Carry on in the thinned sector just before the source, so sources pack two to a sector
+    uint16_t previous = position > 0 ? by_time[position - 1] : head_sector;
+    if (previous != head_sector && sector_level[previous] == thin.level)
+    {
+        uint32_t end = sector_end(previous);
+        if (end + ARCHIVE_BLOCK_SIZE <= FLASH_SECTOR_SIZE)
+        {
+            thin.outputs[0] = previous;
+            thin.output_count = 1;
+            thin.output_offset = end;
+            thin.commit_offset = end;
+        }
+    }
+}
+
+/**
+ * @brief - thin the next block of the source
+ */
+static bool thin_block()
+{
+    static uint8_t buffer[ARCHIVE_BLOCK_SIZE] __attribute__((aligned(4)));
+    BlockHeader &header = *(BlockHeader *)buffer;
+    uint32_t address = sector_address(thin.source) + thin.offset;
+    uint32_t size = flash_block_at(BLOCKS, sector_address(thin.source), thin.offset, &header);
+    if (size == 0 || header.length > PAYLOAD_MAX)
+    {
+        thin.step = THIN_COMMIT;
+        return (!thin.has_held || decide(nullptr)) && (thinned.header().count == 0 || write_thinned());
+    }
+    thin.offset += size;
+    thin.removed.records += header.count;
+    thin.removed.blocks++;
+    thin.removed.bytes += size;
+    uint8_t *payload = buffer + sizeof(header);
+    if (!flash_read(address + sizeof(header), payload, FLASH_ALIGN4(header.length)) ||
+        flash_block_crc(BLOCKS, &header, payload) != header.crc)
+    {
+        return true; // lost with the source, as a query would skip it
+    }
+    FixRecord record = {header.first_utc, header.lat_e7, header.lng_e7, header.hdop, header.sats, header.flags};
+    BlockCodec codec;
+    codec.start(record);
+    if (!thin_take(record))
+    {
+        return false;
+    }
+    const uint8_t *in = payload, *end = payload + header.length;
+    for (uint8_t i = 1; i < header.count && in; i++)
+    {
+        if ((in = decode(in, end, codec, record)) && !thin_take(record))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief - undo a commit cut short by a power loss: clear the magic of the first block in a
+ * more thinned sector that starts within the source's time range, which hides it and the
+ * rest of the same pass after it. Thinning keeps the first fix of a source, so its thinned
+ * copy starts at the source's first UTC; earlier passes' blocks all start before it
+ * @return true if anything was rolled back
+ */
+static bool rollback_commit(uint16_t sector, uint32_t first_utc, uint32_t last_utc)
+{
+    BlockHeader header;
+    for (uint32_t offset = 0, size; (size = flash_block_at(BLOCKS, sector_address(sector), offset, &header)); offset += size)
+    {
+        if (header.first_utc < first_utc || header.first_utc > last_utc)
+        {
+            continue;
+        }
+        if (offset == 0)
+        {
+            retire_sector(sector); // an output the pass took fresh
+        }
+        else
+        {
+            uint32_t zero = 0;
+            flash_write(sector_address(sector) + offset, &zero, sizeof(zero));
+        }
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief - make the thinned blocks valid, then retire the source
+ */
+static void commit_thinning()
+{
+    for (uint8_t i = 0; i < thin.output_count; i++)
+    {
+        uint16_t sector = thin.outputs[i];
+        BlockHeader header;
+        for (uint32_t offset = i == 0 ? thin.commit_offset : 0, size;
+             (size = flash_block_at(UNCOMMITTED, sector_address(sector), offset, &header)); offset += size)
+        {
+            // Erased flash past the last block has no valid length
+            if (header.length > PAYLOAD_MAX || !flash_block_commit(BLOCKS, sector_address(sector) + offset))
+            {
+                break;
+            }
+            stats.records += header.count;
+            stats.blocks++;
+            stats.stored_bytes += size;
+            if (sector_first_utc[sector] == 0)
+            {
+                sector_first_utc[sector] = header.first_utc;
+                sector_level[sector] = thin.level;
+                index_insert(sector);
+            }
+        }
+        if (sector_first_utc[sector] == 0)
+        {
+            sector_level[sector] = 0; // nothing made it in
+        }
+    }
+    remove_totals(thin.removed);
+    retire_sector(thin.source);
+    stats.decimations++;
+    thin.step = THIN_IDLE;
+}
+
+bool track_archive_service()
+{
+    switch (thin.step)
+    {
+    case THIN_IDLE:
+        if (free_sectors() >= ARCHIVE_SPARE_SECTORS || find_free_sector() < 0)
+        {
+            return false;
+        }
+        // The oldest sector at full density outside the recent ones, and once there is none the
+        // oldest at the next level, so density falls in steps with age
+        for (uint8_t level = 0; level < ARCHIVE_MAX_LEVEL; level++)
+        {
+            for (uint16_t position = 0; position + ARCHIVE_RECENT_SECTORS < used_sectors; position++)
+            {
+                if (by_time[position] != head_sector && sector_level[by_time[position]] == level)
+                {
+                    start_thinning(position);
+                    return true;
+                }
+            }
+        }
+        return false;
+    case THIN_READ:
+        if (!thin_block())
+        {
+            abort_thinning();
+        }
+        return true;
+    case THIN_COMMIT:
+        commit_thinning();
+        return true;
+    }
+    return false;
+}
+
+bool track_archive_busy()
+{
+    return thin.step != THIN_IDLE;
+}
+
+/**
+ * @brief - find the newest intact copy in the journal, continue the journal after it, and
+ * take it back as the pending block if its fixes are newer than the ring's
+ * @param archived_utc: last fix in the head sector
+ */
+static void restore_checkpoint(uint32_t archived_utc)
+{
+    static uint8_t buffer[ARCHIVE_BLOCK_SIZE] __attribute__((aligned(4)));
+    BlockHeader &header = *(BlockHeader *)buffer;
+    bool found = false;
+    uint32_t newest = 0;
+    journal_sector = ARCHIVE_JOURNAL_SECTORS - 1;
+    journal_offset = FLASH_SECTOR_SIZE;
+    journal_sequence = 0;
+    for (uint16_t sector = 0; sector < ARCHIVE_JOURNAL_SECTORS; sector++)
+    {
+        for (uint32_t offset = 0, size; (size = flash_block_at(JOURNAL, journal_address(sector), offset, &header)); offset += size)
+        {
+            uint32_t address = journal_address(sector) + offset;
+            if (header.length > PAYLOAD_MAX)
+            {
+                break;
+            }
+            if (found && (int32_t)(header.sequence - newest) <= 0)
+            {
+                continue;
+            }
+            if (!flash_read(address + sizeof(header), buffer + sizeof(header), FLASH_ALIGN4(header.length)) ||
+                flash_block_crc(JOURNAL, &header, buffer + sizeof(header)) != header.crc)
+            {
+                continue;
+            }
+            found = true;
+            newest = header.sequence;
+            journal_sector = sector;
+            memset(incoming.bytes, 0xFF, sizeof(incoming.bytes));
+            memcpy(incoming.bytes, buffer, sizeof(header) + header.length);
+        }
+    }
+    if (!found)
+    {
+        pending.count = 0;
+        return;
+    }
+    journal_sequence = newest + 1;
+    journal_offset = flash_blocks_end(JOURNAL, journal_address(journal_sector), nullptr);
+    if (pending.first_utc <= archived_utc || pending.count == 0)
+    {
+        pending.count = 0; // written to the ring since
+        return;
+    }
+    // Rebuild the encoder state by decoding the block
+    FixRecord record = {pending.first_utc, pending.lat_e7, pending.lng_e7, pending.hdop, pending.sats, pending.flags};
+    incoming.codec.start(record);
+    const uint8_t *in = incoming.payload(), *end = in + pending.length;
+    for (uint8_t i = 1; i < pending.count && in; i++)
+    {
+        in = decode(in, end, incoming.codec, record);
+    }
+    if (!in)
+    {
+        pending.count = 0;
+        return;
+    }
+    stats.records += pending.count;
+    stats.pending = stats.restored = pending.count;
+}
+
+void track_archive_begin()
+{
+    memset(&stats, 0, sizeof(stats));
+    used_sectors = 0;
+    thin.step = THIN_IDLE;
+    bool any = false;
+    for (uint16_t sector = 0; sector < ARCHIVE_SECTORS; sector++)
+    {
+        BlockHeader header;
+        sector_first_utc[sector] = 0;
+        sector_level[sector] = 0;
+        if (!flash_block_at(BLOCKS, sector_address(sector), 0, &header))
+        {
+            continue;
+        }
+        sector_first_utc[sector] = header.first_utc;
+        sector_level[sector] = (uint8_t)~header.level;
+        index_insert(sector);
+        // Thinned sectors carry the sequence of whichever sector was the head when they were written
+        if (sector_level[sector] == 0 && (!any || (int32_t)(header.sequence - head_sequence) > 0))
+        {
+            head_sector = sector;
+            head_sequence = header.sequence;
+            any = true;
+        }
+    }
+    // Thinning keeps the last fix of every source, so a sector whose last fix a more thinned
+    // sector holds is the source of a pass interrupted before it was retired
+    uint32_t last_utc[ARCHIVE_SECTORS];
+    SectorTotals totals;
+    for (uint16_t sector = 0; sector < ARCHIVE_SECTORS; sector++)
+    {
+        scan_sector(sector, totals);
+        last_utc[sector] = totals.last_utc;
+    }
+    for (uint16_t sector = 0; sector < ARCHIVE_SECTORS; sector++)
+    {
+        if (!sector_first_utc[sector])
+        {
+            continue;
+        }
+        bool stale = false;
+        for (uint16_t other = 0; other < ARCHIVE_SECTORS && !stale; other++)
+        {
+            stale = sector_first_utc[other] && sector_level[other] > sector_level[sector] &&
+                    sector_first_utc[other] <= last_utc[sector] && last_utc[other] >= last_utc[sector];
+        }
+        if (stale)
+        {
+            retire_sector(sector);
+        }
+    }
+    // A pass interrupted partway through its commit left the source intact and a prefix of its
+    // thinned copy valid, which queries would return as well
+    for (uint16_t sector = 0; sector < ARCHIVE_SECTORS; sector++)
+    {
+        for (uint16_t other = 0; other < ARCHIVE_SECTORS && sector_first_utc[sector]; other++)
+        {
+            if (sector_first_utc[other] && sector_level[other] == sector_level[sector] + 1)
+            {
+                rollback_commit(other, sector_first_utc[sector], last_utc[sector]);
+            }
+        }
+    }
+    for (uint16_t sector = 0; sector < ARCHIVE_SECTORS; sector++)
+    {
+        if (!sector_first_utc[sector])
+        {
+            continue;
+        }
+        scan_sector(sector, totals);
+        stats.records += totals.records;
+        stats.blocks += totals.blocks;
+        stats.stored_bytes += totals.bytes;
+    }
+    uint32_t archived_utc = 0;
+    if (any)
+    {
+        head_offset = sector_end(head_sector);
+        next_free = (head_sector + 1) % ARCHIVE_SECTORS;
+        scan_sector(head_sector, totals);
+        archived_utc = totals.last_utc;
+    }
+    else
+    {
+        // Start the first advance at sector 0
+        head_sector = ARCHIVE_SECTORS - 1;
+        head_offset = FLASH_SECTOR_SIZE;
+        next_free = 0;
+    }
+    unsaved_utc = 0;
+    restore_checkpoint(archived_utc);
+    fix_events.subscribe(on_fix);
+}
+
+/**
+ * @brief Copies matching records out of decoded blocks, applying the skip
+ */
+struct QueryCursor
+{
+    uint32_t from_utc;
+    uint32_t to_utc;
+    size_t skip;
+    FixRecord *out;
+    size_t max;
+    size_t copied;
+    bool done;
+
+    void take(const FixRecord &record)
+    {
+        if (record.utc > to_utc)
+        {
+            done = true;
+        }
+        else if (record.utc >= from_utc && skip)
+        {
+            skip--;
+        }
+        else if (record.utc >= from_utc)
+        {
+            out[copied++] = record;
+            done = copied == max;
+        }
+    }
+
+    /**
+     * @brief - account for a block from its header alone if that is enough
+     * @return true if the block needs decoding
+     */
+    bool wants(const BlockHeader &header)
+    {
+        if (header.last_utc < from_utc)
+        {
+            return false;
+        }
+        if (header.first_utc > to_utc)
+        {
+            done = true;
+            return false;
+        }
+        if (header.first_utc >= from_utc && header.last_utc <= to_utc && skip >= header.count)
+        {
+            skip -= header.count;
+            return false;
+        }
+        return true;
+    }
+
+    void scan(const BlockHeader &header, const uint8_t *payload)
+    {
+        FixRecord record = {header.first_utc, header.lat_e7, header.lng_e7, header.hdop, header.sats, header.flags};
+        BlockCodec codec;
+        codec.start(record);
+        take(record);
+        const uint8_t *in = payload, *end = payload + header.length;
+        for (uint8_t i = 1; i < header.count && !done && in; i++)
+        {
+            if ((in = decode(in, end, codec, record)))
+            {
+                take(record);
+            }
+        }
+    }
+};
+
+static void query_sector(uint16_t sector, QueryCursor &cursor)
+{
+    static uint8_t buffer[ARCHIVE_BLOCK_SIZE] __attribute__((aligned(4)));
+    BlockHeader &header = *(BlockHeader *)buffer;
+    for (uint32_t offset = 0, size; !cursor.done && (size = flash_block_at(BLOCKS, sector_address(sector), offset, &header)); offset += size)
+    {
+        if (header.length > PAYLOAD_MAX)
+        {
+            return;
+        }
+        if (!cursor.wants(header))
+        {
+            continue;
+        }
+        uint8_t *payload = buffer + sizeof(header);
+        if (flash_read(sector_address(sector) + offset + sizeof(header), payload, FLASH_ALIGN4(header.length)) &&
+            flash_block_crc(BLOCKS, &header, payload) == header.crc)
+        {
+            cursor.scan(header, payload);
+        }
+    }
+}
+
+size_t track_archive_query(uint32_t from_utc, uint32_t to_utc, size_t skip, FixRecord *out, size_t max)
+{
+    QueryCursor cursor = {from_utc, to_utc, skip, out, max, 0, max == 0};
+    for (uint16_t i = 0; i < used_sectors && !cursor.done; i++)
+    {
+        // Skip the sector if the next one already starts before the range
+        if (i + 1 < used_sectors && sector_first_utc[by_time[i + 1]] < from_utc)
+        {
+            continue;
+        }
+        query_sector(by_time[i], cursor);
+    }
+    if (pending.count && !cursor.done && cursor.wants(pending))
+    {
+        cursor.scan(pending, incoming.payload());
+    }
+    return cursor.copied;
+}
+
+ArchiveStats track_archive_stats()
+{
+    ArchiveStats result = stats;
+    result.sectors = ARCHIVE_SECTORS;
+    result.free_sectors = free_sectors();
+    result.oldest_utc = used_sectors ? sector_first_utc[by_time[0]] : (pending.count ? pending.first_utc : 0);
+    return result;
+}
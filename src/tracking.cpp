@@ -13,95 +13,782 @@
  *
  */
 
-#include <SoftwareSerial.h>
 #include <TinyGPSPlus.h>
+#if defined(ARDUINO_ARCH_ESP32)
+#include <WiFi.h>
+#include <WebServer.h>
+#else
+#include <SoftwareSerial.h>
 #include <ESP8266WiFi.h>
 #include <ESP8266WebServer.h>
+extern "C"
+{
+#include <user_interface.h>
+}
+#endif
 #include "secrets.h"
+#include "config_store.h"
+#include "bench.h"
+#include "cell_cache.h"
+#include "cpu_governor.h"
+#include "energy.h"
+#include "events.h"
+#include "fix_snapshot.h"
+#include "flash_layout.h"
+#include "flight_recorder.h"
+#include "gpsd_server.h"
+#include "health.h"
+#include "hot_path.h"
+#include "http_admission.h"
+#include "live_channel.h"
+#include "live_session.h"
+#include "network_cache.h"
+#include "nmea.h"
+#include "nmea_reader.h"
+#include "pipeline.h"
+#include "pipeline_stages.h"
+#include "replay_track.h"
+#include "response_cache.h"
+#include "route_monitor.h"
+#include "spatial_key.h"
+#include "spsc_queue.h"
+#include "track_archive.h"
+#include "ubx.h"
 
-/* Put your SSID & Password */
-const char *ssid = AP_SSID;    // Enter SSID here
-const char *password = AP_PWD; // Enter Password here
+#if defined(TRACKER_TASKS) && !defined(ARDUINO_ARCH_ESP32)
+#error "TRACKER_TASKS needs the dual-core ESP32"
+#endif
+
+/* SSID & Password are read from the config store, secrets.h provides the defaults */
+char ssid[33];
+char password[65];
 
 /* Put IP Address details */
 IPAddress local_ip(192, 168, 1, 1);
 IPAddress gateway(192, 168, 1, 1);
 IPAddress subnet(255, 255, 255, 0);
 
+NmeaParser nmea;
+#ifdef NMEA_DIFF_CHECK
+TinyGPSPlus gps_reference; // decodes the same bursts for comparison
+uint32_t nmea_diff_checked = 0;
+uint32_t nmea_diff_mismatches = 0;
+#endif
+
+#define MESSAGE_BUFFER_SIZE 4097
+#define GPS_BURST_SIZE 1024 // a full 1 Hz NEO-6M epoch is about 500 bytes
+#define GPS_READ_INTERVAL_MS 10000
+#define UPLOAD_GEOHASH_CHARS 8 // about 38 by 19 m
+#define LOOP_IDLE_MS 1
+#define GOVERNOR_QUIET_MS 200 // after a burst is read the receiver is silent for most of a second
+#define HEALTH_GPS_SILENT_MS (3 * GPS_READ_INTERVAL_MS)
+#define HEALTH_FAILURES 3 // unanswered AT commands, undecodable bursts or failed AP probes in a row
+#define HEALTH_MAX_ESCALATIONS 2   // full restarts in a row before a subsystem is left failed
+#define HEALTH_STABLE_MS 600000UL  // healthy this long after boot and the full restarts helped
+#define WEB_PROBE_CONNECT_MS 30000 // connect to the listener on this probe period, not every probe
+#define WEB_PROBE_TIMEOUT_MS 200
+#define AT_QUERY_TIMEOUT_MS 1000 // queries answer at once; also the registration poll period
+char msgStream[MESSAGE_BUFFER_SIZE];
+bool modem_replied = false; // the last AT command got any reply
+uint8_t health_escalations = 0; // full restarts in a row without a stable run, kept in the config store
+uint8_t escalation_request = 0; // subsystem + 1 whose full restart the HTTP context is to run
+
+/* Owned by the modem context once setup() has loaded them */
+NetworkSelection network_selection; // plmn empty if nothing is cached
+NetworkBands network_bands;         // empty until read before the first narrowing
+NetworkAttachStats network_stats;
+NetworkAttachStats network_shown;   // as last saved, for the status page
+bool network_narrowed = false;      // the modem is scanning the cached selection only, until it reboots
+
+struct NetworkCacheUpdate
+{
+    NetworkSelection selection;
+    NetworkBands bands;
+    NetworkAttachStats stats;
+};
+char CLOUD_URL[CONFIG_MAX_VALUE + 1];
+
+#if defined(ARDUINO_ARCH_ESP32)
+WebServer server(80);
+
+/* The modem and receiver sit on hardware UARTs */
+#define MCU_RXD 16 // GSM TX
+#define MCU_TXD 17 // GSM RX
+#define GPS_TXD 26 // GPS TX
+#define GPS_RXD 27 // GPS RX
+HardwareSerial GSM_Serial(2);
+HardwareSerial GPS_Serial(1);
+#else
 ESP8266WebServer server(80);
-TinyGPSPlus gps;
 
 #define MCU_RXD D5 // GSM TX
 #define MCU_TXD D6 // GSM RX
 #define GPS_TXD D1 // GPS TX
 #define GPS_RXD D2 // GPS RX
-#define MESSAGE_BUFFER_SIZE 4097
-char msgStream[MESSAGE_BUFFER_SIZE];
 SoftwareSerial GSM_Serial(MCU_RXD, MCU_TXD);
 SoftwareSerial GPS_Serial(GPS_TXD, GPS_RXD);
-String CLOUD_URL = FIREBASE_URL;
+#endif
+
+char gpsStream[GPS_BURST_SIZE]; // assembled while the modem uses msgStream
+#ifndef TRACKER_TASKS
+unsigned long gps_burst_read = 0; // when NmeaSource last completed a burst
+#endif
 
 // Function declarations
 
-void read_serial(SoftwareSerial *softSerial, char *buffer);
-void sendATcommand(SoftwareSerial *softSerial, String CMD, long unsigned int timeout = 4000, bool fill_buffer = false);
-void cleanSerial(SoftwareSerial *softSerial);
+void read_serial(Stream *softSerial, char *buffer);
+void sendATcommand(Stream *softSerial, String CMD, long unsigned int timeout = 4000, bool fill_buffer = false);
+void cleanSerial(Stream *softSerial);
+void modem_begin();
+bool target_network();
+void target_operator();
+void scan_all_networks(bool immediate);
+void check_registration();
+bool wait_registration(unsigned long timeout_ms);
+void record_registration(bool registered, bool targeted, uint32_t elapsed_ms);
+void save_network(const NetworkCacheUpdate &update);
 void enableGPRS();
 void PUT_REQUEST(const String &data);
-void gps_encode();
+String upload_body(const GpsFix &fix);
+bool gps_encode(const char *ptr, GpsFix &fix);
+bool tinygps_encode(TinyGPSPlus &decoder, const char *ptr, GpsFix &fix);
+bool same_fix(const GpsFix &a, const GpsFix &b);
 String SendHTML(String _body = "");
 void display_logs();
 void handle_OnConnect();
 void sys_restart();
+void mcu_restart();
+bool restart_modem();
+bool restart_gps();
+bool restart_web();
+bool probe_web();
+bool escalate_restart(HealthSubsystem subsystem);
+void service_escalation();
+bool web_listening();
 void gps_status_send();
 void handle_NotFound();
-double _lat = 0, _long = 0, _prevLat = 0, _prevLong = 0, _newLat = 0, _newLong = 0;
-unsigned int last_gps_read = 0;
-bool isLocationUpdated = false;
+void handle_config();
+String html_escape(const String &text);
+const char *config_value_error(const String &key, const String &value);
+void handle_bench();
+void handle_energy();
+void handle_recorder();
+void handle_live();
+void handle_route();
+void on_route_log(const RouteEvent &event, void *ctx);
+void admit(void (*handler)());
+bool send_cached(CachedRoute route);
+void send_rendered(CachedRoute route, const String &page);
+void load_config();
+void set_modem_state(ModemState state);
+void on_fix_log(const FixEvent &event, void *ctx);
+void on_modem_log(const ModemEvent &event, void *ctx);
+void service_clients();
+void idle_wait(unsigned long ms);
+bool set_cpu_speed(CpuSpeed speed);
+#ifdef TRACKER_TASKS
+void gps_task(void *arg);
+void http_task(void *arg);
+void uplink_task(void *arg);
+void modem_task(void *arg);
+#endif
+
+/**
+ * @brief Reads the NEO-6M through GPS_Serial. The port is drained on every poll and each
+ * burst assembled whole; outside live sessions only one burst per GPS_READ_INTERVAL_MS is
+ * decoded and the rest dropped. The fix time is when the burst's first byte was drained, for
+ * latency measurement.
+ */
+class NmeaSource
+{
+public:
+    NmeaSource() : _reader(gpsStream, sizeof(gpsStream)), _last_read(0), _read_once(false) {}
+
+    HOT_PATH bool poll(FixEvent &event)
+    {
+        bool complete = _reader.poll(GPS_Serial, millis());
+        // gpsd watchers get the receiver output byte for byte, whole bursts or not
+        if (_reader.fresh_length())
+        {
+            gpsd_feed(_reader.fresh(), _reader.fresh_length());
+        }
+        if (!complete)
+        {
+            return false;
+        }
+#ifndef TRACKER_TASKS
+        gps_burst_read = millis();
+#endif
+        // Live sessions and gpsd watchers get every burst as the receiver sends it
+        unsigned long interval = live_session_active() || gpsd_watchers() ? 0 : GPS_READ_INTERVAL_MS;
+        unsigned long started = _reader.started_ms();
+        if (_read_once && started - _last_read < interval)
+        {
+            _reader.clear();
+            return false;
+        }
+        _last_read = started;
+        _read_once = true;
+        recorder_log(RECORDER_GPS_RX, gpsStream, _reader.length());
+        Serial.print(gpsStream);
+        uint32_t passed = nmea.passed();
+        bool valid = gps_encode(gpsStream, event.fix);
+        health_report(HEALTH_GPS, nmea.passed() != passed); // talking sense, with a fix or not
+        _reader.clear();
+        if (!valid)
+        {
+            return false;
+        }
+        event.fix.time_ms = started;
+        return true;
+    }
+
+    const NmeaReader &reader() const { return _reader; }
+
+private:
+    NmeaReader _reader;
+    unsigned long _last_read;
+    bool _read_once;
+};
+
+#ifdef TRACKER_REPLAY
+/**
+ * @brief Feeds the recorded REPLAY_TRACK through the NMEA decoder instead of the receiver
+ */
+class ReplaySource
+{
+public:
+    ReplaySource() : _last_read(0), _position(0) {}
+
+    bool poll(FixEvent &event)
+    {
+        if ((millis() - _last_read) <= GPS_READ_INTERVAL_MS)
+        {
+            return false;
+        }
+        _last_read = millis();
+        const char *burst = REPLAY_TRACK[_position];
+        _position = (_position + 1) % REPLAY_TRACK_LENGTH;
+        Serial.print(burst);
+        gpsd_feed(burst, strlen(burst));
+        return gps_encode(burst, event.fix);
+    }
+
+private:
+    unsigned long _last_read;
+    size_t _position;
+};
+#endif
+
+/**
+ * @brief Uploads moved fixes to the cloud through the modem. Uploads block for seconds, so they
+ * are skipped during live sessions, which stream over the live channel instead.
+ */
+class HttpSink
+{
+public:
+    bool process(FixEvent &event)
+    {
+        if (event.moved && !live_session_active())
+        {
+            PUT_REQUEST(upload_body(event.fix));
+        }
+        return true;
+    }
+};
+
+#ifdef TRACKER_TASKS
+/*
+ * One FreeRTOS task per subsystem. The HTTP task owns the event bus and everything
+ * subscribed to it; the other tasks only reach it through these single-producer queues.
+ */
+#define GPS_TASK_CORE 1
+#define MODEM_TASK_CORE 1
+#define HTTP_TASK_CORE 0 // with the WiFi stack
+#define UPLINK_TASK_CORE 0
+#define UPLOAD_BODY_SIZE 112
+
+struct UploadJob
+{
+    char body[UPLOAD_BODY_SIZE];
+};
+
+typedef SpscQueue<FixEvent, 8> FixQueue;
+FixQueue gps_fixes;    // GPS task -> HTTP task
+FixQueue uplink_fixes; // HTTP task -> uplink task
+SpscQueue<UploadJob, 2> upload_jobs;       // uplink task -> modem task
+SpscQueue<ModemEvent, 8> modem_updates;    // modem task -> HTTP task
+SpscQueue<UploadEvent, 4> upload_results;  // modem task -> HTTP task
+SpscQueue<NetworkCacheUpdate, 2> network_saves; // modem task -> HTTP task, which owns the config store
+
+/**
+ * @brief Passes moved fixes to the uplink task, outside live sessions
+ */
+class UplinkSink
+{
+public:
+    bool process(FixEvent &event)
+    {
+        if (event.moved && !live_session_active())
+        {
+            uplink_fixes.push(event);
+        }
+        return true;
+    }
+};
+
+typedef Pipeline<NmeaSource, QueueSink<FixQueue, gps_fixes>> IntakePipeline;
+typedef Pipeline<QueueSource<FixQueue, gps_fixes>, MovementFilter<>, LatencyMeter, BusSink, UplinkSink> TrackerPipeline;
+IntakePipeline intake;
+#elif defined(TRACKER_REPLAY)
+typedef Pipeline<ReplaySource, MovementFilter<>, LatencyMeter, BusSink> TrackerPipeline;
+#else
+typedef Pipeline<NmeaSource, MovementFilter<>, LatencyMeter, BusSink, HttpSink> TrackerPipeline;
+#endif
+TrackerPipeline pipeline;
+#define PIPELINE_LATENCY 1 // index of the LatencyMeter stage
 
 void setup()
 {
 
     Serial.begin(115200);
+    energy_begin([]() -> uint32_t { return micros(); });
+    recorder_begin([]() -> uint32_t { return millis(); });
+    load_config();
+    health_begin([]() -> uint32_t { return millis(); }, escalate_restart);
+#ifndef TRACKER_TASKS
+    governor_begin([]() -> uint32_t { return micros(); }, set_cpu_speed);
+#endif
+#if defined(ARDUINO_ARCH_ESP32)
+    GPS_Serial.begin(9600, SERIAL_8N1, GPS_TXD, GPS_RXD);
+    GSM_Serial.begin(115200, SERIAL_8N1, MCU_RXD, MCU_TXD);
+#else
     GPS_Serial.begin(9600);
     GSM_Serial.begin(115200);
-    WiFi.softAP(ssid, password);
+#endif
+    WiFi.softAP(ssid, password, 1, 0, HTTP_MAX_STATIONS);
     WiFi.softAPConfig(local_ip, gateway, subnet);
+    energy_enter(ENERGY_AP_ON);
+    health_register(HEALTH_MODEM, 0, HEALTH_FAILURES, nullptr, restart_modem);
+#ifndef TRACKER_REPLAY
+    health_register(HEALTH_GPS, HEALTH_GPS_SILENT_MS, HEALTH_FAILURES, nullptr, restart_gps);
+#endif
+    health_register(HEALTH_WEB, 0, HEALTH_FAILURES, probe_web, restart_web);
+    fix_events.subscribe(on_fix_log);
+    fix_snapshot_begin();
+    track_archive_begin();
+    cell_cache_begin();
+    gpsd_begin();
+    route_begin();
+    response_cache_begin();
+    route_events.subscribe(on_route_log);
+    modem_events.subscribe(on_modem_log);
     delay(1000);
-    server.on("/", gps_status_send);
-    server.on("/logs", display_logs);
-    server.on("/restart", sys_restart);
-    server.onNotFound(handle_NotFound);
+    server.on("/", []() { admit(gps_status_send); });
+    server.on("/logs", []() { admit(display_logs); });
+    server.on("/restart", []() { admit(sys_restart); });
+    server.on("/config", []() { admit(handle_config); });
+    server.on("/bench", []() { admit(handle_bench); });
+    server.on("/live", []() { admit(handle_live); });
+    server.on("/route", []() { admit(handle_route); });
+    server.on("/energy", []() { admit(handle_energy); });
+    server.on("/recorder", []() { admit(handle_recorder); });
+    server.onNotFound([]() { admit(handle_NotFound); });
+    const char *headers[] = {"Accept-Encoding"};
+    server.collectHeaders(headers, 1);
     server.begin();
+    live_channel_begin();
+    live_session_begin(&GPS_Serial);
     Serial.println("HTTP server started");
 
     delay(2000); // Allow some delay for you to open the serial monitor
+#ifdef TRACKER_TASKS
+    xTaskCreatePinnedToCore(gps_task, "gps", 4096, nullptr, 3, nullptr, GPS_TASK_CORE);
+    xTaskCreatePinnedToCore(modem_task, "modem", 4096, nullptr, 2, nullptr, MODEM_TASK_CORE);
+    xTaskCreatePinnedToCore(http_task, "http", 8192, nullptr, 2, nullptr, HTTP_TASK_CORE);
+    xTaskCreatePinnedToCore(uplink_task, "uplink", 3072, nullptr, 1, nullptr, UPLINK_TASK_CORE);
+#else
+    modem_begin();
+#endif
+}
+
+void loop()
+{
+#ifdef TRACKER_TASKS
+    vTaskDelete(nullptr); // all work runs in the subsystem tasks
+#else
+    service_clients();
+    if (!pipeline.run())
+    {
+        idle_wait(LOOP_IDLE_MS);
+    }
+    // Only switch in the silence after a burst, with nothing half received on either port
+    bool quiet = millis() - gps_burst_read < GOVERNOR_QUIET_MS && !GPS_Serial.available() && !GSM_Serial.available();
+    governor_update(quiet, live_session_active() || gpsd_watchers() || track_archive_busy());
+    health_service(HEALTH_GPS);
+    health_service(HEALTH_MODEM);
+#endif
+}
+
+/**
+ * @brief - wait without work, accounted as light sleep so the governor sees no load. The SDK
+ * can gate the CPU clock inside delay(). True light sleep is unavailable while the soft AP
+ * runs, so cpu_light_sleep should be given the measured idle current
+ */
+void idle_wait(unsigned long ms)
+{
+#ifdef TRACKER_TASKS
+    delay(ms); // a task delay; the energy accounting belongs to the HTTP task
+#else
+    energy_enter(ENERGY_CPU_LIGHT_SLEEP);
+    delay(ms);
+    energy_enter(governor_active_state());
+#endif
+}
+
+/**
+ * @brief - serve web and live clients, the web server within its CPU budget
+ */
+void service_clients()
+{
+    energy_update();
+    if (http_cpu_available(millis()))
+    {
+        unsigned long start = micros();
+        server.handleClient();
+        http_cpu_charge(micros() - start);
+    }
+    live_channel_loop();
+    live_session_loop();
+    gpsd_loop();
+    track_archive_service();
+    health_service(HEALTH_WEB);
+    service_escalation();
+}
+
+/**
+ * @brief - governor callback, switch the CPU clock. The ESP32 UARTs run from the 80 MHz APB
+ * clock at either speed; the ESP8266 SoftwareSerial ports must begin again at the new one
+ */
+bool set_cpu_speed(CpuSpeed speed)
+{
+#if defined(ARDUINO_ARCH_ESP32)
+    return setCpuFrequencyMhz(governor_mhz(speed));
+#else
+    if (!system_update_cpu_freq(governor_mhz(speed)))
+    {
+        return false;
+    }
+    GPS_Serial.begin(9600);
+    GSM_Serial.begin(115200);
+    return true;
+#endif
+}
+
+/**
+ * @brief - reset the modem and attach it to the packet network
+ */
+void modem_begin()
+{
+    set_modem_state(MODEM_RESETTING);
     sendATcommand(&GSM_Serial, "AT");
     sendATcommand(&GSM_Serial, "AT+QIACT=0");
     sendATcommand(&GSM_Serial, "AT+CGATT=0");
+    bool targeted = target_network();
     sendATcommand(&GSM_Serial, "AT+CFUN=1,1");
-    delay(30000);
+    unsigned long reset = millis();
+    if (targeted)
+    {
+        target_operator();
+    }
+    bool registered = wait_registration(targeted ? NETWORK_TARGETED_TIMEOUT_MS : NETWORK_SCAN_TIMEOUT_MS);
+    if (!registered && targeted)
+    {
+        network_stats.fallbacks++;
+        targeted = false;
+        scan_all_networks(true);
+        registered = wait_registration(NETWORK_SCAN_TIMEOUT_MS);
+    }
+    else if (registered && targeted)
+    {
+        scan_all_networks(false); // the next reboot scans everything unless narrowed again
+    }
+    record_registration(registered, targeted, millis() - reset);
+    set_modem_state(MODEM_ATTACHING);
     enableGPRS();
+    set_modem_state(MODEM_READY);
 }
 
-void loop()
+/**
+ * @brief - narrow the scan after the coming reset to the RAT and band that last registered.
+ * The band and scan mode settings are kept by the modem across the reset
+ * @return false if nothing is cached
+ */
+bool target_network()
+{
+    if (!network_selection.plmn[0])
+    {
+        return false;
+    }
+    char command[96];
+    if (!network_bands.gsm[0])
+    {
+        // The modem's own band set, before it is first narrowed, is what a full scan restores
+        sendATcommand(&GSM_Serial, "AT+QCFG=\"band\"", AT_QUERY_TIMEOUT_MS);
+        if (!modem_replied || !network_parse_bands(msgStream, network_bands))
+        {
+            network_bands = {};
+        }
+    }
+    network_scan_mode_command(network_selection, command, sizeof(command));
+    sendATcommand(&GSM_Serial, command, AT_QUERY_TIMEOUT_MS);
+    network_band_command(network_selection, network_bands, command, sizeof(command));
+    if (command[0])
+    {
+        sendATcommand(&GSM_Serial, command, AT_QUERY_TIMEOUT_MS);
+    }
+    network_narrowed = true;
+    return true;
+}
+
+/**
+ * @brief - once the reset modem answers, ask for the operator that last registered
+ */
+void target_operator()
+{
+    unsigned long start = millis();
+    do
+    {
+        sendATcommand(&GSM_Serial, "AT", AT_QUERY_TIMEOUT_MS);
+    } while (!modem_replied && millis() - start < NETWORK_BOOT_TIMEOUT_MS);
+    char command[96];
+    network_operator_command(network_selection, command, sizeof(command));
+    sendATcommand(&GSM_Serial, command, AT_QUERY_TIMEOUT_MS);
+}
+
+/**
+ * @brief - undo target_network(): every band, every RAT, automatic operator selection
+ * @param immediate: rescan now, or leave the current registration alone and only write the
+ * settings the next modem reboot starts from
+ */
+void scan_all_networks(bool immediate)
+{
+    char command[96];
+    network_full_band_command(network_bands, immediate, command, sizeof(command));
+    if (command[0])
+    {
+        sendATcommand(&GSM_Serial, command, AT_QUERY_TIMEOUT_MS);
+    }
+    network_full_scan_mode_command(immediate, command, sizeof(command));
+    sendATcommand(&GSM_Serial, command, AT_QUERY_TIMEOUT_MS);
+    if (immediate)
+    {
+        sendATcommand(&GSM_Serial, "AT+COPS=0", AT_QUERY_TIMEOUT_MS);
+        network_narrowed = false;
+    }
+}
+
+/**
+ * @brief - after a failed upload: a modem that lost registration while narrowed to the cached
+ * band would only ever search that band again, so give it all of them
+ */
+void check_registration()
+{
+    if (!network_narrowed)
+    {
+        return;
+    }
+    sendATcommand(&GSM_Serial, "AT+CREG?;+CEREG?", AT_QUERY_TIMEOUT_MS);
+    if (modem_replied && !network_registered(msgStream))
+    {
+        scan_all_networks(true);
+    }
+}
+
+/**
+ * @brief - poll the circuit and LTE registration until either is home or roaming. Unanswered
+ * polls while the modem boots take the same period
+ */
+bool wait_registration(unsigned long timeout_ms)
+{
+    unsigned long start = millis();
+    do
+    {
+        sendATcommand(&GSM_Serial, "AT+CREG?;+CEREG?", AT_QUERY_TIMEOUT_MS);
+        if (modem_replied && network_registered(msgStream))
+        {
+            return true;
+        }
+    } while (millis() - start < timeout_ms);
+    return false;
+}
+
+/**
+ * @brief - count the registration time and cache where the modem registered
+ * @param elapsed_ms: from the reset
+ */
+void record_registration(bool registered, bool targeted, uint32_t elapsed_ms)
+{
+    if (registered)
+    {
+        NetworkSelection selection = {};
+        sendATcommand(&GSM_Serial, "AT+COPS=3,2", AT_QUERY_TIMEOUT_MS); // numeric operator
+        sendATcommand(&GSM_Serial, "AT+COPS?", AT_QUERY_TIMEOUT_MS);
+        if (modem_replied && network_parse_cops(msgStream, selection))
+        {
+            sendATcommand(&GSM_Serial, "AT+QNWINFO", AT_QUERY_TIMEOUT_MS);
+            if (modem_replied)
+            {
+                network_parse_qnwinfo(msgStream, selection); // without a band only the RAT and operator are narrowed
+            }
+            network_selection = selection;
+        }
+        if (targeted)
+        {
+            network_stats.targeted++;
+            network_stats.targeted_ms += elapsed_ms;
+        }
+        else
+        {
+            network_stats.scanned++;
+            network_stats.scanned_ms += elapsed_ms;
+        }
+    }
+    else
+    {
+        network_stats.failures++; // keep the cached selection for the next try
+    }
+    network_stats.last_ms = elapsed_ms;
+    network_stats.last_targeted = targeted;
+    NetworkCacheUpdate update = {network_selection, network_bands, network_stats};
+#ifdef TRACKER_TASKS
+    network_saves.push(update);
+#else
+    save_network(update);
+#endif
+}
+
+/**
+ * @brief - keep the network cache across restarts; the config store skips unchanged values
+ */
+void save_network(const NetworkCacheUpdate &update)
 {
+    if (update.selection.plmn[0])
+    {
+        config_set("net_sel", &update.selection, sizeof(update.selection));
+    }
+    if (update.bands.gsm[0])
+    {
+        config_set("net_bands", &update.bands, sizeof(update.bands));
+    }
+    config_set("net_stats", &update.stats, sizeof(update.stats));
+    network_shown = update.stats;
+}
 
-    server.handleClient();
-    if (GPS_Serial.available() && (millis() - last_gps_read) > 10000)
+#ifdef TRACKER_TASKS
+/**
+ * @brief - read and decode the receiver output
+ */
+void gps_task(void *arg)
+{
+    (void)arg;
+    for (;;)
     {
-        read_serial(&GPS_Serial, msgStream);
-        gps_encode();
-        last_gps_read = millis();
+        if (!intake.run())
+        {
+            vTaskDelay(pdMS_TO_TICKS(10));
+        }
+        health_service(HEALTH_GPS);
     }
 }
 
 /**
- * @brief - read serial data and put it in a buffer
+ * @brief - web server, live channel and everything on the event bus
+ */
+void http_task(void *arg)
+{
+    (void)arg;
+    for (;;)
+    {
+        ModemEvent modem;
+        while (modem_updates.pop(modem))
+        {
+            modem_events.publish(modem);
+        }
+        UploadEvent upload;
+        while (upload_results.pop(upload))
+        {
+            upload_events.publish(upload);
+        }
+        NetworkCacheUpdate network;
+        while (network_saves.pop(network))
+        {
+            save_network(network);
+        }
+        while (pipeline.run())
+        {
+        }
+        service_clients();
+        vTaskDelay(1);
+    }
+}
+
+/**
+ * @brief - turn moved fixes into upload requests, keeping only the newest while the modem is busy
+ */
+void uplink_task(void *arg)
+{
+    (void)arg;
+    FixEvent latest;
+    bool pending = false;
+    for (;;)
+    {
+        FixEvent event;
+        while (uplink_fixes.pop(event))
+        {
+            latest = event;
+            pending = true;
+        }
+        if (pending && upload_jobs.size() == 0)
+        {
+            UploadJob job;
+            snprintf(job.body, sizeof(job.body), "%s", upload_body(latest.fix).c_str());
+            pending = !upload_jobs.push(job);
+        }
+        vTaskDelay(pdMS_TO_TICKS(50));
+    }
+}
+
+/**
+ * @brief - owns the modem UART: attach, then run upload requests one at a time
+ */
+void modem_task(void *arg)
+{
+    (void)arg;
+    modem_begin();
+    for (;;)
+    {
+        UploadJob job;
+        if (upload_jobs.pop(job))
+        {
+            PUT_REQUEST(String(job.body));
+        }
+        else
+        {
+            vTaskDelay(pdMS_TO_TICKS(20));
+        }
+        health_service(HEALTH_MODEM);
+    }
+}
+#endif
+
+/**
+ * @brief - read serial data and put it in a buffer. Only modem replies come through here; the
+ * GPS intake drains its port without waiting, see NmeaReader
  * @param softSerial: pointer to SoftwareSerial object
  * @param buffer: pointer to char array
  */
-void read_serial(SoftwareSerial *softSerial, char *buffer)
+void read_serial(Stream *softSerial, char *buffer)
 {
     bool bufferfull = false;
     int buff_pos = 0;
@@ -118,29 +805,41 @@ void read_serial(SoftwareSerial *softSerial, char *buffer)
         }
         buffer[buff_pos] = c;
         buff_pos++;
-        delay(2); // ? This seems to be the trick to get all serial data if it comes in chunks
+        idle_wait(2); // ? This seems to be the trick to get all serial data if it comes in chunks
     }
 
     buffer[buff_pos] = '\0'; // ? Unecessary if memset is used
 }
 
-void sendATcommand(SoftwareSerial *softSerial, String CMD, long unsigned int _timeout, bool fill_buffer)
+void sendATcommand(Stream *softSerial, String CMD, long unsigned int _timeout, bool fill_buffer)
 {
     Serial.println("*********");
     bool ASSERT_BUFFER = fill_buffer;
     cleanSerial(softSerial);
 
     softSerial->println(CMD);
+    recorder_log(RECORDER_MODEM_TX, CMD.c_str(), CMD.length());
+    recorder_log(RECORDER_MODEM_TX, "\r\n", 2);
     unsigned int send_time = millis();
+    bool replied = false;
 
     do
     {
 
         if (softSerial->available())
         {
+            replied = true;
             read_serial(softSerial, msgStream);
+            recorder_log(RECORDER_MODEM_RX, msgStream, strlen(msgStream));
+            response_cache_invalidate();
+        }
+        else
+        {
+            idle_wait(1); // waiting on the modem is not load for the governor
         }
     } while ((millis() - send_time) < _timeout || ASSERT_BUFFER);
+    modem_replied = replied;
+    health_report(HEALTH_MODEM, replied);
 
     const char *ptr = msgStream;
     while (*ptr)
@@ -149,10 +848,12 @@ void sendATcommand(SoftwareSerial *softSerial, String CMD, long unsigned int _ti
         Serial.write(*ptr);
         ptr++;
     }
-    display_logs();
+#ifndef TRACKER_TASKS
+    display_logs(); // the web server belongs to the HTTP task when running tasks
+#endif
 }
 
-void cleanSerial(SoftwareSerial *softSerial)
+void cleanSerial(Stream *softSerial)
 {
 
     while (Serial.available())
@@ -187,71 +888,202 @@ void PUT_REQUEST(const String &data)
 {
 
     unsigned int data_length = data.length();
+    unsigned long start = millis();
     String HTTPCFG = "AT+QHTTPPUT=" + String(data_length) + ",30,60";
     Serial.println(HTTPCFG);
     Serial.println(data);
+    set_modem_state(MODEM_UPLOADING);
     sendATcommand(&GSM_Serial, HTTPCFG);
     sendATcommand(&GSM_Serial, data);
+
+    // Response ends with +QHTTPPUT: <err>,<http status>[,<length>]
+    UploadEvent upload = {-1, (uint16_t)data_length, 0};
+    const char *result = strstr(msgStream, "+QHTTPPUT:");
+    if (result)
+    {
+        const char *comma = strchr(result, ',');
+        if (comma)
+        {
+            upload.http_status = atoi(comma + 1);
+        }
+    }
+    upload.duration_ms = millis() - start;
+    if (upload.http_status < 0)
+    {
+        check_registration();
+    }
+    set_modem_state(MODEM_READY);
+#ifdef TRACKER_TASKS
+    upload_results.push(upload);
+#else
+    upload_events.publish(upload);
+#endif
 }
 
-void gps_encode()
+/**
+ * @brief - JSON body uploaded for a fix, keyed by its geohash and Hilbert cell for the backend
+ */
+String upload_body(const GpsFix &fix)
+{
+    char geohash[UPLOAD_GEOHASH_CHARS + 1];
+    geohash_encode(fix.lat_e7, fix.lng_e7, UPLOAD_GEOHASH_CHARS, geohash);
+    return "{\"lat\":" + String(E7_TO_DEG(fix.lat_e7), 7) + ",\"long\":" + String(E7_TO_DEG(fix.lng_e7), 7) +
+           ",\"geohash\":\"" + geohash + "\",\"cell\":" + String(hilbert_key(fix.lat_e7, fix.lng_e7, CELL_CACHE_ORDER)) + "}";
+}
+
+void set_modem_state(ModemState state)
+{
+    ModemEvent event = {state};
+#ifdef TRACKER_TASKS
+    modem_updates.push(event); // published by the HTTP task, which owns the event bus
+#else
+    modem_events.publish(event);
+#endif
+}
+
+/**
+ * @brief - convert TinyGPSPlus raw degrees to 1e-7 degree units without going through a double
+ */
+int32_t raw_to_e7(const RawDegrees &raw)
+{
+    int32_t value = (int32_t)raw.deg * 10000000L + (int32_t)(raw.billionths / 100);
+    return raw.negative ? -value : value;
+}
+
+/**
+ * @brief - decode a burst of NMEA sentences. NMEA_DIFF_CHECK builds also run TinyGPSPlus over
+ * the burst and log every fix the two decoders disagree on
+ * @param ptr: null terminated NMEA text
+ * @param fix: filled with the decoded position
+ * @return true if the receiver reports a valid location
+ */
+HOT_PATH bool gps_encode(const char *ptr, GpsFix &fix)
+{
+    bool valid = nmea.decode(ptr, fix);
+    fix.time_ms = millis();
+#ifdef NMEA_DIFF_CHECK
+    GpsFix reference = fix;
+    bool reference_valid = tinygps_encode(gps_reference, ptr, reference);
+    nmea_diff_checked++;
+    if (valid != reference_valid || (valid && !same_fix(fix, reference)))
+    {
+        nmea_diff_mismatches++;
+        Serial.printf("NMEA mismatch: %ld,%ld utc %u hdop %u sats %u, TinyGPSPlus %ld,%ld utc %u hdop %u sats %u\n",
+                      (long)fix.lat_e7, (long)fix.lng_e7, fix.utc, fix.hdop, fix.sats,
+                      (long)reference.lat_e7, (long)reference.lng_e7, reference.utc, reference.hdop, reference.sats);
+    }
+#endif
+    return valid;
+}
+
+/**
+ * @brief - whether two decoded fixes agree. A zero timestamp on either side is not compared:
+ * TinyGPSPlus dates a fix from an empty date field, NmeaParser does not
+ */
+bool same_fix(const GpsFix &a, const GpsFix &b)
+{
+    return a.lat_e7 == b.lat_e7 && a.lng_e7 == b.lng_e7 && a.hdop == b.hdop && a.sats == b.sats &&
+           a.speed == b.speed && a.course == b.course && (a.utc == b.utc || !a.utc || !b.utc);
+}
+
+/**
+ * @brief - the TinyGPSPlus decoder gps_encode() used before NmeaParser, kept as the reference
+ * for NMEA_DIFF_CHECK and /bench
+ * @param decoder: NMEA decoder holding the receiver state
+ */
+bool tinygps_encode(TinyGPSPlus &decoder, const char *ptr, GpsFix &fix)
 {
 
-    const char *ptr = msgStream;
     // double _lat = 0, _long = 0;
     while (*ptr)
     {
-        gps.encode(*ptr);
-        Serial.write(*ptr);
+        decoder.encode(*ptr);
         ptr++;
         // if (*ptr == '\0') // uncoment to debug
         // {
         //   Serial.println("Null character found");
         // }
     }
-    if (gps.location.isValid()) // gprmc data seems to do nothing
+    if (!decoder.location.isValid()) // gprmc data seems to do nothing
     {
-        _lat = gps.location.lat();
-        _long = gps.location.lng();
-        Serial.print("\nLatitude= ");
-        Serial.print(_lat, 9);
-        Serial.print(" Longitude= ");
-        Serial.println(_long, 9);
+        return false;
     }
-    // if (gps.location.isUpdated()) // gprmc data seems to do nothing
-    // {
 
-    //     _newLat = gps.location.lat();
-    //     _newLong = gps.location.lng();
-    //     Serial.print("\nLocation Updated to: ");
-    //     Serial.print("Latitude= ");
-    //     Serial.print(_lat);
-    //     Serial.print(" Longitude= ");
-    //     Serial.println(_long);
+    fix.lat_e7 = raw_to_e7(decoder.location.rawLat());
+    fix.lng_e7 = raw_to_e7(decoder.location.rawLng());
+    fix.time_ms = millis();
+    fix.utc = 0;
+    if (decoder.date.isValid() && decoder.time.isValid() && decoder.date.year() >= 2000)
+    {
+        fix.utc = utc_from_civil(decoder.date.year(), decoder.date.month(), decoder.date.day(),
+                                 decoder.time.hour(), decoder.time.minute(), decoder.time.second());
+    }
+    fix.hdop = decoder.hdop.value();
+    fix.sats = decoder.satellites.value();
+    fix.speed = decoder.speed.value();
+    fix.course = decoder.course.value();
+    return true;
+}
 
-    //     String gps_update = "{\"lat\":" + String(_lat, 9) + ",\"long\":" + String(_long, 9) + "}";
-    //     PUT_REQUEST(gps_update);
-    // }
-    if (_lat != _newLat || _long != _newLong)
+void on_fix_log(const FixEvent &event, void *ctx)
+{
+    (void)ctx;
+    Serial.print("\nLatitude= ");
+    Serial.print(E7_TO_DEG(event.fix.lat_e7), 7);
+    Serial.print(" Longitude= ");
+    Serial.println(E7_TO_DEG(event.fix.lng_e7), 7);
+    if (event.moved)
     {
-        _newLat = _lat;
-        _newLong = _long;
-        isLocationUpdated = true;
-        Serial.print("\nLocation Updated to: ");
-        Serial.print("Latitude= ");
-        Serial.print(_newLat, 9);
-        Serial.print(" Longitude= ");
-        Serial.println(_newLong, 9);
+        Serial.println("Location updated");
+    }
+}
+
+void on_route_log(const RouteEvent &event, void *ctx)
+{
+    (void)ctx;
+    Serial.print(event.type == ROUTE_DEVIATED ? "Route deviation at " : "Route rejoined at ");
+    Serial.print(event.progress_m);
+    Serial.print(" m, cross track ");
+    Serial.print(event.cross_track_m);
+    Serial.println(" m");
+}
+
+void on_modem_log(const ModemEvent &event, void *ctx)
+{
+    (void)ctx;
+    Serial.print("Modem state: ");
+    Serial.println(modem_state_name(event.state));
+}
 
-        String gps_update = "{\"lat\":" + String(_newLat, 9) + ",\"long\":" + String(_newLong, 9) + "}";
-        PUT_REQUEST(gps_update);
+/**
+ * @brief - answer from the response cache, gzipped if the client takes it
+ * @return false if the page must be rendered
+ */
+bool send_cached(CachedRoute route)
+{
+    CachedResponse cached;
+    if (!response_cache_get(route, server.header("Accept-Encoding").indexOf("gzip") >= 0, millis(), cached))
+    {
+        return false;
     }
+    server.sendHeader("Vary", "Accept-Encoding");
+    if (cached.gzip)
+    {
+        server.sendHeader("Content-Encoding", "gzip");
+    }
+    // Straight from the cache buffer, without building a String
+    server.send_P(200, PSTR("text/html"), (PGM_P)cached.body, cached.length);
+    return true;
+}
 
-    else
+/**
+ * @brief - keep a freshly rendered page and send it, from the cache if it fit
+ */
+void send_rendered(CachedRoute route, const String &page)
+{
+    if (!response_cache_put(route, page.c_str(), page.length(), millis()) || !send_cached(route))
     {
-        _prevLat = _newLat;
-        _prevLong = _newLong;
-        isLocationUpdated = false;
+        server.send(200, "text/html", page);
     }
 }
 
@@ -259,26 +1091,125 @@ void gps_status_send()
 {
 
     Serial.println("Sending GPS data");
+    if (send_cached(CACHED_STATUS))
+    {
+        return;
+    }
+    FixSnapshot snapshot = fix_snapshot.read();
     String data = "<h1>GPS COORDS</h1>\n";
-    if (_lat != 0 && _long != 0)
+    if (snapshot.valid)
     {
-        data += "<p>Current Latitude: " + String(_lat, 9) + "</P>\n";
-        data += "<p>Current Longitude: " + String(_long, 9) + "</P>\n";
+        data += "<p>Current Latitude: " + String(E7_TO_DEG(snapshot.current.lat_e7), 7) + "</P>\n";
+        data += "<p>Current Longitude: " + String(E7_TO_DEG(snapshot.current.lng_e7), 7) + "</P>\n";
     }
 
-    if (isLocationUpdated)
+    if (snapshot.valid && snapshot.updated)
     {
         data += "<div style=\"padding:4px;border: 1px solid green;word-wrap:break-word;\">";
-        data += "<p>Updated latitude FROM: " + String(_prevLat, 9) + " TO: " + String(_newLat, 9) + "</P>\n";
-        data += "<p>Updated longtitude FROM: " + String(_prevLong, 9) + " TO: " + String(_newLong, 9) + "</P>\n";
+        data += "<p>Updated latitude FROM: " + String(E7_TO_DEG(snapshot.previous.lat_e7), 7) + " TO: " + String(E7_TO_DEG(snapshot.current.lat_e7), 7) + "</P>\n";
+        data += "<p>Updated longtitude FROM: " + String(E7_TO_DEG(snapshot.previous.lng_e7), 7) + " TO: " + String(E7_TO_DEG(snapshot.current.lng_e7), 7) + "</P>\n";
         data += "</div>\n";
     }
     else
     {
         data += "<p> GPS location not updated</p>\n";
     }
+    if (modem_events.has_last())
+    {
+        data += "<p>Modem: " + String(modem_state_name(modem_events.last().state)) + "</p>\n";
+    }
+    HttpAdmissionStats http_stats = http_admission_stats();
+    data += "<p>HTTP: " + String(http_stats.admitted) + " served, " + String(http_stats.rejected) + " rate limited, " + String(http_stats.deferred) + " deferred</p>\n";
+    LiveChannelStats live_stats = live_channel_stats();
+    data += "<p>Live clients: " + String(live_stats.clients) + ", " + String(live_stats.frames_sent) + " frames sent, " + String(live_stats.frames_coalesced) + " coalesced, " + String(live_stats.clients_dropped) + " dropped</p>\n";
+    const LatencyMeter::Stats &intake = pipeline.stage<PIPELINE_LATENCY>().stats();
+    if (intake.fixes)
+    {
+        data += "<p>Fix intake: " + String(intake.fixes) + " fixes, latency last " + String(intake.last_ms) + " ms, mean " + String(intake.total_ms / intake.fixes) + " ms, max " + String(intake.max_ms) + " ms</p>\n";
+    }
+#ifdef TRACKER_TASKS
+    data += "<p>Queue drops: fixes " + String(gps_fixes.dropped()) + ", uplink " + String(uplink_fixes.dropped()) + ", modem " + String(modem_updates.dropped() + upload_results.dropped()) + "</p>\n";
+#endif
+    CellCacheStats cell_stats = cell_cache_stats();
+    CellVisit cell;
+    if (cell_cache_find(cell_stats.current_key, cell))
+    {
+        data += "<p>Cell " + String(cell.key) + ": " + String(cell.fixes) + " fixes, " + String(cell.dwell_s) + " s dwell; " + String(cell_stats.cells) + " cells cached</p>\n";
+    }
+    EnergyStats energy = energy_stats();
+    if (energy.today.elapsed_us)
+    {
+        uint32_t today_uah = energy_total_uah(energy.today);
+        data += "<p>Energy: " + String(today_uah / 1000.0, 1) + " mAh in " + String((uint32_t)(energy.today.elapsed_us / 60000000ULL)) + " min, " +
+                String(today_uah * (ENERGY_DAY_US / 1000000.0) / (energy.today.elapsed_us / 1000000.0) / 1000.0, 0) + " mAh/day at this rate</p>\n";
+    }
+#ifndef TRACKER_TASKS
+    GovernorStats governor = governor_stats();
+    uint64_t governed_us = governor.speed_us[CPU_80MHZ] + governor.speed_us[CPU_160MHZ];
+    if (governed_us)
+    {
+        data += "<p>CPU clock: " + String(governor_mhz(governor_speed())) + " MHz, load " + String(governor.load_percent) + "%; " +
+                String((uint32_t)(governor.speed_us[CPU_80MHZ] / 1000000ULL)) + " s at 80 MHz, " + String((uint32_t)(governor.speed_us[CPU_160MHZ] / 1000000ULL)) +
+                " s at 160 MHz (" + String(100.0 * governor.speed_us[CPU_160MHZ] / governed_us, 1) + "%), " + String(governor.switches) + " switches, " +
+                String(governor.deferred) + " deferred</p>\n";
+    }
+#endif
+    GpsdStats gpsd = gpsd_stats();
+    if (gpsd.connections)
+    {
+        data += "<p>gpsd: " + String(gpsd.clients) + " clients, " + String(gpsd.connections) + " connections, " + String(gpsd.clients_dropped) + " dropped behind, " + String(gpsd.bytes_sent) + " bytes sent</p>\n";
+    }
+    ArchiveStats archive = track_archive_stats();
+    if (archive.records)
+    {
+        data += "<p>Archive: " + String(archive.records) + " fixes in " + String(archive.stored_bytes) + " bytes (" + String(archive.pending) + " pending, " + String(archive.restored) + " restored from the journal), " + String(archive.blocks) + " blocks, " + String(archive.sectors) + " sectors (" + String(archive.free_sectors) + " free), " + String(archive.thinned) + " fixes thinned from " + String(archive.decimations) + " sectors</p>\n";
+    }
+    RecorderStats recorder = recorder_stats();
+    data += "<p>Recorder: boot " + String(recorder.boot) + ", " + String(recorder.logged_bytes) + " bytes logged, " + String(recorder.stored_bytes) + " bytes in " + String(recorder.blocks) + " blocks</p>\n";
+    RouteStatus route = route_status();
+    if (route.loaded)
+    {
+        data += "<p>Route: " + String(route.progress_m) + " of " + String(route.length_m) + " m, " + String(route.cross_track_m) + " m off track" + (route.on_route ? "" : " (DEVIATED)") + "</p>\n";
+    }
+    LiveSessionStats session = live_session_stats();
+    if (live_session_active())
+    {
+        data += "<p>Live session: " + String(session.remaining_s) + " s left</p>\n";
+    }
+    if (session.fixes)
+    {
+        data += "<p>Live latency: last " + String(session.latency_last) + " ms, min " + String(session.latency_min) + " ms, mean " + String(session.latency_total / session.fixes) + " ms, max " + String(session.latency_max) + " ms over " + String(session.fixes) + " fixes</p>\n";
+    }
+    if (network_shown.targeted + network_shown.scanned + network_shown.failures)
+    {
+        data += "<p>Network attach: last " + String(network_shown.last_ms) + " ms (" + (network_shown.last_targeted ? "targeted" : "full scan") + "); targeted " +
+                String(network_shown.targeted) + " x, mean " + String(network_shown.targeted ? network_shown.targeted_ms / network_shown.targeted : 0) + " ms; full scan " +
+                String(network_shown.scanned) + " x, mean " + String(network_shown.scanned ? network_shown.scanned_ms / network_shown.scanned : 0) + " ms; " +
+                String(network_shown.fallbacks) + " fallbacks, " + String(network_shown.failures) + " failed</p>\n";
+    }
+    if (upload_events.has_last())
+    {
+        data += "<p>Last upload: HTTP " + String(upload_events.last().http_status) + " in " + String(upload_events.last().duration_ms) + " ms</p>\n";
+    }
+    String health;
+    for (uint8_t i = 0; i < HEALTH_SUBSYSTEMS; i++)
+    {
+        HealthStats subsystem = health_stats((HealthSubsystem)i);
+        if (subsystem.restarts)
+        {
+            health += String(health.length() ? ", " : "") + health_subsystem_name((HealthSubsystem)i) + " " + String(subsystem.restarts) + " restarts, " +
+                      String(subsystem.recoveries) + " recovered in " + String(subsystem.recoveries ? (uint32_t)(subsystem.total_recovery_ms / subsystem.recoveries) : 0) + " ms mean" +
+                      (subsystem.state == HEALTH_OK ? "" : subsystem.state == HEALTH_FAILED ? " (FAILED)" : " (RECOVERING)");
+        }
+    }
+    if (health.length())
+    {
+        data += "<p>Health: " + health + "</p>\n";
+    }
+    ResponseCacheStats cache = response_cache_stats();
+    data += "<p>Page cache: " + String(cache.hits) + " hits (" + String(cache.gzip_hits) + " gzip, " + String(cache.bytes_saved) + " bytes saved), " + String(cache.renders) + " renders</p>\n";
 
-    server.send(200, "text/html", SendHTML(data));
+    send_rendered(CACHED_STATUS, SendHTML(data));
 }
 
 String SendHTML(String _body)
@@ -318,11 +1249,15 @@ void handle_OnConnect()
 
 void display_logs()
 {
+    if (send_cached(CACHED_LOGS))
+    {
+        return;
+    }
     String body = "<h1>Serial logs</h1>\n";
     body += "<div style=\"margin:8px 4px;border:1px solid red; padding: 4px\">\n";
     body += "<p>" + String(msgStream) + "</p>";
     body += "</div>\n";
-    server.send(200, "text/html", SendHTML(body));
+    send_rendered(CACHED_LOGS, SendHTML(body));
 }
 
 void sys_restart()
@@ -330,9 +1265,19 @@ void sys_restart()
     Serial.println("Restarting system");
     WiFi.disconnect();
     WiFi.mode(WIFI_OFF);
+    energy_enter(ENERGY_AP_OFF);
     server.send(200, "text/html", SendHTML("Restarting ..."));
-
     delay(5000);
+    mcu_restart();
+}
+
+/**
+ * @brief - save what is buffered for flash and restart the MCU
+ */
+void mcu_restart()
+{
+    track_archive_flush();
+    recorder_flush();
     ESP.restart();
     // should not be reached
     while (true)
@@ -340,6 +1285,490 @@ void sys_restart()
         yield();
     }
 }
+
+/**
+ * @brief - health supervisor: the restarts did not bring a subsystem back. Restart the
+ * tracker unless the last HEALTH_MAX_ESCALATIONS full restarts did not help either; a missing
+ * receiver or dead modem would otherwise keep it rebooting
+ * @return false to leave the subsystem failed and keep running
+ */
+bool escalate_restart(HealthSubsystem subsystem)
+{
+    if (__atomic_load_n(&health_escalations, __ATOMIC_RELAXED) >= HEALTH_MAX_ESCALATIONS)
+    {
+        Serial.println(String(health_subsystem_name(subsystem)) + " did not recover, leaving it failed");
+        return false;
+    }
+    // The HTTP context owns the config store and the flash buffers mcu_restart() saves
+    __atomic_store_n(&escalation_request, (uint8_t)(subsystem + 1), __ATOMIC_RELEASE);
+    return true;
+}
+
+/**
+ * @brief - run a requested full restart, counting it in the config store, and forget the
+ * count once every subsystem has been healthy for HEALTH_STABLE_MS
+ */
+void service_escalation()
+{
+    uint8_t request = __atomic_load_n(&escalation_request, __ATOMIC_ACQUIRE);
+    if (request)
+    {
+        Serial.println("Restarting system, " + String(health_subsystem_name((HealthSubsystem)(request - 1))) + " did not recover");
+        uint8_t escalations = health_escalations + 1;
+        config_set("health_esc", &escalations, sizeof(escalations));
+        mcu_restart();
+    }
+    if (!health_escalations || millis() < HEALTH_STABLE_MS)
+    {
+        return;
+    }
+    for (uint8_t i = 0; i < HEALTH_SUBSYSTEMS; i++)
+    {
+        if (health_stats((HealthSubsystem)i).state != HEALTH_OK)
+        {
+            return;
+        }
+    }
+    __atomic_store_n(&health_escalations, (uint8_t)0, __ATOMIC_RELAXED);
+    config_remove("health_esc");
+}
+
+/**
+ * @brief - health supervisor: reset and attach the modem again, leaving Wi-Fi and the GPS alone
+ * @return true if the modem answered the last bring-up command
+ */
+bool restart_modem()
+{
+    modem_begin();
+    return modem_replied;
+}
+
+/**
+ * @brief - health supervisor: begin the GPS port again and restart the receiver's GNSS, which
+ * keeps its configuration and ephemeris
+ * @return false, it has recovered once a burst decodes
+ */
+bool restart_gps()
+{
+    GPS_Serial.end();
+#if defined(ARDUINO_ARCH_ESP32)
+    GPS_Serial.begin(9600, SERIAL_8N1, GPS_TXD, GPS_RXD);
+#else
+    GPS_Serial.begin(9600);
+#endif
+    ubx_reset_gnss(GPS_Serial);
+    return false;
+}
+
+/**
+ * @brief - health supervisor: the soft AP still has its address and, every
+ * WEB_PROBE_CONNECT_MS, the web server still accepts connections. A handler that never
+ * returns holds up the probe too and is left to the watchdog
+ */
+bool probe_web()
+{
+    static unsigned long connected_ms = 0;
+    if (WiFi.softAPIP() != local_ip)
+    {
+        return false;
+    }
+    if (millis() - connected_ms < WEB_PROBE_CONNECT_MS)
+    {
+        return true;
+    }
+    connected_ms = millis();
+    return web_listening();
+}
+
+/**
+ * @brief - connect to the web server over the soft AP address. The stack completes the
+ * handshake for a listening socket without the server running; the connection is closed
+ * before the server reads it
+ */
+bool web_listening()
+{
+    WiFiClient client;
+    client.setTimeout(WEB_PROBE_TIMEOUT_MS);
+    bool accepted = client.connect(local_ip, 80);
+    client.stop();
+    return accepted;
+}
+
+/**
+ * @brief - health supervisor: restart the web server, and the soft AP if it lost its address
+ */
+bool restart_web()
+{
+    server.stop();
+    if (!probe_web())
+    {
+        WiFi.softAP(ssid, password, 1, 0, HTTP_MAX_STATIONS);
+        WiFi.softAPConfig(local_ip, gateway, subnet);
+        energy_enter(ENERGY_AP_ON);
+    }
+    server.begin();
+    return WiFi.softAPIP() == local_ip && web_listening();
+}
+void load_config()
+{
+    if (!config_begin())
+    {
+        Serial.println("Config store unavailable, using defaults");
+    }
+    config_get_string("ap_ssid", ssid, sizeof(ssid), AP_SSID);
+    config_get_string("ap_pwd", password, sizeof(password), AP_PWD);
+    config_get_string("cloud_url", CLOUD_URL, sizeof(CLOUD_URL), FIREBASE_URL);
+    // Saved before a state was appended, the values cover the states that existed then
+    uint32_t currents[ENERGY_STATES];
+    int length = config_get("energy_ua", currents, sizeof(currents));
+    for (int state = 0; state < length / (int)sizeof(currents[0]); state++)
+    {
+        energy_set_current((EnergyState)state, currents[state]);
+    }
+    if (config_get("net_sel", &network_selection, sizeof(network_selection)) != sizeof(network_selection))
+    {
+        network_selection = {};
+    }
+    if (config_get("net_bands", &network_bands, sizeof(network_bands)) != sizeof(network_bands))
+    {
+        network_bands = {};
+    }
+    if (config_get("net_stats", &network_stats, sizeof(network_stats)) != sizeof(network_stats))
+    {
+        network_stats = {};
+    }
+    network_shown = network_stats;
+    if (config_get("health_esc", &health_escalations, sizeof(health_escalations)) != sizeof(health_escalations))
+    {
+        health_escalations = 0;
+    }
+}
+
+/**
+ * @brief - text safe to put in a page, quotes included so it can go in an attribute too
+ */
+String html_escape(const String &text)
+{
+    String escaped;
+    escaped.reserve(text.length());
+    for (size_t i = 0; i < text.length(); i++)
+    {
+        char c = text[i];
+        switch (c)
+        {
+        case '&':
+            escaped += "&amp;";
+            break;
+        case '<':
+            escaped += "&lt;";
+            break;
+        case '>':
+            escaped += "&gt;";
+            break;
+        case '"':
+            escaped += "&quot;";
+            break;
+        case '\'':
+            escaped += "&#39;";
+            break;
+        default:
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+/**
+ * @brief - check a value for one of the keys /config may set
+ * @return nullptr if it may be saved, otherwise why not
+ */
+const char *config_value_error(const String &key, const String &value)
+{
+    struct Setting
+    {
+        const char *key;
+        size_t min_length;
+        size_t max_length; // what the buffer it is loaded into holds
+    };
+    static const Setting SETTINGS[] = {
+        {"ap_ssid", 1, sizeof(ssid) - 1},
+        {"ap_pwd", 8, 63}, // WPA2 passphrase
+        {"cloud_url", 8, sizeof(CLOUD_URL) - 1},
+    };
+    const Setting *setting = nullptr;
+    for (const Setting &candidate : SETTINGS)
+    {
+        if (key == candidate.key)
+        {
+            setting = &candidate;
+        }
+    }
+    if (!setting)
+    {
+        return "unknown key";
+    }
+    if (value.length() < setting->min_length || value.length() > setting->max_length)
+    {
+        return "wrong length";
+    }
+    for (size_t i = 0; i < value.length(); i++)
+    {
+        // The values end up in AT commands and quoted strings
+        if (value[i] < 0x20 || value[i] > 0x7e || value[i] == '"')
+        {
+            return "unprintable character or quote";
+        }
+    }
+    if (key == "cloud_url")
+    {
+        int host = value.startsWith("https://") ? 8 : value.startsWith("http://") ? 7 : -1;
+        if (host < 0 || (int)value.length() == host || value[host] == '/' || value.indexOf(" ") >= 0)
+        {
+            return "not an http or https URL with a host";
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * @brief - show the config store, or update a key with /config?key=...&value=...
+ * Changes take effect after a restart
+ */
+void handle_config()
+{
+    String body = "<h1>Config</h1>\n";
+    if (server.hasArg("key") && server.hasArg("value"))
+    {
+        String key = server.arg("key");
+        String value = server.arg("value");
+        const char *error = config_value_error(key, value);
+        if (error)
+        {
+            body += "<p>Invalid " + html_escape(key) + ": " + error + "</p>\n";
+            server.send(400, "text/html", SendHTML(body));
+            return;
+        }
+        bool saved = config_set_string(key.c_str(), value.c_str());
+        body += saved ? "<p>Saved " + html_escape(key) + ", restart to apply</p>\n" : "<p>Could not save " + html_escape(key) + "</p>\n";
+    }
+    ConfigStats stats = config_stats();
+    body += "<p>SSID: " + html_escape(ssid) + "</p>\n";
+    body += "<p>Cloud URL: " + html_escape(CLOUD_URL) + "</p>\n";
+    body += "<p>Store: " + String(stats.keys) + " keys, " + String(stats.used_bytes) + " bytes used, generation " + String(stats.generation) + "</p>\n";
+    server.send(200, "text/html", SendHTML(body));
+}
+
+/**
+ * @brief - start a live session with /live?duration=<seconds>, end it with /live?stop=1
+ */
+void handle_live()
+{
+    ControlEvent control;
+    control.command = server.hasArg("stop") ? CONTROL_STOP_LIVE : CONTROL_START_LIVE;
+    long duration = server.hasArg("duration") ? server.arg("duration").toInt() : LIVE_SESSION_DEFAULT_S;
+    control.duration_s = duration < 0 ? 0 : (duration > LIVE_SESSION_MAX_S ? LIVE_SESSION_MAX_S : duration);
+    control_events.publish(control);
+    String body = control.command == CONTROL_START_LIVE ? "<p>Live session started</p>\n" : "<p>Live session stopped</p>\n";
+    body += "<a href='/live?stop=1'>Stop</a>\n";
+    server.send(200, "text/html", SendHTML(body));
+}
+
+/**
+ * @brief - POST an encoded polyline to /route (optional ?corridor=<metres>) to set the planned
+ * route, /route?clear=1 to remove it, GET to see progress
+ */
+void handle_route()
+{
+    String body = "<h1>Route</h1>\n";
+    if (server.hasArg("clear"))
+    {
+        route_clear();
+        body += "<p>Route cleared</p>\n";
+    }
+    else if (server.method() == HTTP_POST && server.hasArg("plain"))
+    {
+        long corridor = server.hasArg("corridor") ? server.arg("corridor").toInt() : ROUTE_DEFAULT_CORRIDOR_M;
+        const String &polyline = server.arg("plain");
+        bool saved = corridor > 0 && corridor < 65536 && route_set(polyline.c_str(), polyline.length(), corridor);
+        body += saved ? "<p>Route saved</p>\n" : "<p>Invalid route</p>\n";
+    }
+    RouteStatus route = route_status();
+    if (route.loaded)
+    {
+        body += "<p>" + String(route.points) + " points, " + String(route.length_m) + " m, corridor " + String(route.corridor_m) + " m</p>\n";
+        body += "<p>Progress: " + String(route.progress_m) + " m, segment " + String(route.segment) + ", cross track " + String(route.cross_track_m) + " m</p>\n";
+        body += "<p>Matched near cursor: " + String(route.cursor_hits) + ", index lookups: " + String(route.index_lookups) + "</p>\n";
+    }
+    else
+    {
+        body += "<p>No route loaded</p>\n";
+    }
+    server.send(200, "text/html", SendHTML(body));
+}
+
+/**
+ * @brief - time and charge per power state for today and yesterday. /energy?state=<name>&ua=<uA>
+ * sets and saves the current of a state, /energy?trace=1 downloads the trace for
+ * tools/energy_replay.cpp
+ */
+void handle_energy()
+{
+    if (server.hasArg("trace"))
+    {
+        String csv = "ms,event,moved,cpu_ms\n";
+        EnergyTraceEntry entries[16];
+        size_t first = 0;
+        for (size_t count; (count = energy_trace(first, entries, 16)) > 0; first += count)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                const EnergyTraceEntry &entry = entries[i];
+                csv += String(entry.ms) + ",";
+                csv += entry.kind == ENERGY_TRACE_FIX ? "fix," + String(entry.moved) + "," + String(entry.cpu_ms) + "\n"
+                                                      : String(energy_state_name((EnergyState)entry.kind)) + ",,\n";
+            }
+        }
+        server.send(200, "text/csv", csv);
+        return;
+    }
+
+    String body = "<h1>Energy</h1>\n";
+    EnergyState state;
+    if (server.hasArg("state") && server.hasArg("ua"))
+    {
+        bool saved = false;
+        long current = server.arg("ua").toInt();
+        if (energy_state_from_name(server.arg("state").c_str(), state) && current >= 0)
+        {
+            energy_set_current(state, current);
+            uint32_t currents[ENERGY_STATES];
+            for (uint8_t i = 0; i < ENERGY_STATES; i++)
+            {
+                currents[i] = energy_current((EnergyState)i);
+            }
+            saved = config_set("energy_ua", currents, sizeof(currents));
+        }
+        body += saved ? "<p>Current saved</p>\n" : "<p>Could not save current</p>\n";
+    }
+    EnergyStats energy = energy_stats();
+    body += "<table><tr><th>State</th><th>Current (mA)</th><th>Today (s)</th><th>Today (mAh)</th><th>Yesterday (mAh)</th></tr>\n";
+    for (uint8_t i = 0; i < ENERGY_STATES; i++)
+    {
+        state = (EnergyState)i;
+        body += "<tr><td>" + String(energy_state_name(state)) + "</td><td>" + String(energy_current(state) / 1000.0, 1) + "</td><td>" +
+                String((uint32_t)(energy.today.state_us[state] / 1000000ULL)) + "</td><td>" + String(energy_charge_uah(energy.today, state) / 1000.0, 1) +
+                "</td><td>" + String(energy_charge_uah(energy.yesterday, state) / 1000.0, 1) + "</td></tr>\n";
+    }
+    body += "</table>\n";
+    body += "<p>Today: " + String(energy_total_uah(energy.today) / 1000.0, 1) + " mAh in " + String((uint32_t)(energy.today.elapsed_us / 1000000ULL)) + " s";
+    body += energy.days ? ", yesterday: " + String(energy_total_uah(energy.yesterday) / 1000.0, 1) + " mAh</p>\n" : "</p>\n";
+    server.send(200, "text/html", SendHTML(body));
+}
+
+/**
+ * @brief - flight recorder status, or with ?download the stored capture for tools/flight_replay.cpp
+ */
+void handle_recorder()
+{
+    if (server.hasArg("download"))
+    {
+        recorder_flush();
+        server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+        server.sendHeader("Content-Disposition", "attachment; filename=\"recorder.bin\"");
+        server.send(200, "application/octet-stream", "");
+        uint8_t chunk[512];
+        uint32_t offset = 0;
+        for (size_t length; (length = recorder_read(offset, chunk, sizeof(chunk))) > 0; offset += length)
+        {
+            server.sendContent((const char *)chunk, length);
+        }
+        server.sendContent("");
+        return;
+    }
+    RecorderStats recorder = recorder_stats();
+    String body = "<h1>Flight recorder</h1>\n";
+    body += "<p>Boot " + String(recorder.boot) + ": " + String(recorder.logged_bytes) + " bytes logged, " + String(recorder.pending) + " pending, " + String(recorder.dropped_bytes) + " dropped</p>\n";
+    body += "<p>Stored: " + String(recorder.blocks) + " blocks, " + String(recorder.stored_bytes) + " bytes of " + String((uint32_t)recorder.sectors * FLASH_SECTOR_SIZE) + "</p>\n";
+    body += "<p><a href=\"/recorder?download=1\">Download capture</a></p>\n";
+    server.send(200, "text/html", SendHTML(body));
+}
+
+bool bench_decode(const char *burst, GpsFix &fix, void *ctx)
+{
+    return ((NmeaParser *)ctx)->decode(burst, fix);
+}
+
+bool bench_decode_tinygps(const char *burst, GpsFix &fix, void *ctx)
+{
+    return tinygps_encode(*(TinyGPSPlus *)ctx, burst, fix);
+}
+
+/**
+ * @brief - report cycles per NMEA sentence through the intake path, with warm and cold cache,
+ * against TinyGPSPlus, and per call for the geodesy kernels against libm
+ */
+void handle_bench()
+{
+    // Separate decoders keep the live receiver state out of the benchmark
+    static NmeaParser bench_parser;
+    static TinyGPSPlus bench_gps;
+    BenchResult result = bench_nmea(bench_decode, &bench_parser, REPLAY_TRACK, REPLAY_TRACK_LENGTH, 20);
+    BenchResult reference = bench_nmea(bench_decode_tinygps, &bench_gps, REPLAY_TRACK, REPLAY_TRACK_LENGTH, 20);
+    String body = "<h1>Benchmark</h1>\n";
+    body += "<p>CPU: " + String(ESP.getCpuFreqMHz()) + " MHz, hot path placement: " HOT_PATH_PLACEMENT "</p>\n";
+    body += "<p>Sentences: " + String(result.sentences) + "</p>\n";
+    body += "<p>Cycles per sentence (warm cache): " + String(result.warm_cycles) + ", TinyGPSPlus " + String(reference.warm_cycles) + "</p>\n";
+    body += "<p>Cycles per sentence (cold cache): " + String(result.cold_cycles) + ", TinyGPSPlus " + String(reference.cold_cycles) + "</p>\n";
+
+    // Differential check of the two decoders over the recorded track
+    NmeaParser check_parser;
+    TinyGPSPlus check_gps;
+    uint32_t mismatches = 0;
+    for (size_t i = 0; i < REPLAY_TRACK_LENGTH; i++)
+    {
+        GpsFix fix = {}, reference_fix = {};
+        bool valid = check_parser.decode(REPLAY_TRACK[i], fix);
+        if (valid != tinygps_encode(check_gps, REPLAY_TRACK[i], reference_fix) || (valid && !same_fix(fix, reference_fix)))
+        {
+            mismatches++;
+        }
+    }
+    body += "<p>Decoder mismatches against TinyGPSPlus: " + String(mismatches) + " of " + String(REPLAY_TRACK_LENGTH) + " bursts";
+#ifdef NMEA_DIFF_CHECK
+    body += ", live " + String(nmea_diff_mismatches) + " of " + String(nmea_diff_checked);
+#endif
+    body += "</p>\n";
+
+    GeoBenchResult geo = bench_geo(512);
+    body += "<h2>Geodesy kernels</h2>\n<table><tr><th>Kernel</th><th>Fixed-point cycles</th><th>libm cycles</th></tr>\n";
+    for (uint8_t kernel = 0; kernel < GEO_BENCH_KERNELS; kernel++)
+    {
+        body += "<tr><td>" + String(geo_kernel_name((GeoKernel)kernel)) + "</td><td>" + String(geo.fixed_cycles[kernel]) +
+                "</td><td>" + String(geo.libm_cycles[kernel]) + "</td></tr>\n";
+    }
+    body += "</table>\n";
+
+    SpatialBenchResult spatial = bench_spatial(512);
+    body += "<h2>Cell keys</h2>\n";
+    body += "<p>Geohash: " + String(spatial.geohash_cycles) + " cycles interleaved, " + String(spatial.geohash_bisect_cycles) + " by bisection</p>\n";
+    body += "<p>Hilbert: " + String(spatial.hilbert_cycles) + " cycles by prefix scan, " + String(spatial.hilbert_iterative_cycles) + " iterative</p>\n";
+    server.send(200, "text/html", SendHTML(body));
+}
+
+/**
+ * @brief - run a page handler if the client is within its request rate, otherwise answer 429
+ */
+void admit(void (*handler)())
+{
+    if (!http_admit(server.client().remoteIP(), millis()))
+    {
+        server.sendHeader("Retry-After", "1");
+        server.send(429, "text/plain", "Too many requests");
+        return;
+    }
+    handler();
+}
+
 void handle_NotFound()
 {
     server.send(404, "text/plain", "Not found");
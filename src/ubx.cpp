@@ -0,0 +1,51 @@
+/**
+ * @file ubx.cpp
+ * @brief UBX configuration messages, see ubx.h
+ */
+
+#include "flight_recorder.h"
+#include "ubx.h"
+
+void ubx_send(Stream &port, uint8_t msg_class, uint8_t msg_id, const uint8_t *payload, uint16_t length)
+{
+    uint8_t header[6] = {0xB5, 0x62, msg_class, msg_id, (uint8_t)(length & 0xFF), (uint8_t)(length >> 8)};
+    uint8_t ck_a = 0, ck_b = 0;
+    for (uint8_t i = 2; i < sizeof(header); i++)
+    {
+        ck_a += header[i];
+        ck_b += ck_a;
+    }
+    for (uint16_t i = 0; i < length; i++)
+    {
+        ck_a += payload[i];
+        ck_b += ck_a;
+    }
+    port.write(header, sizeof(header));
+    port.write(payload, length);
+    port.write(ck_a);
+    port.write(ck_b);
+    uint8_t checksum[2] = {ck_a, ck_b};
+    recorder_log(RECORDER_GPS_TX, header, sizeof(header));
+    recorder_log(RECORDER_GPS_TX, payload, length);
+    recorder_log(RECORDER_GPS_TX, checksum, sizeof(checksum));
+}
+
+void ubx_set_rate(Stream &port, uint16_t period_ms)
+{
+    // measRate, navRate = 1 cycle, timeRef = GPS time
+    uint8_t payload[6] = {(uint8_t)(period_ms & 0xFF), (uint8_t)(period_ms >> 8), 1, 0, 1, 0};
+    ubx_send(port, UBX_CLASS_CFG, UBX_CFG_RATE, payload, sizeof(payload));
+}
+
+void ubx_set_nmea_rate(Stream &port, uint8_t nmea_id, uint8_t rate)
+{
+    uint8_t payload[3] = {NMEA_CLASS, nmea_id, rate};
+    ubx_send(port, UBX_CLASS_CFG, UBX_CFG_MSG, payload, sizeof(payload));
+}
+
+void ubx_reset_gnss(Stream &port)
+{
+    // navBbrMask 0 = hot start, resetMode 2 = controlled software reset of the GNSS only
+    uint8_t payload[4] = {0x00, 0x00, 0x02, 0x00};
+    ubx_send(port, UBX_CLASS_CFG, UBX_CFG_RST, payload, sizeof(payload));
+}
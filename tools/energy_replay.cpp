@@ -0,0 +1,312 @@
+/**
+ * @file energy_replay.cpp
+ * @brief Predict battery life for other sampling and upload policies from a device energy trace
+ *
+ * Takes the CSV from /energy?trace=1 and rebuilds the timeline it covers under a new policy:
+ *  - fixes are read every --sample seconds, each costing the CPU time a fix cost on the device,
+ *    and inherit the moved flag of the recorded fix at that time; that CPU time runs at the
+ *    clock the governor had chosen then (cpu_active or cpu_fast), as recorded
+ *  - a moved fix is uploaded if --upload-interval seconds have passed since the last upload,
+ *    each upload holding the modem in TX, and the blocked CPU active, for the recorded mean
+ *  - modem attach, AP and GPS transitions are replayed as recorded; --no-ap drops the AP
+ * The timeline runs through the firmware's own accounting in src/energy.cpp, so currents and
+ * states match the device; --current <state>=<uA> overrides a figure as /energy does.
+ *
+ * Build and run from the repository root:
+ *     g++ -O2 -std=c++17 -Iinclude tools/energy_replay.cpp src/energy.cpp src/events.cpp -o energy_replay
+ *     ./energy_replay trace.csv [--sample 30] [--upload-interval 300] [--no-ap] [--battery 3000]
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "energy.h"
+
+#define MAX_CLOCK_STEP_US 600000000ULL // keep the 32-bit clock from wrapping between updates
+
+struct RecordedFix
+{
+    uint64_t us;
+    bool moved;
+    uint32_t cpu_ms;
+};
+
+struct Upload
+{
+    uint64_t start_us;
+    uint64_t length_us;
+};
+
+struct Transition
+{
+    uint64_t us;
+    EnergyState state;
+};
+
+static uint64_t sim_us = 0;
+
+static uint32_t sim_clock()
+{
+    return (uint32_t)sim_us;
+}
+
+/**
+ * @brief - parse a trace, splitting uploads (modem_tx up to the next modem state) and CPU
+ * clock changes from the other transitions
+ */
+static bool load_trace(const char *path, std::vector<RecordedFix> &fixes, std::vector<Transition> &transitions, std::vector<Upload> &uploads,
+                       std::vector<Transition> &speeds)
+{
+    FILE *file = std::fopen(path, "r");
+    if (!file)
+    {
+        return false;
+    }
+    char line[128];
+    uint64_t upload_started = 0;
+    bool uploading = false;
+    while (std::fgets(line, sizeof(line), file))
+    {
+        char event[32] = {};
+        unsigned long ms = 0, moved = 0, cpu_ms = 0;
+        if (std::sscanf(line, "%lu,%31[^,],%lu,%lu", &ms, event, &moved, &cpu_ms) < 2)
+        {
+            continue; // header or blank
+        }
+        uint64_t us = (uint64_t)ms * 1000;
+        EnergyState state;
+        if (!std::strcmp(event, "fix"))
+        {
+            fixes.push_back({us, moved != 0, (uint32_t)cpu_ms});
+        }
+        else if (energy_state_from_name(event, state))
+        {
+            if (uploading && energy_rail(state) == ENERGY_RAIL_MODEM)
+            {
+                uploads.push_back({upload_started, us - upload_started});
+                uploading = false;
+            }
+            if (state == ENERGY_MODEM_TX)
+            {
+                upload_started = us;
+                uploading = true;
+                continue;
+            }
+            if (energy_rail(state) == ENERGY_RAIL_CPU)
+            {
+                speeds.push_back({us, state});
+                continue;
+            }
+            transitions.push_back({us, state});
+        }
+    }
+    std::fclose(file);
+    return true;
+}
+
+/**
+ * @brief - the active CPU state at a time, cpu_active before the first recorded clock change
+ */
+static EnergyState speed_at(const std::vector<Transition> &speeds, uint64_t us)
+{
+    EnergyState state = ENERGY_CPU_ACTIVE;
+    for (const Transition &speed : speeds)
+    {
+        if (speed.us > us)
+        {
+            break;
+        }
+        state = speed.state;
+    }
+    return state;
+}
+
+static double median(std::vector<double> values)
+{
+    if (values.empty())
+    {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+int main(int argc, char **argv)
+{
+    const char *trace_path = nullptr;
+    double sample_s = 0, upload_interval_s = 0, battery_mah = 2000;
+    bool no_ap = false;
+    for (int i = 1; i < argc; i++)
+    {
+        EnergyState state;
+        if (!std::strcmp(argv[i], "--sample") && i + 1 < argc)
+        {
+            sample_s = std::atof(argv[++i]);
+        }
+        else if (!std::strcmp(argv[i], "--upload-interval") && i + 1 < argc)
+        {
+            upload_interval_s = std::atof(argv[++i]);
+        }
+        else if (!std::strcmp(argv[i], "--battery") && i + 1 < argc)
+        {
+            battery_mah = std::atof(argv[++i]);
+        }
+        else if (!std::strcmp(argv[i], "--no-ap"))
+        {
+            no_ap = true;
+        }
+        else if (!std::strcmp(argv[i], "--current") && i + 1 < argc)
+        {
+            std::string setting = argv[++i];
+            size_t equals = setting.find('=');
+            if (equals == std::string::npos || !energy_state_from_name(setting.substr(0, equals).c_str(), state))
+            {
+                std::fprintf(stderr, "bad --current %s\n", setting.c_str());
+                return 2;
+            }
+            energy_set_current(state, std::strtoul(setting.c_str() + equals + 1, nullptr, 10));
+        }
+        else
+        {
+            trace_path = argv[i];
+        }
+    }
+    std::vector<RecordedFix> fixes;
+    std::vector<Transition> transitions;
+    std::vector<Upload> recorded_uploads;
+    std::vector<Transition> speeds;
+    if (!trace_path || !load_trace(trace_path, fixes, transitions, recorded_uploads, speeds) || fixes.size() < 2)
+    {
+        std::fprintf(stderr, "usage: %s trace.csv [--sample s] [--upload-interval s] [--no-ap] [--battery mAh] [--current state=uA]\n"
+                             "the trace needs at least two fixes\n",
+                     argv[0]);
+        return 2;
+    }
+
+    // Per-fix CPU cost and upload length as measured, from fix intervals without an upload
+    std::vector<double> spacing, fix_cpu, upload_s;
+    for (size_t i = 1; i < fixes.size(); i++)
+    {
+        spacing.push_back((fixes[i].us - fixes[i - 1].us) / 1e6);
+        bool upload_between = std::any_of(recorded_uploads.begin(), recorded_uploads.end(), [&](const Upload &upload)
+                                          { return upload.start_us >= fixes[i - 1].us && upload.start_us < fixes[i].us; });
+        if (!upload_between)
+        {
+            fix_cpu.push_back(fixes[i].cpu_ms / 1e3);
+        }
+    }
+    for (const Upload &upload : recorded_uploads)
+    {
+        upload_s.push_back(upload.length_us / 1e6);
+    }
+    double recorded_sample_s = median(spacing);
+    double cpu_per_fix_s = std::min(median(fix_cpu), recorded_sample_s);
+    double upload_length_s = median(upload_s);
+    if (sample_s <= 0)
+    {
+        sample_s = recorded_sample_s;
+    }
+    uint64_t start_us = fixes.front().us, end_us = fixes.back().us;
+    std::printf("trace: %.0f s, %zu fixes every %.1f s, %.2f s CPU per fix, %zu uploads of %.1f s\n",
+                (end_us - start_us) / 1e6, fixes.size(), recorded_sample_s, cpu_per_fix_s, recorded_uploads.size(), upload_length_s);
+
+    // Rebuild the timeline under the policy
+    std::vector<Transition> timeline;
+    for (const Transition &transition : transitions)
+    {
+        if (transition.us >= start_us && transition.us <= end_us && !(no_ap && energy_rail(transition.state) == ENERGY_RAIL_AP))
+        {
+            timeline.push_back(transition);
+        }
+    }
+    // Initial states: whatever the last recorded transition before the window left each rail in
+    for (const Transition &transition : transitions)
+    {
+        if (transition.us < start_us && !(no_ap && energy_rail(transition.state) == ENERGY_RAIL_AP))
+        {
+            timeline.push_back({start_us, transition.state});
+        }
+    }
+    timeline.push_back({start_us, ENERGY_CPU_LIGHT_SLEEP});
+    size_t recorded = 0, uploads = 0, sampled = 0, fast = 0;
+    uint64_t last_upload_us = 0;
+    bool uploaded_once = false;
+    for (uint64_t us = start_us; us <= end_us; us += (uint64_t)(sample_s * 1e6))
+    {
+        while (recorded + 1 < fixes.size() && fixes[recorded + 1].us <= us)
+        {
+            recorded++;
+        }
+        uint64_t busy_until = us + (uint64_t)(cpu_per_fix_s * 1e6);
+        sampled++;
+        if (fixes[recorded].moved && (!uploaded_once || us - last_upload_us >= upload_interval_s * 1e6))
+        {
+            timeline.push_back({busy_until, ENERGY_MODEM_TX});
+            busy_until += (uint64_t)(upload_length_s * 1e6);
+            timeline.push_back({busy_until, ENERGY_MODEM_IDLE});
+            last_upload_us = us;
+            uploaded_once = true;
+            uploads++;
+        }
+        EnergyState speed = speed_at(speeds, us);
+        fast += speed == ENERGY_CPU_FAST;
+        timeline.push_back({us, speed});
+        timeline.push_back({busy_until, ENERGY_CPU_LIGHT_SLEEP});
+    }
+    std::stable_sort(timeline.begin(), timeline.end(), [](const Transition &a, const Transition &b) { return a.us < b.us; });
+
+    sim_us = start_us;
+    energy_begin(sim_clock);
+    if (!no_ap)
+    {
+        energy_enter(ENERGY_AP_ON); // the AP comes up in setup(), usually before the trace window
+    }
+    uint32_t days = 0;
+    uint64_t completed_uah = 0;
+    for (const Transition &transition : timeline)
+    {
+        while (sim_us < transition.us)
+        {
+            sim_us += std::min<uint64_t>(transition.us - sim_us, MAX_CLOCK_STEP_US);
+            energy_update();
+        }
+        energy_enter(transition.state);
+        EnergyStats stats = energy_stats();
+        if (stats.days != days)
+        {
+            completed_uah += energy_total_uah(stats.yesterday);
+            days = stats.days;
+        }
+    }
+    // The last fix's CPU time or upload may run past the final recorded fix
+    sim_us = std::max(sim_us, end_us);
+    energy_update();
+
+    EnergyStats stats = energy_stats();
+    double elapsed_s = (sim_us - start_us) / 1e6;
+    double per_day = 86400.0 / elapsed_s;
+    double total_mah = (completed_uah + energy_total_uah(stats.today)) / 1000.0;
+    std::printf("policy: fix every %.1f s (%zu fixes, %zu at 160 MHz), uploads at least %.0f s apart (%zu uploads)%s\n",
+                sample_s, sampled, fast, upload_interval_s, uploads, no_ap ? ", AP off" : "");
+    std::printf("%-16s %10s %10s %12s\n", "state", "mA", "h/day", "mAh/day");
+    for (uint8_t i = 0; i < ENERGY_STATES; i++)
+    {
+        EnergyState state = (EnergyState)i;
+        if (stats.today.state_us[state] == 0 || energy_current(state) == 0)
+        {
+            continue;
+        }
+        std::printf("%-16s %10.1f %10.2f %12.1f\n", energy_state_name(state), energy_current(state) / 1000.0,
+                    stats.today.state_us[state] / 3.6e9 * per_day, energy_charge_uah(stats.today, state) / 1000.0 * per_day);
+    }
+    if (days)
+    {
+        std::printf("(trace longer than a day: the rows above cover the last %.0f s only)\n", stats.today.elapsed_us / 1e6);
+    }
+    double mah_per_day = total_mah * per_day;
+    std::printf("total %.1f mAh/day, %.1f days on %.0f mAh\n", mah_per_day, battery_mah / mah_per_day, battery_mah);
+    return 0;
+}
@@ -0,0 +1,279 @@
+/**
+ * @file flight_replay.cpp
+ * @brief Decode a flight recorder download and replay the receiver input through the firmware
+ *
+ * Takes the file from /recorder?download=1 and, per boot it covers:
+ *  - prints a summary of each channel, or with --dump the whole serial transcript
+ *  - with --replay, feeds every receiver read through the firmware's own NmeaParser
+ *    (src/nmea.cpp) exactly as the device read it, printing the fixes as CSV and the parse
+ *    time per read; --repeat runs the parse that many times for steadier profiles
+ *  - with --extract <channel> <file>, writes the bytes of one channel back to back, e.g. for
+ *    piping into a serial port
+ * A read that straddled two recorder blocks is joined again before it is replayed.
+ *
+ * Build and run from the repository root:
+ *     g++ -O2 -std=c++17 -Iinclude tools/flight_replay.cpp src/flight_recorder.cpp src/flash_blocks.cpp src/nmea.cpp src/crc.cpp -o flight_replay
+ *     ./flight_replay recorder.bin [--boot n] [--dump] [--replay [--repeat n]] [--extract gps_rx out.nmea]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+#include "flash_layout.h"
+#include "flight_recorder.h"
+#include "nmea.h"
+
+/* The recorder's flash ring is not used here; only its block decoder is */
+uint32_t flash_region_sectors() { return 0; }
+bool flash_erase_sector(uint32_t) { return false; }
+bool flash_write(uint32_t, const void *, size_t) { return false; }
+bool flash_read(uint32_t, void *, size_t) { return false; }
+
+/**
+ * @brief One read or write on a link, joined back together if it was split across blocks
+ */
+struct Transfer
+{
+    uint32_t boot;
+    uint32_t ms;
+    RecorderChannel channel;
+    std::string data;
+};
+
+static void collect(const RecorderEntry &entry, void *ctx)
+{
+    std::vector<Transfer> &transfers = *(std::vector<Transfer> *)ctx;
+    std::string data((const char *)entry.data, entry.length);
+    if (!transfers.empty())
+    {
+        Transfer &last = transfers.back();
+        if (last.boot == entry.boot && last.channel == entry.channel && last.ms == entry.ms)
+        {
+            last.data += data;
+            return;
+        }
+    }
+    transfers.push_back({entry.boot, entry.ms, entry.channel, data});
+}
+
+static bool channel_from_name(const char *name, RecorderChannel &channel)
+{
+    for (uint8_t i = 0; i < RECORDER_CHANNELS; i++)
+    {
+        if (!std::strcmp(name, recorder_channel_name((RecorderChannel)i)))
+        {
+            channel = (RecorderChannel)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void print_escaped(const std::string &data)
+{
+    for (unsigned char c : data)
+    {
+        if (c == '\r')
+        {
+            std::fputs("\\r", stdout);
+        }
+        else if (c == '\n')
+        {
+            std::fputs("\\n", stdout);
+        }
+        else if (c < 0x20 || c >= 0x7F || c == '\\')
+        {
+            std::printf("\\x%02x", c);
+        }
+        else
+        {
+            std::putchar(c);
+        }
+    }
+    std::putchar('\n');
+}
+
+/**
+ * @brief - run the receiver reads of one boot through a fresh parser, as the device did
+ */
+static void replay(const std::vector<Transfer> &transfers, uint32_t boot, unsigned repeat)
+{
+    NmeaParser parser;
+    std::vector<double> parse_ns;
+    size_t reads = 0, fixes = 0;
+    std::printf("boot,ms,utc,lat,lng,hdop,sats,speed,course\n");
+    for (const Transfer &transfer : transfers)
+    {
+        if (transfer.boot != boot || transfer.channel != RECORDER_GPS_RX)
+        {
+            continue;
+        }
+        // The device decodes the null terminated read buffer
+        const char *burst = transfer.data.c_str();
+        GpsFix fix = {};
+        NmeaParser before = parser;
+        auto started = std::chrono::steady_clock::now();
+        bool valid = parser.decode(burst, fix);
+        for (unsigned i = 1; i < repeat; i++)
+        {
+            // Extra passes run on a copy of the state before the read, leaving the replay as it was
+            NmeaParser scratch = before;
+            GpsFix discard;
+            scratch.decode(burst, discard);
+        }
+        auto elapsed = std::chrono::steady_clock::now() - started;
+        parse_ns.push_back(std::chrono::duration<double, std::nano>(elapsed).count() / repeat);
+        reads++;
+        if (valid)
+        {
+            fixes++;
+            std::printf("%u,%u,%u,%.7f,%.7f,%.2f,%u,%.2f,%.2f\n", boot, transfer.ms, fix.utc, fix.lat_e7 / 1e7, fix.lng_e7 / 1e7,
+                        fix.hdop / 100.0, fix.sats, fix.speed / 100.0, fix.course / 100.0);
+        }
+    }
+    if (parse_ns.empty())
+    {
+        return;
+    }
+    std::sort(parse_ns.begin(), parse_ns.end());
+    std::fprintf(stderr, "boot %u: %zu reads, %zu with a fix, %u sentences passed, %u failed; parse median %.0f ns, p99 %.0f ns, max %.0f ns\n",
+                 boot, reads, fixes, parser.passed(), parser.failed(), parse_ns[parse_ns.size() / 2],
+                 parse_ns[parse_ns.size() * 99 / 100], parse_ns.back());
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = nullptr, *extract_path = nullptr;
+    RecorderChannel extract_channel = RECORDER_GPS_RX;
+    bool dump = false, run_replay = false, all_boots = true;
+    uint32_t only_boot = 0;
+    unsigned repeat = 1;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!std::strcmp(argv[i], "--dump"))
+        {
+            dump = true;
+        }
+        else if (!std::strcmp(argv[i], "--replay"))
+        {
+            run_replay = true;
+        }
+        else if (!std::strcmp(argv[i], "--repeat") && i + 1 < argc)
+        {
+            repeat = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (!std::strcmp(argv[i], "--boot") && i + 1 < argc)
+        {
+            only_boot = std::strtoul(argv[++i], nullptr, 10);
+            all_boots = false;
+        }
+        else if (!std::strcmp(argv[i], "--extract") && i + 2 < argc)
+        {
+            if (!channel_from_name(argv[++i], extract_channel))
+            {
+                std::fprintf(stderr, "unknown channel %s\n", argv[i]);
+                return 2;
+            }
+            extract_path = argv[++i];
+        }
+        else
+        {
+            path = argv[i];
+        }
+    }
+    FILE *file = path ? std::fopen(path, "rb") : nullptr;
+    if (!file)
+    {
+        std::fprintf(stderr, "usage: %s recorder.bin [--boot n] [--dump] [--replay [--repeat n]] [--extract channel file]\n"
+                             "channels: gps_rx, gps_tx, modem_rx, modem_tx\n",
+                     argv[0]);
+        return 2;
+    }
+    std::vector<uint8_t> download;
+    uint8_t buffer[4096];
+    for (size_t length; (length = std::fread(buffer, 1, sizeof(buffer), file)) > 0;)
+    {
+        download.insert(download.end(), buffer, buffer + length);
+    }
+    std::fclose(file);
+
+    std::vector<Transfer> transfers;
+    size_t blocks = 0, skipped = 0;
+    for (size_t offset = 0; offset < download.size();)
+    {
+        size_t size = recorder_parse_block(download.data() + offset, download.size() - offset, collect, &transfers);
+        if (size == 0)
+        {
+            // Blocks are word aligned; look for the next one after damage or a ring that moved
+            offset += 4;
+            skipped += 4;
+            continue;
+        }
+        offset += size;
+        blocks++;
+    }
+    transfers.erase(std::remove_if(transfers.begin(), transfers.end(), [&](const Transfer &transfer)
+                                   { return !all_boots && transfer.boot != only_boot; }),
+                    transfers.end());
+    std::fprintf(stderr, "%zu blocks, %zu bytes skipped\n", blocks, skipped);
+
+    std::map<uint32_t, std::vector<size_t>> boots; // boot: bytes per channel
+    std::map<uint32_t, std::pair<uint32_t, uint32_t>> spans;
+    for (const Transfer &transfer : transfers)
+    {
+        std::vector<size_t> &bytes = boots[transfer.boot];
+        bytes.resize(RECORDER_CHANNELS);
+        bytes[transfer.channel] += transfer.data.size();
+        auto span = spans.emplace(transfer.boot, std::make_pair(transfer.ms, transfer.ms)).first;
+        span->second.second = transfer.ms;
+    }
+    for (const auto &boot : boots)
+    {
+        const auto &span = spans[boot.first];
+        std::fprintf(stderr, "boot %u: %.1f s from %u ms;", boot.first, (span.second - span.first) / 1000.0, span.first);
+        for (uint8_t i = 0; i < RECORDER_CHANNELS; i++)
+        {
+            std::fprintf(stderr, " %s %zu bytes", recorder_channel_name((RecorderChannel)i), boot.second[i]);
+        }
+        std::fprintf(stderr, "\n");
+    }
+
+    if (dump)
+    {
+        for (const Transfer &transfer : transfers)
+        {
+            std::printf("%u %10u %-8s ", transfer.boot, transfer.ms, recorder_channel_name(transfer.channel));
+            print_escaped(transfer.data);
+        }
+    }
+    if (extract_path)
+    {
+        FILE *out = std::fopen(extract_path, "wb");
+        if (!out)
+        {
+            std::fprintf(stderr, "cannot write %s\n", extract_path);
+            return 1;
+        }
+        for (const Transfer &transfer : transfers)
+        {
+            if (transfer.channel == extract_channel)
+            {
+                std::fwrite(transfer.data.data(), 1, transfer.data.size(), out);
+            }
+        }
+        std::fclose(out);
+    }
+    if (run_replay)
+    {
+        for (const auto &boot : boots)
+        {
+            replay(transfers, boot.first, repeat);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,169 @@
+/**
+ * @file geo_sweep.cpp
+ * @brief Host sweep of the geo_fixed.h kernels against double precision libm
+ *
+ * Checks the accuracy table in geo_fixed.h on random inputs: the sine and arctangent on random
+ * angles and vectors, the integer square roots for exactness, and the distances and bearing on
+ * random pairs of points. A pair starts at a point spread evenly over the sphere within a
+ * latitude band and ends a random distance up to the range away in a random direction; the
+ * reference works on the same rounded 1e-7 degree coordinates the kernels see. Each band and
+ * range prints the worst haversine error in cm, and over pairs at least SHORT_PAIR_M apart the
+ * worst equirectangular error relative to the distance once 1 cm is allowed for rounding and the
+ * worst bearing error in centidegrees.
+ *
+ * Build and run from the repository root:
+ *     g++ -O2 -std=c++17 -Iinclude tools/geo_sweep.cpp src/geo_fixed.cpp -o geo_sweep
+ *     ./geo_sweep [--pairs 2000000] [--seed 1]
+ * The figures in geo_fixed.h were taken with --pairs 20000000.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include "geo_fixed.h"
+
+#define EARTH_RADIUS_M 6371008.8
+#define METRES_PER_DEGREE (EARTH_RADIUS_M * M_PI / 180)
+#define KERNEL_SAMPLES 4000000
+#define SHORT_PAIR_M 10.0 // below this the centimetre rounding swamps relative and angular errors
+#define POLE_MARGIN 89.99 // the sampler's straight-line step is meaningless past this
+
+static const double BANDS[] = {60, 80, 85, 89, 89.9}; // highest latitude of the first point
+static const double RANGES_M[] = {1e3, 1e4, 1e5};
+
+static std::mt19937_64 rng;
+
+static double uniform()
+{
+    return std::uniform_real_distribution<double>(0, 1)(rng);
+}
+
+static double radians(double degrees)
+{
+    return degrees * M_PI / 180;
+}
+
+static double reference_cm(int32_t lat1_e7, int32_t lng1_e7, int32_t lat2_e7, int32_t lng2_e7)
+{
+    double a = std::sin(radians((lat2_e7 - (double)lat1_e7) / 1e7) / 2);
+    double b = std::sin(radians((lng2_e7 - (double)lng1_e7) / 1e7) / 2);
+    double h = a * a + std::cos(radians(lat1_e7 / 1e7)) * std::cos(radians(lat2_e7 / 1e7)) * b * b;
+    return 2 * EARTH_RADIUS_M * std::asin(std::sqrt(h)) * 100;
+}
+
+static double reference_cdeg(int32_t lat1_e7, int32_t lng1_e7, int32_t lat2_e7, int32_t lng2_e7)
+{
+    double lat1 = radians(lat1_e7 / 1e7), lat2 = radians(lat2_e7 / 1e7);
+    double dlng = radians((lng2_e7 - (double)lng1_e7) / 1e7);
+    double y = std::sin(dlng) * std::cos(lat2);
+    double x = std::cos(lat1) * std::sin(lat2) - std::sin(lat1) * std::cos(lat2) * std::cos(dlng);
+    return std::fmod(std::atan2(y, x) * 18000 / M_PI + 36000, 36000);
+}
+
+static void sweep_kernels()
+{
+    double sin_error = 0, cos_error = 0;
+    for (int i = 0; i < KERNEL_SAMPLES; i++)
+    {
+        geo_angle_t angle = (geo_angle_t)rng();
+        double turns = angle / 4294967296.0 * 2 * M_PI;
+        sin_error = std::max(sin_error, std::fabs(geo_sin(angle) / (double)GEO_Q30 - std::sin(turns)));
+        cos_error = std::max(cos_error, std::fabs(geo_cos(angle) / (double)GEO_Q30 - std::cos(turns)));
+    }
+
+    // Vectors of every magnitude above the few bits where rounding of the inputs dominates
+    double atan2_error = 0;
+    for (int i = 0; i < KERNEL_SAMPLES; i++)
+    {
+        int32_t y = (int32_t)(rng() >> 32) >> (rng() % 15), x = (int32_t)(rng() >> 32) >> (rng() % 15);
+        if (std::abs(x) < 65536 && std::abs(y) < 65536)
+        {
+            continue;
+        }
+        double expected = std::atan2((double)y, (double)x) / (2 * M_PI);
+        double error = std::fabs(geo_atan2(y, x) / 4294967296.0 - (expected < 0 ? expected + 1 : expected));
+        atan2_error = std::max(atan2_error, std::min(error, 1 - error));
+    }
+
+    size_t isqrt_failures = 0;
+    for (int i = 0; i < KERNEL_SAMPLES; i++)
+    {
+        uint64_t value = rng() >> (rng() % 64);
+        unsigned __int128 root = geo_isqrt64(value);
+        uint32_t value32 = (uint32_t)value;
+        uint64_t root32 = geo_isqrt32(value32);
+        isqrt_failures += !(root * root <= value && (root + 1) * (root + 1) > value);
+        isqrt_failures += !(root32 * root32 <= value32 && (root32 + 1) * (root32 + 1) > value32);
+    }
+
+    printf("geo_sin %.2e  geo_cos %.2e  geo_atan2 %.2e turns  geo_isqrt32/64 %zu not exact\n", sin_error, cos_error, atan2_error,
+           isqrt_failures);
+}
+
+static void sweep_distances(double band, double range_m, long pairs)
+{
+    double haversine_cm = 0, haversine_lat = 0, equirect = 0, bearing_cdeg = 0;
+    for (long i = 0; i < pairs; i++)
+    {
+        double lat1 = std::asin((2 * uniform() - 1) * std::sin(radians(band))) * 180 / M_PI;
+        double lng1 = uniform() * 360 - 180;
+        double distance = uniform() * range_m, direction = uniform() * 2 * M_PI;
+        double lat2 = lat1 + distance * std::cos(direction) / METRES_PER_DEGREE;
+        double lng2 = lng1 + distance * std::sin(direction) / (METRES_PER_DEGREE * std::max(0.01, std::cos(radians(lat1))));
+        if (std::fabs(lat2) > POLE_MARGIN)
+        {
+            continue;
+        }
+        lng2 += lng2 > 180 ? -360 : lng2 < -180 ? 360 : 0;
+        int32_t lat1_e7 = std::lround(lat1 * 1e7), lng1_e7 = std::lround(lng1 * 1e7);
+        int32_t lat2_e7 = std::lround(lat2 * 1e7), lng2_e7 = std::lround(lng2 * 1e7);
+
+        double expected = reference_cm(lat1_e7, lng1_e7, lat2_e7, lng2_e7);
+        double error = std::fabs(geo_haversine_cm(lat1_e7, lng1_e7, lat2_e7, lng2_e7) - expected);
+        if (error > haversine_cm)
+        {
+            haversine_cm = error;
+            haversine_lat = lat1;
+        }
+        if (expected >= SHORT_PAIR_M * 100)
+        {
+            error = std::fabs(geo_equirect_cm(lat1_e7, lng1_e7, lat2_e7, lng2_e7) - expected) - 1;
+            equirect = std::max(equirect, error / expected);
+            error = std::fabs(geo_bearing_cdeg(lat1_e7, lng1_e7, lat2_e7, lng2_e7) - reference_cdeg(lat1_e7, lng1_e7, lat2_e7, lng2_e7));
+            bearing_cdeg = std::max(bearing_cdeg, std::min(error, 36000 - error));
+        }
+    }
+    printf("below %4.1f deg, up to %6.0f m: haversine %7.2f cm (at %6.2f deg)  equirect %.1e  bearing %7.1f cdeg\n", band, range_m,
+           haversine_cm, haversine_lat, equirect, bearing_cdeg);
+}
+
+int main(int argc, char **argv)
+{
+    long pairs = 2000000;
+    uint64_t seed = 1;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (!strcmp(argv[i], "--pairs"))
+        {
+            pairs = strtol(argv[i + 1], nullptr, 10);
+        }
+        else if (!strcmp(argv[i], "--seed"))
+        {
+            seed = strtoull(argv[i + 1], nullptr, 10);
+        }
+    }
+    rng.seed(seed);
+
+    sweep_kernels();
+    for (double band : BANDS)
+    {
+        for (double range_m : RANGES_M)
+        {
+            sweep_distances(band, range_m, pairs);
+        }
+    }
+    return 0;
+}
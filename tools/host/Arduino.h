@@ -0,0 +1,58 @@
+/**
+ * @file Arduino.h
+ * @brief Host stand-in for the parts of the Arduino core the portable firmware modules use
+ *
+ * Time is virtual: millis() and micros() read host_clock_us, which only moves when the host
+ * program advances it or firmware code calls delay(). The host program defines both, so a
+ * simulator can let other actors run while the firmware waits.
+ */
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+extern uint64_t host_clock_us;
+
+/* 32-bit like the device, so wrap-around arithmetic behaves the same */
+inline uint32_t millis() { return (uint32_t)(host_clock_us / 1000); }
+inline uint32_t micros() { return (uint32_t)host_clock_us; }
+void delay(uint32_t ms);
+inline void yield() {}
+
+/* Math helpers TinyGPSPlus uses for its distance and course functions */
+#define PI 3.1415926535897932384626433832795
+#define TWO_PI 6.283185307179586476925286766559
+#define radians(deg) ((deg) * (PI / 180.0))
+#define degrees(rad) ((rad) * (180.0 / PI))
+#define sq(x) ((x) * (x))
+
+class Print
+{
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t byte) = 0;
+    virtual size_t write(const uint8_t *data, size_t length)
+    {
+        size_t written = 0;
+        while (length-- && write(*data++))
+        {
+            written++;
+        }
+        return written;
+    }
+    size_t print(const char *text) { return write((const uint8_t *)text, strlen(text)); }
+    size_t println(const char *text) { return print(text) + print("\r\n"); }
+};
+
+class Stream : public Print
+{
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+};
+
+#endif
@@ -0,0 +1,187 @@
+/**
+ * @file SoftwareSerial.cpp
+ * @brief PTY-backed SoftwareSerial stand-in, see SoftwareSerial.h
+ */
+
+#include "SoftwareSerial.h"
+#include <chrono>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <thread>
+#include <unistd.h>
+
+static uint64_t monotonic_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void make_raw(int fd)
+{
+    struct termios settings;
+    if (tcgetattr(fd, &settings) == 0)
+    {
+        cfmakeraw(&settings);
+        tcsetattr(fd, TCSANOW, &settings);
+    }
+}
+
+SoftwareSerial::SoftwareSerial(int8_t rx_pin, int8_t tx_pin, bool invert)
+    : _fd(-1), _slave_fd(-1), _pty_name(), _byte_us(10 * 1000000 / 9600), _wire_free_us(0),
+      _capacity(SOFTWARE_SERIAL_BUFFER), _overflow(false), _stats()
+{
+    (void)rx_pin;
+    (void)tx_pin;
+    (void)invert;
+}
+
+SoftwareSerial::~SoftwareSerial()
+{
+    if (_fd >= 0)
+    {
+        close(_fd);
+    }
+    if (_slave_fd >= 0)
+    {
+        close(_slave_fd);
+    }
+}
+
+void SoftwareSerial::begin(uint32_t baud)
+{
+    _byte_us = 10 * 1000000 / baud; // start, 8 data and stop bits
+}
+
+const char *SoftwareSerial::open_pty()
+{
+    int fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (fd < 0 || grantpt(fd) != 0 || unlockpt(fd) != 0 || !ptsname(fd))
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return nullptr;
+    }
+    snprintf(_pty_name, sizeof(_pty_name), "%s", ptsname(fd));
+    _slave_fd = ::open(_pty_name, O_RDWR | O_NOCTTY);
+    if (_slave_fd >= 0)
+    {
+        make_raw(_slave_fd);
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    _fd = fd;
+    return _pty_name;
+}
+
+bool SoftwareSerial::open_device(const char *path)
+{
+    int fd = ::open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0)
+    {
+        return false;
+    }
+    make_raw(fd);
+    _fd = fd;
+    return true;
+}
+
+void SoftwareSerial::set_buffer_size(size_t bytes)
+{
+    _capacity = bytes;
+}
+
+/**
+ * @brief - take what the far end has written onto the wire, and move the bytes that have
+ * crossed it by now into the receive buffer
+ */
+void SoftwareSerial::pump()
+{
+    if (_fd < 0)
+    {
+        return;
+    }
+    uint64_t now = monotonic_us();
+    uint8_t chunk[256];
+    ssize_t length;
+    while ((length = ::read(_fd, chunk, sizeof(chunk))) > 0)
+    {
+        for (ssize_t i = 0; i < length; i++)
+        {
+            _wire_free_us = (_wire_free_us > now ? _wire_free_us : now) + _byte_us;
+            _wire.push_back({_wire_free_us, chunk[i]});
+        }
+    }
+    if (_wire.size() > _stats.backlog_max)
+    {
+        _stats.backlog_max = _wire.size();
+    }
+    while (!_wire.empty() && _wire.front().us <= now)
+    {
+        if (_buffer.size() < _capacity)
+        {
+            _buffer.push_back(_wire.front().byte);
+            _stats.rx_bytes++;
+        }
+        else
+        {
+            _overflow = true;
+            _stats.rx_lost++;
+        }
+        _wire.pop_front();
+    }
+}
+
+int SoftwareSerial::available()
+{
+    pump();
+    return (int)_buffer.size();
+}
+
+int SoftwareSerial::read()
+{
+    pump();
+    if (_buffer.empty())
+    {
+        return -1;
+    }
+    uint8_t byte = _buffer.front();
+    _buffer.pop_front();
+    return byte;
+}
+
+int SoftwareSerial::peek()
+{
+    pump();
+    return _buffer.empty() ? -1 : _buffer.front();
+}
+
+size_t SoftwareSerial::write(uint8_t byte)
+{
+    return write(&byte, 1);
+}
+
+size_t SoftwareSerial::write(const uint8_t *data, size_t length)
+{
+    uint64_t started = monotonic_us();
+    uint64_t done = started + (uint64_t)length * _byte_us;
+    size_t written = 0;
+    if (_fd >= 0)
+    {
+        // A full PTY (nobody reading) loses the bytes rather than blocking, as the wire would
+        ssize_t result = ::write(_fd, data, length);
+        written = result > 0 ? result : 0;
+    }
+    std::this_thread::sleep_until(std::chrono::steady_clock::time_point(std::chrono::microseconds(done)));
+    _stats.tx_bytes += length;
+    _stats.tx_busy_us += monotonic_us() - started;
+    return _fd >= 0 ? written : length;
+}
+
+bool SoftwareSerial::overflow()
+{
+    bool result = _overflow;
+    _overflow = false;
+    return result;
+}
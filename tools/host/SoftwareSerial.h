@@ -0,0 +1,89 @@
+/**
+ * @file SoftwareSerial.h
+ * @brief Host stand-in for the ESP8266 SoftwareSerial, attached to a pseudo-terminal or tty
+ *
+ * The far end is an external GPS or modem simulator, or a capture piped in with socat, cat or
+ * pv. A PTY delivers whatever is written to it at once, so the stand-in puts the link back:
+ *  - received bytes leave the wire one byte time (10 bits at the baud rate) apart, however
+ *    fast the far end writes, and land in a receive buffer of SoftwareSerial's 64 bytes; a
+ *    byte arriving at a full buffer is lost and sets overflow()
+ *  - write() holds the caller for the byte times, as the bit-banged transmitter holds the CPU
+ * Pacing runs on the host's monotonic clock, so the firmware code on the other side must run
+ * in real time too.
+ */
+
+#ifndef HOST_SOFTWARE_SERIAL_H
+#define HOST_SOFTWARE_SERIAL_H
+
+#include <Arduino.h>
+#include <deque>
+#include <stdint.h>
+
+#define SOFTWARE_SERIAL_BUFFER 64
+
+class SoftwareSerial : public Stream
+{
+public:
+    SoftwareSerial(int8_t rx_pin, int8_t tx_pin, bool invert = false);
+    ~SoftwareSerial();
+
+    void begin(uint32_t baud);
+    int available() override;
+    int read() override;
+    int peek();
+    size_t write(uint8_t byte) override;
+    size_t write(const uint8_t *data, size_t length) override;
+
+    /**
+     * @return true if bytes were lost to a full receive buffer since the last call
+     */
+    bool overflow();
+
+    /* Host only */
+
+    /**
+     * @brief - create a pseudo-terminal for the far end to open
+     * @return the path of its slave side, nullptr on failure
+     */
+    const char *open_pty();
+
+    /**
+     * @brief - use an existing tty, e.g. one end of a socat pty pair
+     */
+    bool open_device(const char *path);
+
+    void set_buffer_size(size_t bytes);
+
+    struct Stats
+    {
+        uint64_t rx_bytes; // into the receive buffer
+        uint64_t rx_lost;  // arrived at a full buffer
+        uint64_t tx_bytes;
+        uint64_t tx_busy_us; // caller held by write()
+        uint32_t backlog_max; // bytes waiting on the wire because the far end wrote faster than the baud rate
+    };
+
+    Stats stats() const { return _stats; }
+
+private:
+    struct Arrival
+    {
+        uint64_t us;
+        uint8_t byte;
+    };
+
+    void pump();
+
+    int _fd;
+    int _slave_fd; // held open so the master does not see a hangup between clients
+    char _pty_name[64];
+    uint32_t _byte_us;
+    uint64_t _wire_free_us; // when the last byte on the wire has fully arrived
+    std::deque<Arrival> _wire;
+    std::deque<uint8_t> _buffer;
+    size_t _capacity;
+    bool _overflow;
+    Stats _stats;
+};
+
+#endif
@@ -0,0 +1,674 @@
+/**
+ * @file map_match.cpp
+ * @brief Host map-matching of uploaded tracker fixes onto an OSM road graph
+ *
+ * Each track file holds the JSON bodies the tracker uploads, one per line, in upload order
+ * ({"lat":..,"long":..,...}; an optional "utc" field is used when the backend adds it). The
+ * road graph comes from an OSM XML extract: every way of a class a car may drive becomes a
+ * chain of segments, one-way where tagged (oneway=-1 against the drawing direction) or where
+ * OSM implies it, on motorways and roundabouts. Candidate segments near each fix are found through a uniform
+ * grid index, and the most likely road sequence is picked with an HMM and Viterbi decoding:
+ * a Gaussian emission on the fix-to-road distance, and a transition that prefers candidate
+ * pairs whose route distance matches their straight-line distance. Tracks are matched in
+ * parallel, one worker thread per core by default.
+ *
+ * Build and run from the repository root:
+ *     g++ -O2 -std=c++17 -pthread tools/map_match.cpp -o map_match
+ *     ./map_match extract.osm track1.jsonl track2.jsonl ... [-j threads] [-o outdir]
+ * Matched points are written as <outdir>/<track name>.csv.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <queue>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#define MATCH_SEARCH_RADIUS_M 50.0
+#define MATCH_MAX_CANDIDATES 8
+#define MATCH_GPS_SIGMA_M 5.0  // fix-to-road distance spread, NEO-6M class receivers
+#define MATCH_BETA_M 5.0       // tolerated route versus straight-line difference
+#define MATCH_MAX_DETOUR_M 2000.0
+#define GRID_CELL_M 100.0
+#define EARTH_RADIUS_M 6371008.8
+
+static const double NEG_INF = -std::numeric_limits<double>::infinity();
+
+/* Highway classes a vehicle can be on; paths, steps, footways and unbuilt roads are left out */
+static const char *const DRIVABLE_HIGHWAYS[] = {
+    "motorway", "motorway_link", "trunk", "trunk_link", "primary", "primary_link", "secondary", "secondary_link",
+    "tertiary", "tertiary_link", "unclassified", "residential", "living_street", "service", "road"};
+
+struct Node
+{
+    double x, y; // metres in the local projection
+    double lat, lng;
+};
+
+struct Segment
+{
+    uint32_t from, to; // node indices, travel from -> to always allowed
+    bool oneway;
+    double length;
+    int64_t way_id;
+};
+
+struct Arc
+{
+    uint32_t to;
+    double length;
+};
+
+struct RoadGraph
+{
+    std::vector<Node> nodes;
+    std::vector<Segment> segments;
+    std::vector<std::vector<Arc>> arcs; // directed adjacency per node
+    std::unordered_map<uint64_t, std::vector<uint32_t>> grid; // cell -> segments
+    double origin_lat = 0, origin_lng = 0, cos_lat = 1;
+
+    void project(double lat, double lng, double &x, double &y) const
+    {
+        x = (lng - origin_lng) * M_PI / 180.0 * EARTH_RADIUS_M * cos_lat;
+        y = (lat - origin_lat) * M_PI / 180.0 * EARTH_RADIUS_M;
+    }
+};
+
+struct TrackPoint
+{
+    double lat, lng;
+    uint32_t utc;
+};
+
+struct Candidate
+{
+    uint32_t segment;
+    double offset;   // metres from the segment's from node
+    double distance; // fix to road
+    double x, y;
+};
+
+struct MatchedPoint
+{
+    bool matched;
+    Candidate candidate;
+};
+
+static uint64_t grid_cell(double x, double y)
+{
+    int32_t cx = (int32_t)std::floor(x / GRID_CELL_M);
+    int32_t cy = (int32_t)std::floor(y / GRID_CELL_M);
+    return ((uint64_t)(uint32_t)cx << 32) | (uint32_t)cy;
+}
+
+/**
+ * @brief - read a quoted XML attribute from a tag line
+ * @return false if the attribute is absent
+ */
+static bool xml_attribute(const std::string &line, const char *name, std::string &value)
+{
+    std::string key = std::string(" ") + name + "=";
+    size_t at = line.find(key);
+    if (at == std::string::npos)
+    {
+        return false;
+    }
+    at += key.size();
+    char quote = line[at];
+    size_t end = line.find(quote, at + 1);
+    if (end == std::string::npos)
+    {
+        return false;
+    }
+    value = line.substr(at + 1, end - at - 1);
+    return true;
+}
+
+static bool drivable(const std::string &highway)
+{
+    for (const char *name : DRIVABLE_HIGHWAYS)
+    {
+        if (highway == name)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief - travel direction of a way from its tags
+ * @return 1 along the way's node order, -1 against it, 0 both ways
+ */
+static int way_direction(const std::string &highway, const std::string &oneway, const std::string &junction)
+{
+    if (oneway == "yes" || oneway == "1" || oneway == "true")
+    {
+        return 1;
+    }
+    if (oneway == "-1" || oneway == "reverse")
+    {
+        return -1;
+    }
+    if (!oneway.empty())
+    {
+        return 0; // "no", or a value such as "reversible" that changes with the time of day
+    }
+    return highway == "motorway" || junction == "roundabout" || junction == "circular" ? 1 : 0;
+}
+
+/**
+ * @brief - build the road graph from the drivable ways in an OSM XML extract
+ */
+static bool load_osm(const char *path, RoadGraph &graph)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        return false;
+    }
+    std::unordered_map<int64_t, uint32_t> node_index;
+    std::vector<int64_t> way_refs;
+    int64_t way_id = 0;
+    bool in_way = false;
+    std::string highway, oneway, junction;
+    std::string line, value;
+
+    auto add_way = [&]()
+    {
+        if (!drivable(highway))
+        {
+            return;
+        }
+        int direction = way_direction(highway, oneway, junction);
+        for (size_t i = 1; i < way_refs.size(); i++)
+        {
+            auto from = node_index.find(way_refs[i - 1]);
+            auto to = node_index.find(way_refs[i]);
+            if (from == node_index.end() || to == node_index.end() || from->second == to->second)
+            {
+                continue;
+            }
+            if (direction < 0)
+            {
+                graph.segments.push_back({to->second, from->second, true, 0, way_id});
+            }
+            else
+            {
+                graph.segments.push_back({from->second, to->second, direction > 0, 0, way_id});
+            }
+        }
+    };
+
+    while (std::getline(file, line))
+    {
+        if (line.find("<node ") != std::string::npos)
+        {
+            std::string id, lat, lng;
+            if (xml_attribute(line, "id", id) && xml_attribute(line, "lat", lat) && xml_attribute(line, "lon", lng))
+            {
+                node_index[std::stoll(id)] = graph.nodes.size();
+                graph.nodes.push_back({0, 0, std::stod(lat), std::stod(lng)});
+            }
+        }
+        else if (line.find("<way ") != std::string::npos)
+        {
+            in_way = true;
+            highway.clear();
+            oneway.clear();
+            junction.clear();
+            way_refs.clear();
+            way_id = xml_attribute(line, "id", value) ? std::stoll(value) : 0;
+        }
+        else if (in_way && line.find("<nd ") != std::string::npos && xml_attribute(line, "ref", value))
+        {
+            way_refs.push_back(std::stoll(value));
+        }
+        else if (in_way && line.find("<tag ") != std::string::npos && xml_attribute(line, "k", value))
+        {
+            std::string tag_value;
+            xml_attribute(line, "v", tag_value);
+            if (value == "highway")
+            {
+                highway = tag_value;
+            }
+            else if (value == "oneway")
+            {
+                oneway = tag_value;
+            }
+            else if (value == "junction")
+            {
+                junction = tag_value;
+            }
+        }
+        else if (in_way && line.find("</way>") != std::string::npos)
+        {
+            add_way();
+            in_way = false;
+        }
+    }
+    if (graph.nodes.empty() || graph.segments.empty())
+    {
+        return false;
+    }
+
+    for (const Node &node : graph.nodes)
+    {
+        graph.origin_lat += node.lat / graph.nodes.size();
+        graph.origin_lng += node.lng / graph.nodes.size();
+    }
+    graph.cos_lat = std::cos(graph.origin_lat * M_PI / 180.0);
+    for (Node &node : graph.nodes)
+    {
+        graph.project(node.lat, node.lng, node.x, node.y);
+    }
+
+    graph.arcs.assign(graph.nodes.size(), {});
+    for (uint32_t s = 0; s < graph.segments.size(); s++)
+    {
+        Segment &segment = graph.segments[s];
+        const Node &a = graph.nodes[segment.from];
+        const Node &b = graph.nodes[segment.to];
+        segment.length = std::hypot(b.x - a.x, b.y - a.y);
+        graph.arcs[segment.from].push_back({segment.to, segment.length});
+        if (!segment.oneway)
+        {
+            graph.arcs[segment.to].push_back({segment.from, segment.length});
+        }
+        // Register the segment in every grid cell its bounding box touches
+        int32_t x0 = (int32_t)std::floor(std::min(a.x, b.x) / GRID_CELL_M), x1 = (int32_t)std::floor(std::max(a.x, b.x) / GRID_CELL_M);
+        int32_t y0 = (int32_t)std::floor(std::min(a.y, b.y) / GRID_CELL_M), y1 = (int32_t)std::floor(std::max(a.y, b.y) / GRID_CELL_M);
+        for (int32_t cx = x0; cx <= x1; cx++)
+        {
+            for (int32_t cy = y0; cy <= y1; cy++)
+            {
+                graph.grid[grid_cell(cx * GRID_CELL_M, cy * GRID_CELL_M)].push_back(s);
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief - read an uploaded track, skipping lines without a position
+ */
+static bool load_track(const char *path, std::vector<TrackPoint> &track)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        return false;
+    }
+    std::string line;
+    while (std::getline(file, line))
+    {
+        size_t lat = line.find("\"lat\":");
+        size_t lng = line.find("\"long\":");
+        if (lat == std::string::npos || lng == std::string::npos)
+        {
+            continue;
+        }
+        size_t utc = line.find("\"utc\":");
+        track.push_back({std::atof(line.c_str() + lat + 6), std::atof(line.c_str() + lng + 7),
+                         utc == std::string::npos ? 0 : (uint32_t)std::strtoul(line.c_str() + utc + 6, nullptr, 10)});
+    }
+    return true;
+}
+
+/**
+ * @brief - road segments within MATCH_SEARCH_RADIUS_M of a point, nearest first
+ */
+static std::vector<Candidate> find_candidates(const RoadGraph &graph, double x, double y)
+{
+    std::vector<Candidate> candidates;
+    int32_t reach = (int32_t)std::ceil(MATCH_SEARCH_RADIUS_M / GRID_CELL_M);
+    int32_t cx = (int32_t)std::floor(x / GRID_CELL_M), cy = (int32_t)std::floor(y / GRID_CELL_M);
+    for (int32_t dx = -reach; dx <= reach; dx++)
+    {
+        for (int32_t dy = -reach; dy <= reach; dy++)
+        {
+            auto cell = graph.grid.find(grid_cell((cx + dx) * GRID_CELL_M, (cy + dy) * GRID_CELL_M));
+            if (cell == graph.grid.end())
+            {
+                continue;
+            }
+            for (uint32_t s : cell->second)
+            {
+                const Segment &segment = graph.segments[s];
+                const Node &a = graph.nodes[segment.from];
+                const Node &b = graph.nodes[segment.to];
+                double ux = b.x - a.x, uy = b.y - a.y;
+                double t = segment.length > 0 ? ((x - a.x) * ux + (y - a.y) * uy) / (segment.length * segment.length) : 0;
+                t = std::min(1.0, std::max(0.0, t));
+                double px = a.x + t * ux, py = a.y + t * uy;
+                double distance = std::hypot(x - px, y - py);
+                if (distance <= MATCH_SEARCH_RADIUS_M)
+                {
+                    candidates.push_back({s, t * segment.length, distance, px, py});
+                }
+            }
+        }
+    }
+    // A long segment can sit in several neighbouring cells
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate &a, const Candidate &b) { return a.segment < b.segment; });
+    candidates.erase(std::unique(candidates.begin(), candidates.end(), [](const Candidate &a, const Candidate &b) { return a.segment == b.segment; }), candidates.end());
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate &a, const Candidate &b) { return a.distance < b.distance; });
+    if (candidates.size() > MATCH_MAX_CANDIDATES)
+    {
+        candidates.resize(MATCH_MAX_CANDIDATES);
+    }
+    return candidates;
+}
+
+/**
+ * @brief - bounded Dijkstra with scratch space reused across calls on one thread
+ */
+class Router
+{
+public:
+    explicit Router(const RoadGraph &graph) : _graph(graph), _distance(graph.nodes.size(), INFINITY) {}
+
+    /**
+     * @brief - shortest road distance between two candidates, INFINITY if over limit
+     */
+    double route(const Candidate &from, const Candidate &to, double limit)
+    {
+        const Segment &a = _graph.segments[from.segment];
+        const Segment &b = _graph.segments[to.segment];
+        double best = INFINITY;
+        if (from.segment == to.segment && (to.offset >= from.offset || !a.oneway))
+        {
+            best = std::fabs(to.offset - from.offset);
+        }
+
+        // Leave the first segment through either end node the direction rules allow
+        for (uint32_t touched : _touched)
+        {
+            _distance[touched] = INFINITY;
+        }
+        _touched.clear();
+        std::priority_queue<std::pair<double, uint32_t>, std::vector<std::pair<double, uint32_t>>, std::greater<>> queue;
+        relax(queue, a.to, a.length - from.offset);
+        if (!a.oneway)
+        {
+            relax(queue, a.from, from.offset);
+        }
+
+        // Enter the last segment through either end node
+        double enter_from = to.offset;
+        double enter_to = b.oneway ? INFINITY : b.length - to.offset;
+        while (!queue.empty())
+        {
+            auto [distance, node] = queue.top();
+            queue.pop();
+            if (distance >= std::min(best, limit))
+            {
+                break;
+            }
+            if (distance > _distance[node])
+            {
+                continue;
+            }
+            if (node == b.from)
+            {
+                best = std::min(best, distance + enter_from);
+            }
+            if (node == b.to)
+            {
+                best = std::min(best, distance + enter_to);
+            }
+            for (const Arc &arc : _graph.arcs[node])
+            {
+                relax(queue, arc.to, distance + arc.length);
+            }
+        }
+        return best <= limit ? best : INFINITY;
+    }
+
+private:
+    template <typename Queue>
+    void relax(Queue &queue, uint32_t node, double distance)
+    {
+        if (distance < _distance[node])
+        {
+            if (_distance[node] == INFINITY)
+            {
+                _touched.push_back(node);
+            }
+            _distance[node] = distance;
+            queue.push({distance, node});
+        }
+    }
+
+    const RoadGraph &_graph;
+    std::vector<double> _distance;
+    std::vector<uint32_t> _touched;
+};
+
+/**
+ * @brief - Viterbi decoding over the candidates of each fix
+ *
+ * A fix with no candidate, or whose candidates cannot be reached from any previous one,
+ * breaks the chain: decoding restarts there and the points before it are traced back.
+ */
+static std::vector<MatchedPoint> match_track(const RoadGraph &graph, Router &router, const std::vector<TrackPoint> &track)
+{
+    std::vector<MatchedPoint> matched(track.size(), MatchedPoint{false, {}});
+    std::vector<std::vector<Candidate>> candidates(track.size());
+    std::vector<std::vector<double>> score(track.size());
+    std::vector<std::vector<int32_t>> previous(track.size());
+    double emission_scale = -0.5 / (MATCH_GPS_SIGMA_M * MATCH_GPS_SIGMA_M);
+
+    auto trace_back = [&](size_t last)
+    {
+        if (candidates[last].empty())
+        {
+            return;
+        }
+        int32_t state = std::max_element(score[last].begin(), score[last].end()) - score[last].begin();
+        for (size_t i = last + 1; i-- > 0 && state >= 0;)
+        {
+            matched[i] = {true, candidates[i][state]};
+            state = previous[i][state];
+        }
+    };
+
+    size_t last_live = SIZE_MAX;
+    for (size_t i = 0; i < track.size(); i++)
+    {
+        double x, y;
+        graph.project(track[i].lat, track[i].lng, x, y);
+        candidates[i] = find_candidates(graph, x, y);
+        score[i].assign(candidates[i].size(), NEG_INF);
+        previous[i].assign(candidates[i].size(), -1);
+        if (candidates[i].empty())
+        {
+            continue;
+        }
+
+        bool connected = false;
+        if (last_live != SIZE_MAX)
+        {
+            double px, py;
+            graph.project(track[last_live].lat, track[last_live].lng, px, py);
+            double straight = std::hypot(x - px, y - py);
+            double limit = std::min(MATCH_MAX_DETOUR_M, straight * 4 + 4 * MATCH_SEARCH_RADIUS_M);
+            for (size_t from = 0; from < candidates[last_live].size(); from++)
+            {
+                if (score[last_live][from] == NEG_INF)
+                {
+                    continue;
+                }
+                for (size_t to = 0; to < candidates[i].size(); to++)
+                {
+                    double route = router.route(candidates[last_live][from], candidates[i][to], limit);
+                    if (route == INFINITY)
+                    {
+                        continue;
+                    }
+                    double value = score[last_live][from] - std::fabs(route - straight) / MATCH_BETA_M;
+                    if (value > score[i][to])
+                    {
+                        score[i][to] = value;
+                        previous[i][to] = from;
+                        connected = true;
+                    }
+                }
+            }
+            if (!connected)
+            {
+                trace_back(last_live);
+            }
+        }
+        for (size_t to = 0; to < candidates[i].size(); to++)
+        {
+            double emission = emission_scale * candidates[i][to].distance * candidates[i][to].distance;
+            score[i][to] = connected ? score[i][to] + emission : emission;
+            if (!connected)
+            {
+                previous[i][to] = -1;
+            }
+        }
+        // Dropping the chain links of the fixes in between keeps trace_back on matched points only
+        last_live = i;
+    }
+    if (last_live != SIZE_MAX)
+    {
+        trace_back(last_live);
+    }
+    return matched;
+}
+
+static bool write_matches(const std::string &path, const RoadGraph &graph, const std::vector<TrackPoint> &track, const std::vector<MatchedPoint> &matched)
+{
+    FILE *out = std::fopen(path.c_str(), "w");
+    if (!out)
+    {
+        return false;
+    }
+    std::fprintf(out, "index,utc,lat,long,matched_lat,matched_long,way,offset_m\n");
+    for (size_t i = 0; i < track.size(); i++)
+    {
+        std::fprintf(out, "%zu,%u,%.7f,%.7f", i, track[i].utc, track[i].lat, track[i].lng);
+        if (matched[i].matched)
+        {
+            const Candidate &c = matched[i].candidate;
+            double lat = graph.origin_lat + c.y / EARTH_RADIUS_M * 180.0 / M_PI;
+            double lng = graph.origin_lng + c.x / (EARTH_RADIUS_M * graph.cos_lat) * 180.0 / M_PI;
+            std::fprintf(out, ",%.7f,%.7f,%lld,%.1f\n", lat, lng, (long long)graph.segments[c.segment].way_id, c.offset);
+        }
+        else
+        {
+            std::fprintf(out, ",,,,\n");
+        }
+    }
+    std::fclose(out);
+    return true;
+}
+
+static std::string track_name(const std::string &path)
+{
+    size_t slash = path.find_last_of('/');
+    std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+    size_t dot = name.find_last_of('.');
+    return dot == std::string::npos ? name : name.substr(0, dot);
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<std::string> tracks;
+    std::string outdir = ".";
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    const char *osm_path = nullptr;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!std::strcmp(argv[i], "-j") && i + 1 < argc)
+        {
+            threads = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (!std::strcmp(argv[i], "-o") && i + 1 < argc)
+        {
+            outdir = argv[++i];
+        }
+        else if (!osm_path)
+        {
+            osm_path = argv[i];
+        }
+        else
+        {
+            tracks.push_back(argv[i]);
+        }
+    }
+    if (!osm_path || tracks.empty())
+    {
+        std::fprintf(stderr, "usage: %s extract.osm track.jsonl... [-j threads] [-o outdir]\n", argv[0]);
+        return 2;
+    }
+
+    RoadGraph graph;
+    if (!load_osm(osm_path, graph))
+    {
+        std::fprintf(stderr, "%s: no highway ways found\n", osm_path);
+        return 1;
+    }
+    std::fprintf(stderr, "%zu nodes, %zu road segments, %zu grid cells\n", graph.nodes.size(), graph.segments.size(), graph.grid.size());
+
+    // Workers pull whole tracks from a shared counter, so a long track does not hold others up
+    threads = std::min<unsigned>(threads, tracks.size());
+    std::atomic<size_t> next_track(0);
+    std::atomic<bool> failed(false);
+    std::vector<size_t> points(threads, 0), matched_points(threads, 0);
+    std::vector<double> busy_s(threads, 0);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; t++)
+    {
+        workers.emplace_back([&, t]()
+                             {
+            Router router(graph);
+            for (size_t i; (i = next_track++) < tracks.size();)
+            {
+                std::vector<TrackPoint> track;
+                if (!load_track(tracks[i].c_str(), track))
+                {
+                    std::fprintf(stderr, "%s: cannot read\n", tracks[i].c_str());
+                    failed = true;
+                    continue;
+                }
+                auto began = std::chrono::steady_clock::now();
+                std::vector<MatchedPoint> matched = match_track(graph, router, track);
+                busy_s[t] += std::chrono::duration<double>(std::chrono::steady_clock::now() - began).count();
+                points[t] += track.size();
+                matched_points[t] += std::count_if(matched.begin(), matched.end(), [](const MatchedPoint &m) { return m.matched; });
+                if (!write_matches(outdir + "/" + track_name(tracks[i]) + ".csv", graph, track, matched))
+                {
+                    failed = true;
+                }
+            } });
+    }
+    for (std::thread &worker : workers)
+    {
+        worker.join();
+    }
+    double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    size_t total = 0, total_matched = 0;
+    for (unsigned t = 0; t < threads; t++)
+    {
+        std::fprintf(stderr, "worker %u: %zu points, %.0f points/s\n", t, points[t], busy_s[t] > 0 ? points[t] / busy_s[t] : 0.0);
+        total += points[t];
+        total_matched += matched_points[t];
+    }
+    std::fprintf(stderr, "%zu tracks, %zu points (%zu matched) in %.2f s on %u threads: %.0f points/s, %.0f points/s per core\n",
+                 tracks.size(), total, total_matched, wall_s, threads, total / wall_s, total / wall_s / threads);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,344 @@
+/**
+ * @file nmea_diff.cpp
+ * @brief Host differential test of NmeaParser against TinyGPSPlus, and their cost per burst
+ *
+ * Random bursts of GGA and RMC sentences, padded with the GSV and VTG sentences both decoders
+ * skip, are decoded by the firmware's NmeaParser and by TinyGPSPlus through the conversion
+ * tinygps_encode() uses on the device. The generator empties fields, writes long decimals and
+ * stray characters into numeric fields (with a correct checksum), flips characters or checksum
+ * digits (without one) and cuts the last sentence of a burst short.
+ *
+ * NmeaParser is meant to take nothing from a sentence that fails its checksum or is cut off,
+ * where TinyGPSPlus keeps the terms it has already parsed as pending values. The reference is
+ * therefore given only the sentences that are whole and intact, and the two must then agree
+ * exactly, timestamps aside when either has none (see same_fix() in tracking.cpp). Stray
+ * characters only go past a field's first character: TinyGPSPlus reads integers with atol(),
+ * which skips leading blanks and a sign that NmeaParser reads as the end of the number.
+ *
+ * Build and run from the repository root against the TinyGPSPlus the firmware links, e.g. as
+ * PlatformIO fetched it:
+ *     TGP=.pio/libdeps/nodemcuv2/TinyGPSPlus/src
+ *     g++ -O2 -std=c++17 -Itools/host -Iinclude -I$TGP tools/nmea_diff.cpp src/nmea.cpp $TGP/TinyGPS++.cpp -o nmea_diff
+ *     ./nmea_diff [--trials 20000] [--seed 1]
+ */
+
+#include <Arduino.h>
+#include <TinyGPSPlus.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "nmea.h"
+
+#define BURSTS_PER_TRIAL 8
+#define BENCH_BURSTS 2000
+#define BENCH_ROUNDS 20
+#define MISMATCHES_SHOWN 5
+
+uint64_t host_clock_us = 0;
+
+void delay(uint32_t ms)
+{
+    host_clock_us += (uint64_t)ms * 1000;
+}
+
+static uint32_t seed = 1;
+
+static uint32_t next_random()
+{
+    seed = seed * 1664525 + 1013904223;
+    return seed >> 8;
+}
+
+static uint32_t uniform(uint32_t range)
+{
+    return next_random() % range;
+}
+
+static bool chance(uint32_t percent)
+{
+    return uniform(100) < percent;
+}
+
+/**
+ * @brief - a number with a fixed count of integer digits and a random count of decimals,
+ * sometimes far more than the receiver sends
+ */
+static std::string number(uint32_t whole, uint8_t width, uint8_t decimals)
+{
+    char text[32];
+    snprintf(text, sizeof(text), "%0*u", width, whole);
+    std::string value = text;
+    uint8_t count = chance(15) ? 6 + uniform(7) : decimals;
+    if (count)
+    {
+        value += '.';
+        for (uint8_t i = 0; i < count; i++)
+        {
+            value += (char)('0' + uniform(10));
+        }
+    }
+    return value;
+}
+
+/**
+ * @brief - put a stray character into a field, past its first character
+ */
+static std::string mangle(std::string field)
+{
+    static const char STRAY[] = "-.Aa x+";
+    if (field.size() < 2 || chance(30))
+    {
+        field += STRAY[uniform(sizeof(STRAY) - 1)];
+    }
+    else
+    {
+        field[1 + uniform(field.size() - 1)] = STRAY[uniform(sizeof(STRAY) - 1)];
+    }
+    return field;
+}
+
+static std::string sentence(const std::vector<std::string> &fields)
+{
+    std::string body;
+    for (size_t i = 0; i < fields.size(); i++)
+    {
+        body += (i ? "," : "") + fields[i];
+    }
+    uint8_t parity = 0;
+    for (char c : body)
+    {
+        parity ^= (uint8_t)c;
+    }
+    char checksum[8];
+    snprintf(checksum, sizeof(checksum), "*%02X\r\n", parity);
+    return "$" + body + checksum;
+}
+
+/**
+ * @brief - GGA or RMC fields for a random fix, some of them empty or mangled
+ */
+static std::vector<std::string> fix_fields(bool rmc)
+{
+    std::string talker = chance(50) ? "GP" : "GN";
+    std::string time = number(uniform(24) * 10000 + uniform(60) * 100 + uniform(60), 6, 2);
+    std::string lat = number(uniform(90) * 100 + uniform(60), 4, 5);
+    std::string lng = number(uniform(180) * 100 + uniform(60), 5, 5);
+    std::string ns = chance(50) ? "N" : "S", ew = chance(50) ? "E" : "W";
+    std::vector<std::string> fields;
+    if (rmc)
+    {
+        char date[8];
+        snprintf(date, sizeof(date), "%02u%02u%02u", 1 + uniform(28), 1 + uniform(12), 20 + uniform(20));
+        fields = {talker + "RMC", time, chance(80) ? "A" : "V", lat, ns, lng, ew, number(uniform(120), 1, 3),
+                  number(uniform(360), 1, 2), date, "", "", "A"};
+    }
+    else
+    {
+        fields = {talker + "GGA", time, lat, ns, lng, ew, std::to_string(uniform(3)), std::to_string(uniform(13)),
+                  number(uniform(20), 1, 2), number(uniform(900), 1, 1), "M", "46.9", "M", "", ""};
+    }
+    for (size_t i = 1; i < fields.size(); i++)
+    {
+        if (chance(8))
+        {
+            fields[i].clear();
+        }
+        else if (chance(3))
+        {
+            fields[i] = mangle(fields[i]);
+        }
+    }
+    return fields;
+}
+
+static std::string filler()
+{
+    if (chance(50))
+    {
+        return sentence({"GPVTG", number(uniform(360), 1, 2), "T", "", "M", number(uniform(60), 1, 3), "N", number(uniform(110), 1, 3), "K", "A"});
+    }
+    return sentence({"GPGSV", "3", std::to_string(1 + uniform(3)), "11", std::to_string(uniform(32)), std::to_string(uniform(90)),
+                     std::to_string(uniform(360)), std::to_string(uniform(50))});
+}
+
+/**
+ * @brief A burst as the receiver port delivers it, and the part of it the reference may see
+ */
+struct Burst
+{
+    std::string text;
+    std::string intact; // whole sentences with a good checksum
+    uint32_t corrupt;
+    bool cut;
+};
+
+static Burst make_burst()
+{
+    Burst burst = {"", "", 0, false};
+    uint8_t sentences = 1 + uniform(5);
+    for (uint8_t i = 0; i < sentences; i++)
+    {
+        std::string line = chance(25) ? filler() : sentence(fix_fields(chance(50)));
+        if (chance(5))
+        {
+            // A changed character or checksum digit; never one of the delimiters
+            size_t star = line.find('*');
+            size_t position = chance(50) ? 1 + uniform(star - 1) : star + 1 + uniform(2);
+            char replacement = "0123456789ABCDEF"[uniform(16)];
+            if (line[position] == ',' || line[position] == replacement)
+            {
+                replacement = line[position] == 'Z' ? 'Y' : 'Z';
+                replacement = position > star ? (line[position] == '0' ? '1' : '0') : replacement;
+            }
+            if (line[position] != ',')
+            {
+                line[position] = replacement;
+                burst.corrupt++;
+                burst.text += line;
+                continue;
+            }
+        }
+        burst.text += line;
+        burst.intact += line;
+    }
+    if (chance(10))
+    {
+        // The read ends inside the next sentence
+        std::string line = sentence(fix_fields(chance(50)));
+        burst.text += line.substr(0, 1 + uniform(line.find('*')));
+        burst.cut = true;
+    }
+    return burst;
+}
+
+static int32_t raw_to_e7(const RawDegrees &raw)
+{
+    int32_t value = (int32_t)raw.deg * 10000000L + (int32_t)(raw.billionths / 100);
+    return raw.negative ? -value : value;
+}
+
+/**
+ * @brief - tinygps_encode() from tracking.cpp
+ */
+static bool tinygps_encode(TinyGPSPlus &decoder, const char *ptr, GpsFix &fix)
+{
+    while (*ptr)
+    {
+        decoder.encode(*ptr++);
+    }
+    if (!decoder.location.isValid())
+    {
+        return false;
+    }
+    fix.lat_e7 = raw_to_e7(decoder.location.rawLat());
+    fix.lng_e7 = raw_to_e7(decoder.location.rawLng());
+    fix.utc = 0;
+    if (decoder.date.isValid() && decoder.time.isValid() && decoder.date.year() >= 2000)
+    {
+        fix.utc = utc_from_civil(decoder.date.year(), decoder.date.month(), decoder.date.day(),
+                                 decoder.time.hour(), decoder.time.minute(), decoder.time.second());
+    }
+    fix.hdop = decoder.hdop.value();
+    fix.sats = decoder.satellites.value();
+    fix.speed = decoder.speed.value();
+    fix.course = decoder.course.value();
+    return true;
+}
+
+/**
+ * @brief - same_fix() from tracking.cpp
+ */
+static bool same_fix(const GpsFix &a, const GpsFix &b)
+{
+    return a.lat_e7 == b.lat_e7 && a.lng_e7 == b.lng_e7 && a.hdop == b.hdop && a.sats == b.sats &&
+           a.speed == b.speed && a.course == b.course && (a.utc == b.utc || !a.utc || !b.utc);
+}
+
+static void show(const char *name, bool valid, const GpsFix &fix)
+{
+    printf("  %-11s %s %ld,%ld utc %u hdop %u sats %u speed %u course %u\n", name, valid ? "fix   " : "no fix",
+           (long)fix.lat_e7, (long)fix.lng_e7, fix.utc, fix.hdop, fix.sats, fix.speed, fix.course);
+}
+
+template <typename Decode>
+static double ns_per_burst(const std::vector<Burst> &bursts, Decode decode)
+{
+    volatile int32_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < BENCH_ROUNDS; round++)
+    {
+        for (const Burst &burst : bursts)
+        {
+            sink = decode(burst.text.c_str());
+        }
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    (void)sink;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / (bursts.size() * BENCH_ROUNDS);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t trials = 20000;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (!strcmp(argv[i], "--trials"))
+        {
+            trials = strtoul(argv[i + 1], nullptr, 10);
+        }
+        else if (!strcmp(argv[i], "--seed"))
+        {
+            seed = strtoul(argv[i + 1], nullptr, 10);
+        }
+    }
+
+    // Each trial starts both decoders afresh and feeds them a run of bursts
+    size_t bursts = 0, fixes = 0, corrupt = 0, cut = 0, mismatches = 0;
+    for (uint32_t trial = 0; trial < trials; trial++)
+    {
+        NmeaParser parser;
+        TinyGPSPlus reference;
+        for (int i = 0; i < BURSTS_PER_TRIAL; i++)
+        {
+            Burst burst = make_burst();
+            GpsFix fix = {}, expected = {};
+            bool valid = parser.decode(burst.text.c_str(), fix);
+            bool reference_valid = tinygps_encode(reference, burst.intact.c_str(), expected);
+            bursts++;
+            fixes += valid;
+            corrupt += burst.corrupt;
+            cut += burst.cut;
+            if (valid != reference_valid || (valid && !same_fix(fix, expected)))
+            {
+                if (++mismatches <= MISMATCHES_SHOWN)
+                {
+                    printf("mismatch in trial %u burst %d:\n%s\n", trial, i, burst.text.c_str());
+                    show("NmeaParser", valid, fix);
+                    show("TinyGPSPlus", reference_valid, expected);
+                }
+            }
+        }
+    }
+    printf("%zu bursts in %u trials, %zu with a fix; %zu sentences corrupted, %zu bursts cut short\n", bursts, trials, fixes, corrupt, cut);
+    printf("%zu mismatches\n", mismatches);
+
+    // Cost on well-formed bursts, the receiver's usual output
+    std::vector<Burst> clean;
+    while (clean.size() < BENCH_BURSTS)
+    {
+        Burst burst = make_burst();
+        if (!burst.corrupt && !burst.cut)
+        {
+            clean.push_back(burst);
+        }
+    }
+    NmeaParser parser;
+    TinyGPSPlus reference;
+    GpsFix fix;
+    printf("NmeaParser   %8.1f ns/burst\n", ns_per_burst(clean, [&](const char *text) { return (int32_t)parser.decode(text, fix) + fix.lat_e7; }));
+    printf("TinyGPSPlus  %8.1f ns/burst\n", ns_per_burst(clean, [&](const char *text) { return (int32_t)tinygps_encode(reference, text, fix) + fix.lat_e7; }));
+    return mismatches != 0;
+}
@@ -0,0 +1,300 @@
+/**
+ * @file serial_bench.cpp
+ * @brief Run the firmware's serial intake and AT dialogue in real time against external simulators
+ *
+ * The GPS and modem ports are the PTY-backed SoftwareSerial stand-in (tools/host), so the
+ * far ends can be any simulator, or a recorded capture, and the links keep their baud rate
+ * and receive buffer. The loop mirrors the ESP8266 loop():
+ *  - first the modem bring-up and uploads, each AT command sent and then waited out for its
+ *    whole timeout as sendATcommand() does, with the GPS intake stalled meanwhile
+ *  - then NmeaSource: the firmware's NmeaReader drains the port every pass and assembles the
+ *    bursts, one per --interval ms is decoded (all of them with 0, as in a live session) by the
+ *    firmware's NmeaParser
+ * It reports what the timeouts cost against the actual response times, the bytes per burst
+ * and receive buffer losses, and the time from a burst's first byte to its fix.
+ *
+ * Build and run from the repository root:
+ *     g++ -O2 -std=c++17 -Itools/host -Iinclude tools/serial_bench.cpp tools/host/SoftwareSerial.cpp src/nmea.cpp \
+ *         src/nmea_reader.cpp -o serial_bench
+ *     ./serial_bench --gps pty [--modem pty] [--seconds 60] [--interval 10000] [--buffer 64] [--uploads 0]
+ * With "pty" the bench prints the slave path for the far end, e.g. a capture at line rate:
+ *     ./flight_replay recorder.bin --extract gps_rx gps.nmea && socat -u FILE:gps.nmea /dev/pts/N,raw
+ * or two ends of a socat pair: socat pty,raw,link=/tmp/gps pty,raw,link=/tmp/gps-sim, then
+ * --gps /tmp/gps and the simulator on /tmp/gps-sim.
+ */
+
+#include <Arduino.h>
+#include <SoftwareSerial.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include "nmea.h"
+#include "nmea_reader.h"
+
+/* As in tracking.cpp */
+#define MESSAGE_BUFFER_SIZE 4097
+#define GPS_BURST_SIZE 1024
+#define GPS_READ_INTERVAL_MS 10000
+#define AT_TIMEOUT_MS 4000
+#define LOOP_IDLE_MS 1
+
+uint64_t host_clock_us = 0;
+static std::chrono::steady_clock::time_point started;
+
+static void tick()
+{
+    host_clock_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started).count();
+}
+
+void delay(uint32_t ms)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+    tick();
+}
+
+static char msgStream[MESSAGE_BUFFER_SIZE];
+static char gpsStream[GPS_BURST_SIZE];
+static uint32_t buffer_full = 0;
+
+/**
+ * @brief - read_serial() from tracking.cpp, for modem replies
+ */
+static void read_serial(Stream *softSerial, char *buffer)
+{
+    int buff_pos = 0;
+    memset(buffer, '\0', MESSAGE_BUFFER_SIZE);
+    while (softSerial->available() > 0)
+    {
+        unsigned char c = softSerial->read();
+        if (buff_pos == MESSAGE_BUFFER_SIZE - 1)
+        {
+            buffer_full++;
+            break;
+        }
+        buffer[buff_pos++] = c;
+        delay(2);
+    }
+    buffer[buff_pos] = '\0';
+}
+
+struct CommandTiming
+{
+    std::string command;
+    int32_t first_ms; // first reply byte, -1 if none
+    int32_t final_ms; // OK, ERROR or CONNECT, -1 if none
+    bool ok;
+};
+
+static std::vector<CommandTiming> commands;
+
+/**
+ * @brief - sendATcommand() from tracking.cpp, timing the reply as it goes
+ */
+static void send_at(SoftwareSerial &modem, const std::string &command, uint32_t timeout_ms)
+{
+    while (modem.available())
+    {
+        modem.read();
+    }
+    modem.println(command.c_str());
+    uint32_t send_time = millis();
+    CommandTiming timing = {command, -1, -1, false};
+    std::string reply;
+    do
+    {
+        tick();
+        if (modem.available())
+        {
+            if (timing.first_ms < 0)
+            {
+                timing.first_ms = millis() - send_time;
+            }
+            read_serial(&modem, msgStream);
+            reply += msgStream;
+            if (timing.final_ms < 0 && (reply.find("OK\r\n") != std::string::npos || reply.find("ERROR") != std::string::npos ||
+                                        reply.find("CONNECT") != std::string::npos))
+            {
+                timing.final_ms = millis() - send_time;
+                timing.ok = reply.find("ERROR") == std::string::npos;
+            }
+        }
+        else
+        {
+            delay(LOOP_IDLE_MS);
+        }
+    } while (millis() - send_time < timeout_ms);
+    commands.push_back(timing);
+}
+
+/**
+ * @brief - modem_begin() without the reset and the registration wait, then the uploads
+ */
+static void modem_session(SoftwareSerial &modem, unsigned uploads)
+{
+    static const char *const BRING_UP[] = {
+        "AT", "AT+QIACT=0", "AT+CGATT=0", "AT+CGATT=1", "AT+QICSGP=1,1", "AT+QIACT=1",
+        "AT+QHTTPCFG=\"sslctxid\",1", "AT+QHTTPCFG=\"url\",\"https://example.invalid/track.json\"",
+        "AT+QHTTPCFG=\"contextid\",1", "AT+QHTTPCFG=\"responseheader\",1", "AT+QHTTPCFG=\"rspout/auto\",1",
+        "AT+QHTTPCFG=\"header\",\"Content-Type: application/json\""};
+    for (const char *command : BRING_UP)
+    {
+        send_at(modem, command, AT_TIMEOUT_MS);
+    }
+    std::string body = "{\"lat\":-1.2921000,\"lng\":36.8219000,\"utc\":1729209600,\"hdop\":1.01,\"sats\":8,\"geohash\":\"kzf0tvg5\",\"cell\":0}";
+    for (unsigned i = 0; i < uploads; i++)
+    {
+        send_at(modem, "AT+QHTTPPUT=" + std::to_string(body.size()) + ",30,60", AT_TIMEOUT_MS);
+        send_at(modem, body, AT_TIMEOUT_MS);
+    }
+}
+
+static uint32_t percentile(std::vector<uint32_t> values, double fraction)
+{
+    if (values.empty())
+    {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, (size_t)(fraction * values.size()))];
+}
+
+static bool open_port(SoftwareSerial &port, const char *name, const char *where)
+{
+    if (!std::strcmp(where, "pty"))
+    {
+        const char *path = port.open_pty();
+        if (path)
+        {
+            std::printf("%s: %s\n", name, path);
+            std::fflush(stdout);
+        }
+        return path != nullptr;
+    }
+    return port.open_device(where);
+}
+
+int main(int argc, char **argv)
+{
+    const char *gps_where = nullptr, *modem_where = nullptr;
+    uint32_t seconds = 60, interval_ms = GPS_READ_INTERVAL_MS, gps_baud = 9600, modem_baud = 115200;
+    size_t buffer = SOFTWARE_SERIAL_BUFFER;
+    unsigned uploads = 0;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (!std::strcmp(argv[i], "--gps"))
+        {
+            gps_where = argv[i + 1];
+        }
+        else if (!std::strcmp(argv[i], "--modem"))
+        {
+            modem_where = argv[i + 1];
+        }
+        else if (!std::strcmp(argv[i], "--seconds"))
+        {
+            seconds = std::strtoul(argv[i + 1], nullptr, 10);
+        }
+        else if (!std::strcmp(argv[i], "--interval"))
+        {
+            interval_ms = std::strtoul(argv[i + 1], nullptr, 10);
+        }
+        else if (!std::strcmp(argv[i], "--buffer"))
+        {
+            buffer = std::strtoul(argv[i + 1], nullptr, 10);
+        }
+        else if (!std::strcmp(argv[i], "--uploads"))
+        {
+            uploads = std::strtoul(argv[i + 1], nullptr, 10);
+        }
+        else if (!std::strcmp(argv[i], "--gps-baud"))
+        {
+            gps_baud = std::strtoul(argv[i + 1], nullptr, 10);
+        }
+        else if (!std::strcmp(argv[i], "--modem-baud"))
+        {
+            modem_baud = std::strtoul(argv[i + 1], nullptr, 10);
+        }
+    }
+    SoftwareSerial GPS_Serial(5, 4), GSM_Serial(14, 12); // D1/D2 and D5/D6 on the NodeMCU
+    GPS_Serial.begin(gps_baud);
+    GSM_Serial.begin(modem_baud);
+    GPS_Serial.set_buffer_size(buffer);
+    GSM_Serial.set_buffer_size(buffer);
+    if (!gps_where || !open_port(GPS_Serial, "gps", gps_where) || (modem_where && !open_port(GSM_Serial, "modem", modem_where)))
+    {
+        std::fprintf(stderr, "usage: %s --gps pty|path [--modem pty|path] [--seconds n] [--interval ms] [--buffer bytes] [--uploads n] "
+                             "[--gps-baud n] [--modem-baud n]\n",
+                     argv[0]);
+        return 2;
+    }
+
+    started = std::chrono::steady_clock::now();
+    tick();
+    if (modem_where)
+    {
+        modem_session(GSM_Serial, uploads);
+    }
+
+    NmeaParser nmea;
+    NmeaReader reader(gpsStream, GPS_BURST_SIZE);
+    std::vector<uint32_t> read_ms, read_bytes, fix_ms;
+    uint32_t last_read = 0, fixes = 0;
+    bool read_once = false;
+    while (host_clock_us < seconds * 1000000ULL)
+    {
+        tick();
+        // NmeaSource::poll()
+        if (reader.poll(GPS_Serial, millis()))
+        {
+            uint32_t started = reader.started_ms();
+            if (!read_once || started - last_read >= interval_ms)
+            {
+                last_read = started;
+                read_once = true;
+                read_ms.push_back(millis() - started);
+                read_bytes.push_back(reader.length());
+                GpsFix fix;
+                if (nmea.decode(gpsStream, fix))
+                {
+                    tick();
+                    fix_ms.push_back(millis() - started);
+                    fixes++;
+                }
+            }
+            reader.clear();
+            continue;
+        }
+        delay(LOOP_IDLE_MS);
+    }
+
+    if (!commands.empty())
+    {
+        uint32_t waited = 0, needed = 0;
+        std::printf("%-56s %8s %8s\n", "command", "first ms", "final ms");
+        for (const CommandTiming &timing : commands)
+        {
+            std::printf("%-56.56s %8d %8d%s\n", timing.command.c_str(), timing.first_ms, timing.final_ms, timing.ok ? "" : "  no OK");
+            waited += AT_TIMEOUT_MS;
+            needed += timing.final_ms >= 0 ? timing.final_ms : AT_TIMEOUT_MS;
+        }
+        std::printf("modem: %zu commands held the loop %.1f s; the replies were complete after %.1f s\n", commands.size(), waited / 1000.0,
+                    needed / 1000.0);
+    }
+    SoftwareSerial::Stats gps = GPS_Serial.stats();
+    double elapsed_s = host_clock_us / 1e6;
+    std::printf("gps: %u bursts (%u cut by a full buffer), %zu decoded, %u fixes; %llu bytes received (%.0f B/s), %llu lost to the %zu byte buffer (%.1f%%), wire backlog max %u bytes\n",
+                reader.bursts(), reader.cut(), read_ms.size(), fixes, (unsigned long long)gps.rx_bytes, gps.rx_bytes / elapsed_s, (unsigned long long)gps.rx_lost, buffer,
+                100.0 * gps.rx_lost / std::max<uint64_t>(1, gps.rx_bytes + gps.rx_lost), gps.backlog_max);
+    std::printf("burst: p50 %u ms / %u bytes, max %u ms / %u bytes; first byte to fix p50 %u ms, p99 %u ms; %u sentences passed, %u failed\n",
+                percentile(read_ms, 0.5), percentile(read_bytes, 0.5), percentile(read_ms, 1.0), percentile(read_bytes, 1.0),
+                percentile(fix_ms, 0.5), percentile(fix_ms, 0.99), nmea.passed(), nmea.failed());
+    if (buffer_full)
+    {
+        std::printf("read_serial() hit a full message buffer %u times\n", buffer_full);
+    }
+    return 0;
+}
@@ -0,0 +1,882 @@
+/**
+ * @file soak_sim.cpp
+ * @brief Discrete-event soak test of the fix intake, uploads and web server in virtual time
+ *
+ * The single-threaded loop() of the ESP8266 build runs against simulated actors on a virtual
+ * clock (tools/host/Arduino.h):
+ *  - the receiver sends a NEO-6M style burst every second at 9600 baud into a receive buffer
+ *    the size of SoftwareSerial's; bytes arriving at a full buffer are lost
+ *  - the modem takes the moved fixes; every AT command waits out its timeout as
+ *    sendATcommand() does, and uploads fail during network outages
+ *  - web clients arrive at random and wait for the server, which renders one page per loop
+ *  - a synthetic heap model replays the allocations of request buffers, rendered pages and
+ *    upload Strings, with sent buffers freed when the client acknowledges them, to estimate
+ *    fragmentation; its figures are not measurements of the device heap
+ * Fixes go through the real NmeaReader, NmeaParser, pipeline stages and event bus into the
+ * archive (journal included), cell cache, energy accounting and flight recorder, all on a RAM
+ * flash, with the real CPU governor switching the clock. The firmware loop idles 1 ms at a
+ * time; here the idle passes that would find nothing new are skipped, waking when the receive
+ * buffer is half full, a burst's closing gap has passed or an actor acts. A week runs in 4 to
+ * 7 s on a desktop.
+ *
+ * The code that only exists in tracking.cpp (NmeaSource, idle_wait(), the sendATcommand() wait,
+ * the upload and page handlers, the loop itself) is mirrored here; keep the two in step. Not
+ * modelled: the health supervisor and its restarts; live sessions and gpsd watchers, so bursts
+ * are always taken every GPS_READ_INTERVAL_MS and nothing is fed to gpsd; the response cache
+ * that modem replies invalidate; modem port traffic in the governor's quiet test; and the time
+ * flash writes and erases take, so a thinning pass ends within a few loop passes.
+ *
+ * Build and run from the repository root:
+ *     g++ -O2 -std=c++17 -Itools/host -Iinclude tools/soak_sim.cpp src/nmea.cpp src/nmea_reader.cpp src/events.cpp \
+ *         src/energy.cpp src/cpu_governor.cpp src/track_archive.cpp src/flash_blocks.cpp src/cell_cache.cpp \
+ *         src/spatial_key.cpp src/geo_fixed.cpp src/flight_recorder.cpp src/crc.cpp -o soak_sim
+ *     ./soak_sim [--days 7] [--web-per-hour 30] [--outages-per-day 4] [--outage-minutes 45] [--heap 40000]
+ *                [--uart-buffer 64] [--seed 1]
+ */
+
+#include <Arduino.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <map>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+#include "cell_cache.h"
+#include "cpu_governor.h"
+#include "energy.h"
+#include "events.h"
+#include "flash_layout.h"
+#include "flight_recorder.h"
+#include "nmea.h"
+#include "nmea_reader.h"
+#include "pipeline.h"
+#include "pipeline_stages.h"
+#include "track_archive.h"
+
+/* As in tracking.cpp */
+#define MESSAGE_BUFFER_SIZE 4097
+#define GPS_READ_INTERVAL_MS 10000
+#define AT_TIMEOUT_MS 4000
+#define UPLOAD_BODY_BYTES 110
+#define LOOP_IDLE_MS 1
+#define GOVERNOR_QUIET_MS 200
+
+#define GPS_BAUD 9600
+#define BYTE_US (10 * 1000000ULL / GPS_BAUD)
+#define START_UTC 1729209600 // 2024-10-18 00:00:00
+#define MAX_DAYS 27468       // until 2100, past which the two-digit RMC year reads as 2000 again
+#define PAGE_BYTES 2600
+#define PAGE_PIECES 40   // String concatenations while rendering the status page
+#define PAGE_RENDER_MS 25
+#define TCP_SEGMENT 1460
+#define MAX_IDLE_STEP_US 1000000ULL // keep the 32-bit micros() seen by energy_update() from wrapping
+
+uint64_t host_clock_us = 0;
+static std::mt19937 rng;
+
+/* ---- Actors on the event queue ---- */
+
+struct ActorEvent
+{
+    uint64_t us;
+    uint64_t order;
+    std::function<void()> run;
+    bool operator>(const ActorEvent &other) const { return us != other.us ? us > other.us : order > other.order; }
+};
+
+static std::priority_queue<ActorEvent, std::vector<ActorEvent>, std::greater<ActorEvent>> actors;
+static uint64_t actor_order = 0;
+
+static void schedule(uint64_t us, std::function<void()> run)
+{
+    actors.push({us, actor_order++, std::move(run)});
+}
+
+/**
+ * @brief - let every actor event due by us happen, and move the clock there
+ */
+static void advance_to(uint64_t us)
+{
+    while (!actors.empty() && actors.top().us <= us)
+    {
+        ActorEvent event = actors.top();
+        actors.pop();
+        host_clock_us = std::max(host_clock_us, event.us);
+        event.run();
+    }
+    host_clock_us = std::max(host_clock_us, us);
+}
+
+void delay(uint32_t ms)
+{
+    advance_to(host_clock_us + ms * 1000ULL);
+}
+
+static double exponential(double mean)
+{
+    return std::exponential_distribution<double>(1.0 / mean)(rng);
+}
+
+/* ---- RAM flash, with erase counts for wear ---- */
+
+static std::vector<uint8_t> flash_image((RECORDER_FIRST_SECTOR + RECORDER_SECTORS) * FLASH_SECTOR_SIZE, 0xFF);
+static std::vector<uint32_t> flash_erases(RECORDER_FIRST_SECTOR + RECORDER_SECTORS);
+
+uint32_t flash_region_sectors()
+{
+    return flash_image.size() / FLASH_SECTOR_SIZE;
+}
+
+bool flash_erase_sector(uint32_t sector)
+{
+    if (sector >= flash_region_sectors())
+    {
+        return false;
+    }
+    std::memset(&flash_image[sector * FLASH_SECTOR_SIZE], 0xFF, FLASH_SECTOR_SIZE);
+    flash_erases[sector]++;
+    return true;
+}
+
+bool flash_write(uint32_t address, const void *data, size_t length)
+{
+    if (address + length > flash_image.size())
+    {
+        return false;
+    }
+    // NOR flash only clears bits
+    const uint8_t *bytes = (const uint8_t *)data;
+    for (size_t i = 0; i < length; i++)
+    {
+        flash_image[address + i] &= bytes[i];
+    }
+    return true;
+}
+
+bool flash_read(uint32_t address, void *data, size_t length)
+{
+    if (address + length > flash_image.size())
+    {
+        return false;
+    }
+    std::memcpy(data, &flash_image[address], length);
+    return true;
+}
+
+/* ---- Heap model ---- */
+
+/**
+ * @brief First-fit allocator in 8-byte blocks with a 4-byte header, like umm_malloc, which
+ * grows a reallocation in place when the next block is free
+ */
+class SimHeap
+{
+public:
+    void begin(uint32_t size)
+    {
+        _free.clear();
+        _used.clear();
+        _free[0] = size / 8 * 8;
+        _total = _free[0];
+        _free_bytes = _total;
+        sample();
+    }
+
+    uint32_t alloc(uint32_t size)
+    {
+        uint32_t need = round(size);
+        for (auto it = _free.begin(); it != _free.end(); ++it)
+        {
+            if (it->second >= need)
+            {
+                uint32_t at = it->first, left = it->second - need;
+                _free.erase(it);
+                if (left)
+                {
+                    _free[at + need] = left;
+                }
+                _used[at] = need;
+                _free_bytes -= need;
+                sample();
+                return at + 1; // 0 is the failed allocation
+            }
+        }
+        failures++;
+        sample();
+        return 0;
+    }
+
+    void release(uint32_t handle)
+    {
+        if (!handle)
+        {
+            return;
+        }
+        uint32_t at = handle - 1, size = _used[at];
+        _used.erase(at);
+        _free_bytes += size;
+        auto next = _free.find(at + size);
+        if (next != _free.end())
+        {
+            size += next->second;
+            _free.erase(next);
+        }
+        auto it = _free.emplace(at, size).first;
+        if (it != _free.begin())
+        {
+            auto previous = std::prev(it);
+            if (previous->first + previous->second == at)
+            {
+                previous->second += size;
+                _free.erase(it);
+            }
+        }
+        sample();
+    }
+
+    uint32_t realloc(uint32_t handle, uint32_t size)
+    {
+        if (!handle)
+        {
+            return alloc(size);
+        }
+        uint32_t at = handle - 1, have = _used[at], need = round(size);
+        auto next = _free.find(at + have);
+        if (need > have && next != _free.end() && have + next->second >= need)
+        {
+            uint32_t left = have + next->second - need;
+            _free.erase(next);
+            if (left)
+            {
+                _free[at + need] = left;
+            }
+            _free_bytes -= need - have;
+            _used[at] = need;
+            sample();
+            return handle;
+        }
+        if (need <= have)
+        {
+            return handle;
+        }
+        uint32_t moved = alloc(size);
+        if (moved)
+        {
+            release(handle);
+        }
+        return moved;
+    }
+
+    uint32_t largest_free() const
+    {
+        uint32_t largest = 0;
+        for (const auto &block : _free)
+        {
+            largest = std::max(largest, block.second);
+        }
+        return largest;
+    }
+
+    uint32_t failures = 0;
+    uint32_t min_free = UINT32_MAX;
+    uint32_t min_largest = UINT32_MAX;
+    double max_fragmentation = 0;
+
+private:
+    static uint32_t round(uint32_t size) { return (size + 4 + 7) / 8 * 8; }
+
+    void sample()
+    {
+        uint32_t largest = largest_free();
+        min_free = std::min(min_free, _free_bytes);
+        min_largest = std::min(min_largest, largest);
+        if (_free_bytes)
+        {
+            max_fragmentation = std::max(max_fragmentation, 100.0 * (1.0 - (double)largest / _free_bytes));
+        }
+    }
+
+    std::map<uint32_t, uint32_t> _free; // offset: size
+    std::map<uint32_t, uint32_t> _used;
+    uint32_t _total = 0;
+    uint32_t _free_bytes = 0;
+};
+
+static SimHeap heap;
+
+/* ---- Receiver ---- */
+
+/**
+ * @brief NEO-6M at 1 Hz over a 9600 baud link into a fixed receive buffer. Bursts are made
+ * as the clock reaches them; bytes move into the buffer when the firmware looks at it
+ */
+class SimReceiver : public Stream
+{
+public:
+    void begin(size_t buffer_size, double lat, double lng)
+    {
+        _capacity = buffer_size;
+        _lat = lat;
+        _lng = lng;
+    }
+
+    int available() override
+    {
+        pump();
+        return (int)_buffer.size();
+    }
+
+    int read() override
+    {
+        pump();
+        if (_buffer.empty())
+        {
+            return -1;
+        }
+        uint8_t byte = _buffer.front();
+        _buffer.pop_front();
+        return byte;
+    }
+
+    size_t write(uint8_t) override
+    {
+        return 1; // UBX configuration is not modelled
+    }
+
+    /**
+     * @return when the buffer is next half full, or the current burst has all arrived
+     */
+    uint64_t next_drain_us()
+    {
+        pump();
+        if (!_buffer.empty())
+        {
+            return host_clock_us;
+        }
+        size_t batch = std::max<size_t>(1, _capacity / 2);
+        if (_sent < _burst.size())
+        {
+            return _burst_us + std::min(_sent + batch, _burst.size()) * BYTE_US;
+        }
+        return _next_burst_us + batch * BYTE_US;
+    }
+
+    /**
+     * @return when the burst for a fix time started on the wire
+     */
+    static uint64_t burst_us(uint32_t utc) { return (uint64_t)(utc - START_UTC) * 1000000ULL; }
+
+    uint64_t bytes_sent = 0;
+    uint64_t bytes_dropped = 0;
+    double speed_mps = 0;
+    bool stopped = false;
+
+private:
+    void pump()
+    {
+        while (true)
+        {
+            if (_sent == _burst.size())
+            {
+                if (host_clock_us < _next_burst_us)
+                {
+                    return;
+                }
+                make_burst();
+            }
+            uint64_t arrived = host_clock_us < _burst_us + BYTE_US ? 0 : std::min<uint64_t>(_burst.size(), (host_clock_us - _burst_us) / BYTE_US);
+            for (; _sent < arrived; _sent++)
+            {
+                if (_buffer.size() < _capacity)
+                {
+                    _buffer.push_back(_burst[_sent]);
+                }
+                else
+                {
+                    bytes_dropped++;
+                }
+                bytes_sent++;
+            }
+            if (_sent < _burst.size())
+            {
+                return;
+            }
+        }
+    }
+
+    void sentence(const char *body)
+    {
+        uint8_t checksum = 0;
+        for (const char *c = body; *c; c++)
+        {
+            checksum ^= *c;
+        }
+        char line[160];
+        std::snprintf(line, sizeof(line), "$%s*%02X\r\n", body, checksum);
+        _burst += line;
+    }
+
+    static void nmea_angle(double degrees, bool latitude, char *out, size_t size)
+    {
+        double magnitude = std::fabs(degrees);
+        int whole = (int)magnitude;
+        double minutes = (magnitude - whole) * 60;
+        std::snprintf(out, size, latitude ? "%02d%08.5f,%c" : "%03d%08.5f,%c", whole, minutes,
+                      latitude ? (degrees < 0 ? 'S' : 'N') : (degrees < 0 ? 'W' : 'E'));
+    }
+
+    /**
+     * @brief - an RMC date field, ddmmyy, for a UTC time; civil from days as in gpsd_server.cpp
+     */
+    static void nmea_date(uint32_t utc, char *out, size_t size)
+    {
+        uint32_t days = utc / 86400 + 719468;
+        uint32_t era = days / 146097;
+        uint32_t doe = days - era * 146097;
+        uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+        uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+        uint32_t mp = (5 * doy + 2) / 153;
+        uint32_t day = doy - (153 * mp + 2) / 5 + 1;
+        uint32_t month = mp < 10 ? mp + 3 : mp - 9;
+        uint32_t year = yoe + era * 400 + (month <= 2);
+        std::snprintf(out, size, "%02u%02u%02u", day, month, year % 100);
+    }
+
+    /**
+     * @brief - move along a random drive with stops and write the next second's burst
+     */
+    void make_burst()
+    {
+        _burst_us = _next_burst_us;
+        _next_burst_us += 1000000;
+        if (_phase_s-- <= 0)
+        {
+            stopped = !stopped;
+            _phase_s = (int)exponential(stopped ? 600 : 1200);
+        }
+        speed_mps = stopped ? 0 : std::max(0.0, speed_mps + std::normal_distribution<double>(0, 0.8)(rng));
+        speed_mps = std::min(speed_mps, 30.0);
+        _heading += std::normal_distribution<double>(0, 4)(rng);
+        _heading = std::fmod(_heading + 360, 360);
+        _lat += speed_mps * std::cos(_heading * M_PI / 180) / 111320.0;
+        _lng += speed_mps * std::sin(_heading * M_PI / 180) / (111320.0 * std::cos(_lat * M_PI / 180));
+
+        uint32_t utc = START_UTC + (uint32_t)(_burst_us / 1000000);
+        uint32_t seconds = utc % 86400;
+        char time[16], date[8], lat[24], lng[24], body[144];
+        std::snprintf(time, sizeof(time), "%02u%02u%02u.00", seconds / 3600, seconds / 60 % 60, seconds % 60);
+        nmea_date(utc, date, sizeof(date));
+        nmea_angle(_lat, true, lat, sizeof(lat));
+        nmea_angle(_lng, false, lng, sizeof(lng));
+        double knots = speed_mps * 1.943844;
+        _burst.clear();
+        std::snprintf(body, sizeof(body), "GPRMC,%s,A,%s,%s,%.3f,%.2f,%s,,,A", time, lat, lng, knots, _heading, date);
+        sentence(body);
+        std::snprintf(body, sizeof(body), "GPVTG,%.2f,T,,M,%.3f,N,%.3f,K,A", _heading, knots, speed_mps * 3.6);
+        sentence(body);
+        std::snprintf(body, sizeof(body), "GPGGA,%s,%s,%s,1,08,1.01,1650.2,M,-12.3,M,,", time, lat, lng);
+        sentence(body);
+        sentence("GPGSA,A,3,01,02,12,14,15,24,25,29,,,,,1.85,1.01,1.55");
+        sentence("GPGSV,3,1,12,01,40,083,46,02,17,308,41,12,07,344,39,14,22,228,45");
+        sentence("GPGSV,3,2,12,15,63,101,47,24,43,188,43,25,57,292,44,29,09,160,33");
+        sentence("GPGSV,3,3,12,31,03,028,,32,06,140,,33,29,223,,40,10,098,");
+        std::snprintf(body, sizeof(body), "GPGLL,%s,%s,%s,A,A", lat, lng, time);
+        sentence(body);
+        _sent = 0;
+    }
+
+    std::deque<uint8_t> _buffer;
+    size_t _capacity = 64;
+    std::string _burst;
+    size_t _sent = 0;
+    uint64_t _burst_us = 0;
+    uint64_t _next_burst_us = 0;
+    double _lat = 0, _lng = 0, _heading = 0;
+    int _phase_s = 0;
+};
+
+static SimReceiver receiver;
+
+/* ---- Firmware side ---- */
+
+static char gpsStream[MESSAGE_BUFFER_SIZE];
+static NmeaParser nmea;
+static bool network_up = true;
+static uint32_t gps_burst_read = 0;
+
+struct Results
+{
+    std::vector<uint32_t> fix_age_ms;
+    std::vector<uint32_t> web_ms;
+    std::vector<uint32_t> upload_age_ms;
+    uint64_t moved_fixes = 0;
+    uint64_t uploads_ok = 0;
+    uint64_t uploads_failed = 0;
+    uint64_t web_requests = 0;
+    uint64_t web_refused = 0; // no heap for the request
+    uint64_t loops = 0;
+    uint64_t longest_blocked_us = 0;
+};
+
+static Results results;
+
+/**
+ * @brief NmeaSource from tracking.cpp, reading the simulated receiver
+ */
+class SimNmeaSource
+{
+public:
+    SimNmeaSource() : _reader(gpsStream, sizeof(gpsStream)), _last_read(0), _read_once(false), _drained_us(0) {}
+
+    bool poll(FixEvent &event)
+    {
+        bool complete = _reader.poll(receiver, millis());
+        if (_reader.fresh_length())
+        {
+            _drained_us = host_clock_us;
+        }
+        if (!complete)
+        {
+            return false;
+        }
+        gps_burst_read = millis();
+        unsigned long started = _reader.started_ms();
+        if (_read_once && started - _last_read < GPS_READ_INTERVAL_MS)
+        {
+            _reader.clear();
+            return false;
+        }
+        _last_read = started;
+        _read_once = true;
+        recorder_log(RECORDER_GPS_RX, gpsStream, _reader.length());
+        bool valid = nmea.decode(gpsStream, event.fix);
+        _reader.clear();
+        if (!valid)
+        {
+            return false;
+        }
+        event.fix.time_ms = started;
+        if (event.fix.utc)
+        {
+            results.fix_age_ms.push_back((host_clock_us - SimReceiver::burst_us(event.fix.utc)) / 1000);
+        }
+        return true;
+    }
+
+    /**
+     * @return when a poll would find the burst in progress complete, UINT64_MAX if none is
+     */
+    uint64_t next_complete_us() const
+    {
+        return _reader.length() ? _drained_us + NMEA_BURST_GAP_MS * 1000ULL : UINT64_MAX;
+    }
+
+private:
+    NmeaReader _reader;
+    unsigned long _last_read;
+    bool _read_once;
+    uint64_t _drained_us; // for the scheduler, which must not wrap
+};
+
+/**
+ * @brief - idle_wait() from tracking.cpp, sleeping through the idle passes up to a wake time
+ */
+static void idle_wait(uint64_t wake_us)
+{
+    energy_enter(ENERGY_CPU_LIGHT_SLEEP);
+    advance_to(wake_us);
+    energy_enter(governor_active_state());
+}
+
+/**
+ * @brief - sendATcommand() from tracking.cpp: the command, then its whole timeout idling
+ */
+static void send_at(const std::string &command, const char *reply)
+{
+    recorder_log(RECORDER_MODEM_TX, command.data(), command.size());
+    recorder_log(RECORDER_MODEM_TX, "\r\n", 2);
+    idle_wait(host_clock_us + AT_TIMEOUT_MS * 1000ULL);
+    recorder_log(RECORDER_MODEM_RX, reply, std::strlen(reply));
+}
+
+/**
+ * @brief HttpSink and PUT_REQUEST() from tracking.cpp
+ */
+class SimHttpSink
+{
+public:
+    bool process(FixEvent &event)
+    {
+        if (!event.moved)
+        {
+            return true;
+        }
+        results.moved_fixes++;
+        uint32_t body = heap.alloc(UPLOAD_BODY_BYTES);
+        uint32_t command = heap.alloc(32);
+        modem_events.publish({MODEM_UPLOADING});
+        send_at("AT+QHTTPPUT=" + std::to_string(UPLOAD_BODY_BYTES) + ",30,60", network_up ? "\r\nCONNECT\r\n" : "\r\nERROR\r\n");
+        bool ok = network_up;
+        send_at(std::string(UPLOAD_BODY_BYTES, 'x'), ok ? "\r\nOK\r\n\r\n+QHTTPPUT: 0,200,0\r\n" : "");
+        ok = ok && network_up;
+        heap.release(command);
+        heap.release(body);
+        upload_events.publish({(int16_t)(ok ? 200 : -1), UPLOAD_BODY_BYTES, 2 * AT_TIMEOUT_MS});
+        modem_events.publish({MODEM_READY});
+        if (ok)
+        {
+            results.uploads_ok++;
+            results.upload_age_ms.push_back((host_clock_us - SimReceiver::burst_us(event.fix.utc)) / 1000);
+        }
+        else
+        {
+            results.uploads_failed++;
+        }
+        return true;
+    }
+};
+
+typedef Pipeline<SimNmeaSource, MovementFilter<>, LatencyMeter, BusSink, SimHttpSink> SimPipeline;
+static SimPipeline pipeline;
+
+struct WebRequest
+{
+    uint64_t arrived_us;
+    uint32_t buffer; // heap handle of the request held by the TCP stack
+};
+
+static std::deque<WebRequest> web_queue;
+
+/**
+ * @brief - gps_status_send(): render the page in pieces, wrap it in SendHTML() and send it
+ * in segments the TCP stack frees as they are acknowledged
+ */
+static void serve(const WebRequest &request)
+{
+    uint32_t page = 0;
+    for (uint32_t piece = 1; piece <= PAGE_PIECES; piece++)
+    {
+        uint32_t temporary = heap.alloc(PAGE_BYTES / PAGE_PIECES + 24);
+        page = heap.realloc(page, piece * PAGE_BYTES / PAGE_PIECES);
+        heap.release(temporary);
+    }
+    uint32_t html = heap.alloc(PAGE_BYTES + 900);
+    delay(PAGE_RENDER_MS);
+    uint64_t rtt_us = 20000 + (uint64_t)exponential(40000);
+    for (uint32_t sent = 0; sent < PAGE_BYTES + 900; sent += TCP_SEGMENT)
+    {
+        uint32_t segment = heap.alloc(TCP_SEGMENT);
+        schedule(host_clock_us + rtt_us, [segment]() { heap.release(segment); });
+    }
+    heap.release(html);
+    heap.release(page);
+    heap.release(request.buffer);
+    results.web_ms.push_back((host_clock_us - request.arrived_us) / 1000);
+}
+
+static void service_clients()
+{
+    energy_update();
+    if (!web_queue.empty())
+    {
+        WebRequest request = web_queue.front();
+        web_queue.pop_front();
+        serve(request);
+    }
+    track_archive_service();
+}
+
+/* ---- Actors ---- */
+
+static double web_per_hour = 30, outages_per_day = 4, outage_minutes = 45;
+
+static void web_client()
+{
+    // The TCP stack takes the request into a buffer as it arrives, whatever loop() is doing
+    uint32_t buffer = heap.alloc(536);
+    results.web_requests++;
+    if (buffer)
+    {
+        web_queue.push_back({host_clock_us, buffer});
+    }
+    else
+    {
+        results.web_refused++;
+    }
+    schedule(host_clock_us + (uint64_t)exponential(3600e6 / web_per_hour), web_client);
+}
+
+static void outage()
+{
+    network_up = false;
+    schedule(host_clock_us + (uint64_t)exponential(outage_minutes * 60e6), []()
+             {
+                 network_up = true;
+                 schedule(host_clock_us + (uint64_t)exponential(86400e6 / outages_per_day), outage);
+             });
+}
+
+static uint32_t energy_days = 0;
+static uint64_t energy_uah = 0; // of the completed days
+
+/**
+ * @brief - add up each day of energy accounting as it completes
+ */
+static void collect_energy()
+{
+    EnergyStats energy = energy_stats();
+    if (energy.days != energy_days)
+    {
+        energy_uah += energy_total_uah(energy.yesterday);
+        energy_days = energy.days;
+    }
+}
+
+static uint32_t percentile(std::vector<uint32_t> &values, double fraction)
+{
+    if (values.empty())
+    {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, (size_t)(fraction * values.size()))];
+}
+
+static void print_percentiles(const char *name, std::vector<uint32_t> &values)
+{
+    std::printf("%-12s n=%-7zu p50 %6u ms  p95 %6u ms  p99 %6u ms  max %6u ms\n", name, values.size(), percentile(values, 0.5),
+                percentile(values, 0.95), percentile(values, 0.99), percentile(values, 1.0));
+}
+
+int main(int argc, char **argv)
+{
+    double days = 7;
+    uint32_t heap_size = 40000, seed = 1;
+    size_t uart_buffer = 64;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        double value = std::atof(argv[i + 1]);
+        if (!std::strcmp(argv[i], "--days") && value <= MAX_DAYS)
+        {
+            days = value;
+        }
+        else if (!std::strcmp(argv[i], "--web-per-hour"))
+        {
+            web_per_hour = value;
+        }
+        else if (!std::strcmp(argv[i], "--outages-per-day"))
+        {
+            outages_per_day = value;
+        }
+        else if (!std::strcmp(argv[i], "--outage-minutes"))
+        {
+            outage_minutes = value;
+        }
+        else if (!std::strcmp(argv[i], "--heap"))
+        {
+            heap_size = (uint32_t)value;
+        }
+        else if (!std::strcmp(argv[i], "--uart-buffer"))
+        {
+            uart_buffer = (size_t)value;
+        }
+        else if (!std::strcmp(argv[i], "--seed"))
+        {
+            seed = (uint32_t)value;
+        }
+        else
+        {
+            std::fprintf(stderr, "usage: %s [--days n] [--web-per-hour n] [--outages-per-day n] [--outage-minutes n] [--heap bytes] [--uart-buffer bytes] [--seed n]\n", argv[0]);
+            return 2;
+        }
+    }
+    rng.seed(seed);
+    heap.begin(heap_size);
+    receiver.begin(uart_buffer, -1.2921, 36.8219);
+
+    // setup()
+    energy_begin([]() -> uint32_t { return micros(); });
+    recorder_begin([]() -> uint32_t { return millis(); });
+    energy_enter(ENERGY_AP_ON);
+    governor_begin([]() -> uint32_t { return micros(); }, [](CpuSpeed) { return true; });
+    track_archive_begin();
+    cell_cache_begin();
+    if (web_per_hour > 0)
+    {
+        schedule((uint64_t)exponential(3600e6 / web_per_hour), web_client);
+    }
+    if (outages_per_day > 0)
+    {
+        schedule((uint64_t)exponential(86400e6 / outages_per_day), outage);
+    }
+
+    auto wall_start = std::chrono::steady_clock::now();
+    uint64_t end_us = (uint64_t)(days * 86400e6);
+    while (host_clock_us < end_us)
+    {
+        // loop()
+        uint64_t loop_start = host_clock_us;
+        service_clients();
+        if (!pipeline.run())
+        {
+            uint64_t wake = host_clock_us + LOOP_IDLE_MS * 1000ULL;
+            if (web_queue.empty() && !track_archive_busy())
+            {
+                // The passes before the next thing to drain, complete or act would do nothing
+                wake = std::min(receiver.next_drain_us(), pipeline.source.next_complete_us());
+                if (!actors.empty())
+                {
+                    wake = std::min(wake, actors.top().us);
+                }
+                wake = std::min<uint64_t>(std::max<uint64_t>(wake, host_clock_us + LOOP_IDLE_MS * 1000ULL), host_clock_us + MAX_IDLE_STEP_US);
+            }
+            idle_wait(wake);
+        }
+        bool quiet = millis() - gps_burst_read < GOVERNOR_QUIET_MS && !receiver.available();
+        governor_update(quiet, track_archive_busy());
+        results.loops++;
+        results.longest_blocked_us = std::max(results.longest_blocked_us, host_clock_us - loop_start);
+        collect_energy();
+    }
+    energy_update();
+    collect_energy();
+    track_archive_flush();
+    recorder_flush();
+    double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+
+    std::printf("simulated %.2f days in %.1f s (%.0fx), %llu loop iterations, longest loop %.1f s\n", host_clock_us / 86400e6, wall_s,
+                host_clock_us / 1e6 / wall_s, (unsigned long long)results.loops, results.longest_blocked_us / 1e6);
+    print_percentiles("fix age", results.fix_age_ms);
+    print_percentiles("upload age", results.upload_age_ms);
+    print_percentiles("web", results.web_ms);
+    std::printf("receiver: %llu bytes sent, %llu (%.1f%%) lost to a full receive buffer; %u sentences passed, %u failed\n",
+                (unsigned long long)receiver.bytes_sent, (unsigned long long)receiver.bytes_dropped,
+                100.0 * receiver.bytes_dropped / std::max<uint64_t>(1, receiver.bytes_sent), nmea.passed(), nmea.failed());
+    std::printf("uploads: %llu moved fixes, %llu uploaded, %llu lost to outages\n", (unsigned long long)results.moved_fixes,
+                (unsigned long long)results.uploads_ok, (unsigned long long)results.uploads_failed);
+    std::printf("web: %llu requests, %llu refused for lack of heap\n", (unsigned long long)results.web_requests, (unsigned long long)results.web_refused);
+    std::printf("heap (synthetic allocation model, not measured): %u bytes, min free %u, min largest block %u, peak fragmentation "
+                "%.1f%%, %u failed allocations\n",
+                heap_size, heap.min_free, heap.min_largest, heap.max_fragmentation, heap.failures);
+    ArchiveStats archive = track_archive_stats();
+    RecorderStats recorder = recorder_stats();
+    uint32_t max_erases = *std::max_element(flash_erases.begin(), flash_erases.end());
+    std::printf("archive: %u fixes in %u bytes, %u sectors free, %u fixes thinned from %u sectors, %u journal checkpoints; "
+                "recorder: %u bytes logged, %u stored; most erased sector %u times\n",
+                archive.records, archive.stored_bytes, archive.free_sectors, archive.thinned, archive.decimations, archive.checkpoints,
+                recorder.logged_bytes, recorder.stored_bytes, max_erases);
+    EnergyStats energy = energy_stats();
+    double total_mah = (energy_uah + energy_total_uah(energy.today)) / 1000.0;
+    GovernorStats governor = governor_stats();
+    std::printf("energy: %.1f mAh/day; CPU at 160 MHz %.2f%% of the time, %u clock switches\n", total_mah / (host_clock_us / 86400e6),
+                100.0 * governor.speed_us[CPU_160MHZ] / std::max<uint64_t>(1, governor.speed_us[CPU_80MHZ] + governor.speed_us[CPU_160MHZ]),
+                governor.switches);
+    return 0;
+}
@@ -0,0 +1,65 @@
+/**
+ * @file spatial_bench.cpp
+ * @brief Host timing of the cell key encoders in spatial_key.h
+ *
+ * The device numbers are on /bench; this runs the same comparison on a workstation.
+ * Build from the repository root:
+ *     g++ -O2 -std=c++17 -Iinclude tools/spatial_bench.cpp src/spatial_key.cpp -o spatial_bench
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+#include "spatial_key.h"
+
+#define BENCH_POINTS 1000000
+
+struct Point
+{
+    int32_t lat_e7;
+    int32_t lng_e7;
+};
+
+template <typename Encode>
+static double ns_per_key(const std::vector<Point> &points, Encode encode)
+{
+    volatile uint64_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (const Point &point : points)
+    {
+        sink = encode(point);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    (void)sink;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / points.size();
+}
+
+int main()
+{
+    std::vector<Point> points(BENCH_POINTS);
+    uint32_t seed = 0x9E3779B9;
+    for (Point &point : points)
+    {
+        seed = seed * 1664525 + 1013904223;
+        point.lat_e7 = (int32_t)(seed % 1800000000) - 900000000;
+        seed = seed * 1664525 + 1013904223;
+        point.lng_e7 = (int32_t)(seed % 3600000000UL - 1800000000UL);
+    }
+
+    size_t mismatches = 0;
+    for (const Point &point : points)
+    {
+        if (geohash_bits(point.lat_e7, point.lng_e7) != geohash_bits_bisect(point.lat_e7, point.lng_e7) ||
+            hilbert_key(point.lat_e7, point.lng_e7, HILBERT_MAX_ORDER) != hilbert_key_iterative(point.lat_e7, point.lng_e7, HILBERT_MAX_ORDER))
+        {
+            mismatches++;
+        }
+    }
+
+    printf("geohash interleaved  %6.1f ns/key\n", ns_per_key(points, [](const Point &p) { return geohash_bits(p.lat_e7, p.lng_e7); }));
+    printf("geohash bisection    %6.1f ns/key\n", ns_per_key(points, [](const Point &p) { return geohash_bits_bisect(p.lat_e7, p.lng_e7); }));
+    printf("hilbert prefix scan  %6.1f ns/key\n", ns_per_key(points, [](const Point &p) { return (uint64_t)hilbert_key(p.lat_e7, p.lng_e7, HILBERT_MAX_ORDER); }));
+    printf("hilbert iterative    %6.1f ns/key\n", ns_per_key(points, [](const Point &p) { return (uint64_t)hilbert_key_iterative(p.lat_e7, p.lng_e7, HILBERT_MAX_ORDER); }));
+    printf("%zu mismatches in %d points\n", mismatches, BENCH_POINTS);
+    return mismatches != 0;
+}